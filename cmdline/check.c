@@ -585,21 +585,705 @@ static int repair(struct snapraid_state* state, int rehash, unsigned pos, unsign
 		return -1;
 }
 
+/****************************************************************************/
+/* write */
+
+/**
+ * Number of recovered blocks collected in a batch.
+ */
+#define WRITE_BATCH 8
+
+/**
+ * Recovered block to write.
+ */
+struct snapraid_write {
+	int f; /**< Handle of the file. A duplicate owned by the batch. */
+	int is_owner; /**< If it's the first write with this handle, that closes it. */
+	struct snapraid_file* file; /**< File to write. */
+	block_off_t file_pos; /**< Position of the block in the file. */
+	block_off_t pos; /**< Parity position of the block. */
+	int is_outofdate; /**< If the recovered data may be not updated. */
+	int result; /**< 0 if written, -1 if failed or skipped after a failure. */
+	void* buffer; /**< Recovered data. */
+};
+
+/**
+ * Writes of the recovered blocks of a disk.
+ *
+ * Like the metadata operations, the writes are collected in a batch, and when
+ * it's full, the batch is written in background, while the next one is collected.
+ * Each recovered disk has its own queue, and when recovering more disks at the
+ * same time, all of them are written in parallel.
+ *
+ * The batch uses a duplicate of the file handle, so the main thread can close
+ * the file, and open the next one, while the data is still written.
+ *
+ * A block is reported as recovered only when the batch is joined, and its
+ * write is completed.
+ */
+struct snapraid_write_queue {
+	struct snapraid_disk* disk;
+	unsigned block_size;
+	struct snapraid_write* map[2]; /**< Batch collected, and batch written. */
+	unsigned count[2]; /**< Number of writes in each batch. */
+	unsigned collect; /**< Index of the batch collected. */
+	void* buffer_alloc; /**< Allocated at the first write, as most disks don't need it. */
+	unsigned error; /**< Number of failed writes. */
+	int error_errno; /**< Error of the last failed write. */
+	unsigned recovered; /**< Number of blocks written and recovered. */
+#if HAVE_PTHREAD
+	int running; /**< If the batch is in execution. */
+	struct thread_job job;
+#endif
+};
+
+/**
+ * Write a block of a batch.
+ */
+static int write_block(struct snapraid_write_queue* queue, struct advise_struct* advise, struct snapraid_write* write)
+{
+	struct snapraid_disk* disk = queue->disk;
+	struct snapraid_file* file = write->file;
+	data_off_t offset;
+	unsigned write_size;
+	ssize_t write_ret;
+
+	/* the first write of the handle starts the advise */
+	if (write->is_owner) {
+		advise_init(advise, disk->file_mode);
+		if (advise_open(advise, write->f) != 0) {
+			/* LCOV_EXCL_START */
+			log_fatal("Error advising file '%s%s'. %s.\n", disk->dir, file->sub, strerror(errno));
+			return -1;
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	offset = write->file_pos * (data_off_t)queue->block_size;
+	write_size = file_block_size(file, write->file_pos, queue->block_size);
+
+	write_ret = pwrite(write->f, write->buffer, write_size, offset);
+	if (write_ret != (ssize_t)write_size) { /* conversion is safe because block_size is always small */
+		/* LCOV_EXCL_START */
+		log_fatal("Error writing file '%s%s'. %s.\n", disk->dir, file->sub, strerror(errno));
+		return -1;
+		/* LCOV_EXCL_STOP */
+	}
+
+	if (advise_write(advise, write->f, offset, queue->block_size) != 0) {
+		/* LCOV_EXCL_START */
+		log_fatal("Error advising file '%s%s'. %s.\n", disk->dir, file->sub, strerror(errno));
+		return -1;
+		/* LCOV_EXCL_STOP */
+	}
+
+	return 0;
+}
+
+/**
+ * Write all the blocks of a batch.
+ * It only stores the result of each write, as the files are updated
+ * by write_complete() in the main thread.
+ */
+static void write_execute(struct snapraid_write_queue* queue, unsigned index)
+{
+	struct snapraid_disk* disk = queue->disk;
+	struct snapraid_write* map = queue->map[index];
+	unsigned count = queue->count[index];
+	struct advise_struct advise;
+	int failed;
+	unsigned i;
+
+	advise_init(&advise, disk->file_mode);
+
+	failed = 0;
+	for (i = 0; i < count; ++i) {
+		struct snapraid_file* file = map[i].file;
+
+		/* after an error, skip the writes and only close the handles */
+		if (!failed && write_block(queue, &advise, &map[i]) == 0) {
+			map[i].result = 0;
+		} else {
+			if (!failed)
+				queue->error_errno = errno;
+			failed = 1;
+			map[i].result = -1;
+		}
+
+		/* close the handle after its last write */
+		if (i + 1 == count || map[i + 1].is_owner) {
+			if (close(map[i].f) != 0 && !failed) {
+				/* LCOV_EXCL_START */
+				log_fatal("Error closing file '%s%s'. %s.\n", disk->dir, file->sub, strerror(errno));
+				queue->error_errno = errno;
+				failed = 1;
+				map[i].result = -1;
+				/* LCOV_EXCL_STOP */
+			}
+		}
+	}
+}
+
+/**
+ * Update the files with the result of the writes of a batch.
+ * It runs in the main thread, after the batch is joined.
+ */
+static void write_complete(struct snapraid_write_queue* queue, unsigned index)
+{
+	struct snapraid_disk* disk = queue->disk;
+	struct snapraid_write* map = queue->map[index];
+	unsigned count = queue->count[index];
+	char esc_buffer[ESC_MAX];
+	unsigned i;
+
+	for (i = 0; i < count; ++i) {
+		struct snapraid_file* file = map[i].file;
+
+		if (map[i].result != 0) {
+			/* LCOV_EXCL_START */
+			/* mark the file as damaged, also if the write was skipped after a failure */
+			file_flag_set(file, FILE_IS_DAMAGED);
+			log_tag("error:%u:%s:%s: Write error at position %u\n", map[i].pos, disk->name, esc_tag(file->sub, esc_buffer), map[i].file_pos);
+			++queue->error;
+			continue;
+			/* LCOV_EXCL_STOP */
+		}
+
+		/* if we are not sure that the recovered content is uptodate */
+		if (map[i].is_outofdate) {
+			/* mark the file as damaged */
+			file_flag_set(file, FILE_IS_DAMAGED);
+			continue;
+		}
+
+		/* mark the file as containing some fixes */
+		/* note that it could be also marked as damaged in other iterations */
+		file_flag_set(file, FILE_IS_FIXED);
+
+		log_tag("fixed:%u:%s:%s: Fixed data error at position %u\n", map[i].pos, disk->name, esc_tag(file->sub, esc_buffer), map[i].file_pos);
+		++queue->recovered;
+	}
+
+	queue->count[index] = 0;
+}
+
+#if HAVE_PTHREAD
+static void* write_worker(void* arg)
+{
+	struct snapraid_write_queue* queue = arg;
+
+	/* write the batch not collected */
+	write_execute(queue, queue->collect ^ 1);
+
+	return 0;
+}
+#endif
+
+static void write_init(struct snapraid_write_queue* queue, struct snapraid_disk* disk, unsigned block_size)
+{
+	queue->disk = disk;
+	queue->block_size = block_size;
+	queue->map[0] = malloc_nofail(WRITE_BATCH * sizeof(struct snapraid_write));
+	queue->map[1] = malloc_nofail(WRITE_BATCH * sizeof(struct snapraid_write));
+	queue->count[0] = 0;
+	queue->count[1] = 0;
+	queue->collect = 0;
+	queue->buffer_alloc = 0;
+	queue->error = 0;
+	queue->error_errno = 0;
+	queue->recovered = 0;
+#if HAVE_PTHREAD
+	queue->running = 0;
+#endif
+}
+
+/**
+ * Wait for the batch in execution, if any, and complete it.
+ */
+static void write_wait(struct snapraid_write_queue* queue)
+{
+#if HAVE_PTHREAD
+	void* retval;
+
+	if (!queue->running)
+		return;
+
+	thread_pool_join(&queue->job, &retval);
+	queue->running = 0;
+
+	write_complete(queue, queue->collect ^ 1);
+#else
+	(void)queue;
+#endif
+}
+
+/**
+ * Start the execution of the collected batch, and collect the next one.
+ */
+static void write_submit(struct snapraid_write_queue* queue)
+{
+	write_wait(queue);
+
+	if (queue->count[queue->collect] == 0)
+		return;
+
+#if HAVE_PTHREAD
+	queue->collect ^= 1;
+	queue->running = 1;
+	thread_pool_run(&queue->job, 0, write_worker, queue);
+#else
+	write_execute(queue, queue->collect);
+	write_complete(queue, queue->collect);
+#endif
+}
+
+/**
+ * Complete all the queued writes.
+ * Return -1 if some write failed.
+ */
+static int write_flush(struct snapraid_write_queue* queue)
+{
+	write_submit(queue);
+	write_wait(queue);
+
+	if (queue->error != 0) {
+		/* LCOV_EXCL_START */
+		errno = queue->error_errno;
+		return -1;
+		/* LCOV_EXCL_STOP */
+	}
+
+	return 0;
+}
+
+/**
+ * Queue the write of a recovered block.
+ * The block data is copied, and the buffer can be reused just after.
+ * Return -1 if the handle cannot be duplicated, or if some previous write failed.
+ */
+static int write_push(struct snapraid_write_queue* queue, struct failed_struct* failed, block_off_t pos, void* buffer)
+{
+	struct snapraid_handle* handle = failed->handle;
+	struct snapraid_write* write;
+	data_off_t offset;
+	unsigned write_size;
+	unsigned collect;
+	unsigned count;
+
+	if (queue->count[queue->collect] == WRITE_BATCH)
+		write_submit(queue);
+
+	if (queue->error != 0) {
+		/* LCOV_EXCL_START */
+		errno = queue->error_errno;
+		return -1;
+		/* LCOV_EXCL_STOP */
+	}
+
+	/* allocate the buffers of both batches */
+	if (!queue->buffer_alloc) {
+		unsigned char* ptr = malloc_nofail_direct(2 * WRITE_BATCH * queue->block_size, &queue->buffer_alloc);
+		unsigned i;
+
+		for (i = 0; i < WRITE_BATCH; ++i) {
+			queue->map[0][i].buffer = ptr + i * queue->block_size;
+			queue->map[1][i].buffer = ptr + (WRITE_BATCH + i) * queue->block_size;
+		}
+	}
+
+	collect = queue->collect;
+	count = queue->count[collect];
+	write = &queue->map[collect][count];
+
+	/* all the writes of the same file in the batch share the same handle */
+	if (count != 0 && write[-1].file == handle->file) {
+		write->f = write[-1].f;
+		write->is_owner = 0;
+	} else {
+		write->f = dup(handle->f);
+		if (write->f == -1) {
+			/* LCOV_EXCL_START */
+			log_fatal("Error duplicating the handle of file '%s'. %s.\n", handle->path, strerror(errno));
+			return -1;
+			/* LCOV_EXCL_STOP */
+		}
+		write->is_owner = 1;
+	}
+
+	write->file = handle->file;
+	write->file_pos = failed->file_pos;
+	write->pos = pos;
+	write->is_outofdate = failed->is_outofdate;
+	memcpy(write->buffer, buffer, queue->block_size);
+
+	++queue->count[collect];
+
+	/* adjust the size of the valid data, like handle_write() */
+	offset = failed->file_pos * (data_off_t)queue->block_size;
+	write_size = file_block_size(handle->file, failed->file_pos, queue->block_size);
+	if (handle->valid_size < offset + write_size)
+		handle->valid_size = offset + write_size;
+
+	return 0;
+}
+
+/**
+ * Deallocate the queue.
+ * All the writes must be already completed with write_flush().
+ */
+static void write_done(struct snapraid_write_queue* queue)
+{
+	free(queue->map[0]);
+	free(queue->map[1]);
+	free(queue->buffer_alloc);
+}
+
+/****************************************************************************/
+/* post */
+
+/**
+ * Number of metadata operations collected in a batch.
+ */
+#define POST_BATCH 1024
+
+#define POST_UTIME 1 /**< Restore the modification time of a recovered file. */
+#define POST_RENAME 2 /**< Rename an unrecoverable file. */
+
+/**
+ * Metadata operation to finalize a file after its last block.
+ */
+struct snapraid_post {
+	int op; /**< One of POST_*. Selected by post_select(). */
+	struct snapraid_file* file; /**< File to finalize. */
+};
+
+/**
+ * Metadata operations of a disk.
+ *
+ * The operations are collected in a batch, and when it's full, the batch is
+ * sorted in directory order and executed in background, while the next one
+ * is collected. In this way the recovery of the data never waits for the
+ * metadata syscalls.
+ */
+struct snapraid_post_queue {
+	struct snapraid_disk* disk;
+	struct snapraid_write_queue* write; /**< Writes of the disk, completed before the batch. */
+	struct snapraid_post* map[2]; /**< Batch collected, and batch executed. */
+	unsigned count[2]; /**< Number of operations in each batch. */
+	unsigned collect; /**< Index of the batch collected. */
+	unsigned error; /**< Number of operations failed. */
+#if HAVE_PTHREAD
+	int running; /**< If the batch is in execution. */
+	struct thread_job job;
+#endif
+};
+
+static int post_compare(const void* void_a, const void* void_b)
+{
+	const struct snapraid_post* post_a = void_a;
+	const struct snapraid_post* post_b = void_b;
+
+	return file_order_compare(post_a->file, post_b->file);
+}
+
+/**
+ * Restore the modification time of a recovered file.
+ */
+static int post_utime(struct snapraid_post_queue* queue, struct snapraid_file* file)
+{
+	struct snapraid_disk* disk = queue->disk;
+	struct snapraid_handle handle;
+	struct snapraid_file* collide_file;
+	char esc_buffer[ESC_MAX];
+	char esc_buffer_alt[ESC_MAX];
+	uint64_t inode;
+	int ret;
+
+	/* use a private handle, as the ones of the main thread are in use */
+	handle.disk = disk;
+	handle.file = 0;
+	handle.f = -1;
+	handle.valid_size = 0;
+
+	/* reopen it as readonly, as to set the mtime readonly access it's enough */
+	/* we know that the file exists because it has the FILE_IS_FIXED tag */
+	ret = handle_open(&handle, file, disk->file_mode, log_error, 0);
+	if (ret != 0) {
+		/* LCOV_EXCL_START */
+		return -1;
+		/* LCOV_EXCL_STOP */
+	}
+
+	inode = handle.st.st_ino;
+
+	/* search for the corresponding inode */
+	/* the inode set is not modified by fix, and it can be searched in parallel */
+	collide_file = tommy_hashlin_search(&disk->inodeset, file_inode_compare_to_arg, &inode, file_inode_hash(inode));
+
+	/* if the inode is already in the database and it refers at a different file name, */
+	/* we can fix the file time ONLY if the time and size allow to differentiate */
+	/* between the two files */
+
+	/* for example, suppose we delete a bunch of files with all the same size and time, */
+	/* when recreating them the inodes may be reused in a different order, */
+	/* and at the next sync some files may have matching inode/size/time even if different name */
+	/* not allowing sync to detect that the file is changed and not renamed */
+	if (!collide_file /* if not in the database, there is no collision */
+		|| strcmp(collide_file->sub, file->sub) == 0 /* if the name is the same, it's the right collision */
+		|| collide_file->size != file->size /* if the size is different, the collision is identified */
+		|| collide_file->mtime_sec != file->mtime_sec /* if the mtime is different, the collision is identified */
+		|| collide_file->mtime_nsec != file->mtime_nsec /* same for mtime_nsec */
+	) {
+		/* set the original modification time */
+		ret = handle_utime(&handle);
+		if (ret != 0) {
+			/* LCOV_EXCL_START */
+			handle_close(&handle);
+			return -1;
+			/* LCOV_EXCL_STOP */
+		}
+	} else {
+		log_tag("collision:%s:%s:%s: Not setting modification time to avoid inode collision\n", disk->name, esc_tag(file->sub, esc_buffer), esc_tag(collide_file->sub, esc_buffer_alt));
+	}
+
+	ret = handle_close(&handle);
+	if (ret != 0) {
+		/* LCOV_EXCL_START */
+		return -1;
+		/* LCOV_EXCL_STOP */
+	}
+
+	return 0;
+}
+
+/**
+ * Execute all the operations of a batch.
+ */
+static void post_execute(struct snapraid_post_queue* queue, unsigned index)
+{
+	struct snapraid_disk* disk = queue->disk;
+	struct snapraid_post* map = queue->map[index];
+	unsigned count = queue->count[index];
+	unsigned i;
+
+	/* access the files in directory order */
+	qsort(map, count, sizeof(struct snapraid_post), post_compare);
+
+	for (i = 0; i < count; ++i) {
+		struct snapraid_file* file = map[i].file;
+
+		if (map[i].op == POST_RENAME) {
+			char path[PATH_MAX];
+			char path_to[PATH_MAX];
+
+			pathprint(path, sizeof(path), "%s%s", disk->dir, file->sub);
+			pathprint(path_to, sizeof(path_to), "%s%s.unrecoverable", disk->dir, file->sub);
+
+			if (rename(path, path_to) != 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("Error renaming '%s' to '%s'. %s.\n", path, path_to, strerror(errno));
+				++queue->error;
+				/* LCOV_EXCL_STOP */
+			}
+		} else {
+			if (post_utime(queue, file) != 0) {
+				/* LCOV_EXCL_START */
+				/* mark the file as damaged */
+				/* all the blocks of a finished file are already processed, */
+				/* so the main thread doesn't access it until the batch is joined */
+				file_flag_set(file, FILE_IS_DAMAGED);
+				++queue->error;
+				/* LCOV_EXCL_STOP */
+			}
+		}
+	}
+
+	queue->count[index] = 0;
+}
+
+#if HAVE_PTHREAD
+static void* post_worker(void* arg)
+{
+	struct snapraid_post_queue* queue = arg;
+
+	/* execute the batch not collected */
+	post_execute(queue, queue->collect ^ 1);
+
+	return 0;
+}
+#endif
+
+static void post_init(struct snapraid_post_queue* queue, struct snapraid_disk* disk, struct snapraid_write_queue* write)
+{
+	queue->disk = disk;
+	queue->write = write;
+	queue->map[0] = malloc_nofail(POST_BATCH * sizeof(struct snapraid_post));
+	queue->map[1] = malloc_nofail(POST_BATCH * sizeof(struct snapraid_post));
+	queue->count[0] = 0;
+	queue->count[1] = 0;
+	queue->collect = 0;
+	queue->error = 0;
+#if HAVE_PTHREAD
+	queue->running = 0;
+#endif
+}
+
+/**
+ * Wait for the batch in execution, if any.
+ */
+static void post_wait(struct snapraid_post_queue* queue)
+{
+#if HAVE_PTHREAD
+	void* retval;
+
+	if (!queue->running)
+		return;
+
+	thread_pool_join(&queue->job, &retval);
+	queue->running = 0;
+#else
+	(void)queue;
+#endif
+}
+
+/**
+ * Select the operation of each file of the collected batch, and print its status.
+ *
+ * It runs in the main thread after all the writes of the disk are completed,
+ * as only then it's known if the file was recovered or not.
+ * The files untouched are removed from the batch.
+ */
+static void post_select(struct snapraid_post_queue* queue)
+{
+	struct snapraid_disk* disk = queue->disk;
+	struct snapraid_post* map = queue->map[queue->collect];
+	unsigned count = queue->count[queue->collect];
+	char esc_buffer[ESC_MAX];
+	unsigned i;
+	unsigned n;
+
+	n = 0;
+	for (i = 0; i < count; ++i) {
+		struct snapraid_file* file = map[i].file;
+
+		if (file_flag_has(file, FILE_IS_DAMAGED)) {
+			/* if the file is damaged, meaning that a fix failed, rename it to .unrecoverable */
+			map[n].op = POST_RENAME;
+
+			log_tag("status:unrecoverable:%s:%s\n", disk->name, esc_tag(file->sub, esc_buffer));
+			msg_info("unrecoverable %s\n", fmt_term(disk, file->sub, esc_buffer));
+		} else if (file_flag_has(file, FILE_IS_FIXED)) {
+			/* set the original modification time */
+			map[n].op = POST_UTIME;
+
+			log_tag("status:recovered:%s:%s\n", disk->name, esc_tag(file->sub, esc_buffer));
+			msg_info("recovered %s\n", fmt_term(disk, file->sub, esc_buffer));
+		} else {
+			/* the file is untouched, nothing to do */
+			continue;
+		}
+
+		map[n].file = file;
+		++n;
+	}
+
+	queue->count[queue->collect] = n;
+}
+
+/**
+ * Start the execution of the collected batch, and collect the next one.
+ */
+static void post_submit(struct snapraid_post_queue* queue)
+{
+	post_wait(queue);
+
+	if (queue->count[queue->collect] == 0)
+		return;
+
+	/* the files must be completely written before setting the time or renaming them */
+	if (write_flush(queue->write) != 0) {
+		/* LCOV_EXCL_START */
+		++queue->error;
+		/* LCOV_EXCL_STOP */
+	}
+
+	post_select(queue);
+
+	if (queue->count[queue->collect] == 0)
+		return;
+
+#if HAVE_PTHREAD
+	queue->collect ^= 1;
+	queue->running = 1;
+	thread_pool_run(&queue->job, 0, post_worker, queue);
+#else
+	post_execute(queue, queue->collect);
+#endif
+}
+
+/**
+ * Queue a finished file.
+ * The batch is submitted before adding the file, to ensure that
+ * the file is closed by the caller before the operation is executed.
+ * Return -1 if some previous operation failed.
+ */
+static int post_push(struct snapraid_post_queue* queue, struct snapraid_file* file)
+{
+	struct snapraid_post* post;
+
+	if (queue->count[queue->collect] == POST_BATCH)
+		post_submit(queue);
+
+	post = &queue->map[queue->collect][queue->count[queue->collect]++];
+	post->op = 0;
+	post->file = file;
+
+	if (queue->error != 0)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * Execute all the remaining operations, and deallocate the queue.
+ * Return the number of failed operations.
+ */
+static unsigned post_done(struct snapraid_post_queue* queue)
+{
+	post_submit(queue);
+	post_wait(queue);
+
+	free(queue->map[0]);
+	free(queue->map[1]);
+
+	return queue->error;
+}
+
 /**
  * Post process all the files at the specified block index ::i.
- * For each file, if we are at the last block, closes it,
+ * For each file, if it was the last block to process, closes it,
  * adjust the timestamp, and print the result.
  *
+ * The last block to process is not always the last block of the file,
+ * like for fragmented files, or with the priority files processed first.
+ * So the blocks still to process are counted in file->pending.
+ * Files with some blocks outside the processed range are never finished.
+ *
  * This works with the assumption to always process the whole files to
  * fix. This assumption is not always correct, and in such case we have to
  * skip the whole postprocessing. And example, is when fixing only bad blocks.
+ *
+ * When fixing, the finished files are queued in ::post. Their status is
+ * reported when the batch is submitted, after their writes are completed,
+ * and the rename and the time fix are executed in background.
+ * The main thread doesn't access a file in execution, as all its blocks
+ * were already processed and written.
  */
-static int file_post(struct snapraid_state* state, int fix, unsigned i, struct snapraid_handle* handle, unsigned diskmax)
+static int file_post(struct snapraid_state* state, int fix, unsigned i, struct snapraid_handle* handle, struct snapraid_post_queue* post, unsigned diskmax)
 {
 	unsigned j;
 	int ret;
 	char esc_buffer[ESC_MAX];
-	char esc_buffer_alt[ESC_MAX];
 
 	/* if we are processing only bad blocks, we don't have to do any post-processing */
 	/* as we don't have any guarantee to process the last block of the fixed files */
@@ -611,11 +1295,8 @@ static int file_post(struct snapraid_state* state, int fix, unsigned i, struct s
 	for (j = 0; j < diskmax; ++j) {
 		struct snapraid_block* block;
 		struct snapraid_disk* disk;
-		struct snapraid_file* collide_file;
 		struct snapraid_file* file;
 		block_off_t file_pos;
-		char path[PATH_MAX];
-		uint64_t inode;
 
 		disk = handle[j].disk;
 		if (!disk) {
@@ -630,10 +1311,10 @@ static int file_post(struct snapraid_state* state, int fix, unsigned i, struct s
 		}
 
 		file = fs_par2file_get(disk, i, &file_pos);
-		pathprint(path, sizeof(path), "%s%s", disk->dir, file->sub);
 
-		/* if it isn't the last block in the file */
-		if (!file_block_is_last(file, file_pos)) {
+		/* if it isn't the last block to process of the file */
+		--file->pending;
+		if (file->pending != 0) {
 			/* nothing to do */
 			continue;
 		}
@@ -651,106 +1332,15 @@ static int file_post(struct snapraid_state* state, int fix, unsigned i, struct s
 			/* to identify later any NOT finished ones */
 			file_flag_set(file, FILE_IS_FINISHED);
 
-			/* if the file is damaged, meaning that a fix failed */
-			if (file_flag_has(file, FILE_IS_DAMAGED)) {
-				/* rename it to .unrecoverable */
-				char path_to[PATH_MAX];
-
-				pathprint(path_to, sizeof(path_to), "%s%s.unrecoverable", disk->dir, file->sub);
-
-				/* ensure to close the file before renaming */
-				if (handle[j].file == file) {
-					ret = handle_close(&handle[j]);
-					if (ret != 0) {
-						/* LCOV_EXCL_START */
-						log_tag("error:%u:%s:%s: Close error. %s\n", i, disk->name, esc_tag(file->sub, esc_buffer), strerror(errno));
-						log_fatal("DANGER! Unexpected close error in a data disk.\n");
-						return -1;
-						/* LCOV_EXCL_STOP */
-					}
-				}
-
-				ret = rename(path, path_to);
-				if (ret != 0) {
-					/* LCOV_EXCL_START */
-					log_fatal("Error renaming '%s' to '%s'. %s.\n", path, path_to, strerror(errno));
-					log_fatal("WARNING! Without a working data disk, it isn't possible to fix errors on it.\n");
-					return -1;
-					/* LCOV_EXCL_STOP */
-				}
-
-				log_tag("status:unrecoverable:%s:%s\n", disk->name, esc_tag(file->sub, esc_buffer));
-				msg_info("unrecoverable %s\n", fmt_term(disk, file->sub, esc_buffer));
-
-				/* and do not set the time if damaged */
-				goto close_and_continue;
-			}
-
-			/* if the file is not fixed, meaning that it is untouched */
-			if (!file_flag_has(file, FILE_IS_FIXED)) {
-				/* nothing to do, but close the file */
-				goto close_and_continue;
-			}
-
-			/* if the file is closed or different than the one expected, reopen it */
-			/* a different open file could happen when filtering for bad blocks */
-			if (handle[j].file != file) {
-				/* close a potential different file */
-				ret = handle_close(&handle[j]);
-				if (ret != 0) {
-					/* LCOV_EXCL_START */
-					log_tag("error:%u:%s:%s: Close error. %s\n", i, disk->name, esc_tag(handle[j].file->sub, esc_buffer), strerror(errno));
-					log_fatal("DANGER! Unexpected close error in a data disk.\n");
-					return -1;
-					/* LCOV_EXCL_STOP */
-				}
-
-				/* reopen it as readonly, as to set the mtime readonly access it's enough */
-				/* we know that the file exists because it has the FILE_IS_FIXED tag */
-				ret = handle_open(&handle[j], file, state->file_mode, log_error, 0);
-				if (ret != 0) {
-					/* LCOV_EXCL_START */
-					log_tag("error:%u:%s:%s: Open error. %s\n", i, disk->name, esc_tag(file->sub, esc_buffer), strerror(errno));
-					log_fatal("WARNING! Without a working data disk, it isn't possible to fix errors on it.\n");
-					return -1;
-					/* LCOV_EXCL_STOP */
-				}
-			}
-
-			log_tag("status:recovered:%s:%s\n", disk->name, esc_tag(file->sub, esc_buffer));
-			msg_info("recovered %s\n", fmt_term(disk, file->sub, esc_buffer));
-
-			inode = handle[j].st.st_ino;
-
-			/* search for the corresponding inode */
-			collide_file = tommy_hashdyn_search(&disk->inodeset, file_inode_compare_to_arg, &inode, file_inode_hash(inode));
-
-			/* if the inode is already in the database and it refers at a different file name, */
-			/* we can fix the file time ONLY if the time and size allow to differentiate */
-			/* between the two files */
-
-			/* for example, suppose we delete a bunch of files with all the same size and time, */
-			/* when recreating them the inodes may be reused in a different order, */
-			/* and at the next sync some files may have matching inode/size/time even if different name */
-			/* not allowing sync to detect that the file is changed and not renamed */
-			if (!collide_file /* if not in the database, there is no collision */
-				|| strcmp(collide_file->sub, file->sub) == 0 /* if the name is the same, it's the right collision */
-				|| collide_file->size != file->size /* if the size is different, the collision is identified */
-				|| collide_file->mtime_sec != file->mtime_sec /* if the mtime is different, the collision is identified */
-				|| collide_file->mtime_nsec != file->mtime_nsec /* same for mtime_nsec */
-			) {
-				/* set the original modification time */
-				ret = handle_utime(&handle[j]);
-				if (ret == -1) {
-					/* LCOV_EXCL_START */
-					/* mark the file as damaged */
-					file_flag_set(file, FILE_IS_DAMAGED);
-					log_fatal("WARNING! Without a working data disk, it isn't possible to fix errors on it.\n");
-					return -1;
-					/* LCOV_EXCL_STOP */
-				}
-			} else {
-				log_tag("collision:%s:%s:%s: Not setting modification time to avoid inode collision\n", disk->name, esc_tag(file->sub, esc_buffer), esc_tag(collide_file->sub, esc_buffer_alt));
+			/* queue the file, and after its writes are completed, set its time */
+			/* if recovered, or rename it to .unrecoverable if damaged */
+			/* the file is closed just after, and always before the operation */
+			ret = post_push(&post[j], file);
+			if (ret != 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("WARNING! Without a working data disk, it isn't possible to fix errors on it.\n");
+				return -1;
+				/* LCOV_EXCL_STOP */
 			}
 		} else {
 			/* we are not fixing, but only checking */
@@ -818,9 +1408,12 @@ static int block_is_enabled(struct snapraid_state* state, block_off_t i, struct
 	/* now apply the filters */
 
 	/* if a parity is not excluded, include all blocks, even unused ones */
-	for (l = 0; l < state->level; ++l) {
-		if (!state->parity[l].is_excluded_by_filter) {
-			return 1;
+	/* but not in quick mode, as the parity is not checked */
+	if (!state->opt.quick) {
+		for (l = 0; l < state->level; ++l) {
+			if (!state->parity[l].is_excluded_by_filter) {
+				return 1;
+			}
 		}
 	}
 
@@ -847,9 +1440,210 @@ static int block_is_enabled(struct snapraid_state* state, block_off_t i, struct
 	return 0;
 }
 
+/**
+ * Order of the positions to process.
+ */
+struct snapraid_order {
+	block_off_t* priority_map; /**< Sorted positions of the priority files. */
+	block_off_t priority_max; /**< Number of priority positions. */
+	block_off_t priority_index; /**< Next priority position to return or to skip. */
+	block_off_t next; /**< Next position to return after the priority ones. */
+	block_off_t blockmax; /**< End of the positions. */
+	int is_priority; /**< If we are still returning the priority positions. */
+};
+
+static int position_compare(const void* void_a, const void* void_b)
+{
+	const block_off_t* a = void_a;
+	const block_off_t* b = void_b;
+
+	if (*a < *b)
+		return -1;
+	if (*a > *b)
+		return 1;
+	return 0;
+}
+
+/**
+ * Setup the order of the positions to process.
+ *
+ * The positions of the priority files come first, then all the others.
+ */
+static void order_init(struct snapraid_order* order, struct snapraid_handle* handle, unsigned diskmax, block_off_t blockstart, block_off_t blockmax)
+{
+	block_off_t count;
+	block_off_t k;
+	unsigned j;
+
+	/* count the blocks of the priority files */
+	count = 0;
+	for (j = 0; j < diskmax; ++j) {
+		tommy_node* node;
+
+		if (!handle[j].disk)
+			continue;
+
+		for (node = handle[j].disk->filelist; node != 0; node = node->next) {
+			struct snapraid_file* file = node->data;
+			if (file_flag_has(file, FILE_IS_PRIORITY))
+				count += file->blockmax;
+		}
+	}
+
+	order->priority_map = malloc_nofail((count + 1) * sizeof(block_off_t));
+
+	/* collect their positions in the range to process */
+	count = 0;
+	for (j = 0; j < diskmax; ++j) {
+		tommy_node* node;
+
+		if (!handle[j].disk)
+			continue;
+
+		for (node = handle[j].disk->filelist; node != 0; node = node->next) {
+			struct snapraid_file* file = node->data;
+
+			if (!file_flag_has(file, FILE_IS_PRIORITY))
+				continue;
+
+			for (k = 0; k < file->blockmax; ++k) {
+				block_off_t parity_pos = fs_file2par_get(handle[j].disk, file, k);
+				if (parity_pos >= blockstart && parity_pos < blockmax)
+					order->priority_map[count++] = parity_pos;
+			}
+		}
+	}
+
+	/* sort them, and remove duplicates of files in different disks */
+	qsort(order->priority_map, count, sizeof(block_off_t), position_compare);
+	order->priority_max = 0;
+	for (k = 0; k < count; ++k) {
+		if (order->priority_max == 0 || order->priority_map[order->priority_max - 1] != order->priority_map[k])
+			order->priority_map[order->priority_max++] = order->priority_map[k];
+	}
+
+	if (order->priority_max != 0)
+		msg_progress("Processing first %u positions of the priority files...\n", order->priority_max);
+
+	order->priority_index = 0;
+	order->next = blockstart;
+	order->blockmax = blockmax;
+	order->is_priority = 1;
+}
+
+static void order_done(struct snapraid_order* order)
+{
+	free(order->priority_map);
+}
+
+/**
+ * Get the next position to process.
+ * Return 0 at the end.
+ */
+static int order_next(struct snapraid_order* order, block_off_t* pos)
+{
+	/* first the priority positions */
+	if (order->is_priority) {
+		if (order->priority_index < order->priority_max) {
+			*pos = order->priority_map[order->priority_index++];
+			return 1;
+		}
+
+		/* restart from the first one to skip them */
+		order->priority_index = 0;
+		order->is_priority = 0;
+	}
+
+	/* then all the others */
+	while (order->next < order->blockmax) {
+		block_off_t i = order->next++;
+
+		/* skip positions already processed */
+		if (order->priority_index < order->priority_max && order->priority_map[order->priority_index] == i) {
+			++order->priority_index;
+			continue;
+		}
+
+		*pos = i;
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Number of parity levels to read in quick mode.
+ *
+ * It's the number of bad blocks, plus one to verify the recovering
+ * if none of them has a hash.
+ */
+static unsigned parity_quick_count(struct failed_struct* failed, unsigned failed_count)
+{
+	unsigned bad;
+	int has_hash;
+	unsigned j;
+
+	bad = 0;
+	has_hash = 0;
+	for (j = 0; j < failed_count; ++j) {
+		if (failed[j].is_bad) {
+			++bad;
+			if (block_has_updated_hash(failed[j].block))
+				has_hash = 1;
+		}
+	}
+
+	if (bad == 0)
+		return 0;
+	if (has_hash)
+		return bad;
+	return bad + 1;
+}
+
+/**
+ * Read the parity levels not yet read, until the specified number of them is available.
+ *
+ * The parity levels not read have ::parity_unread set, and a 0 in ::buffer_recov.
+ */
+static void parity_read_count(struct snapraid_state* state, struct snapraid_parity_handle** parity, block_off_t i, unsigned count, void** buffer, unsigned diskmax, void** buffer_recov, int* parity_unread, unsigned* error)
+{
+	unsigned avail;
+	unsigned l;
+	int ret;
+
+	/* count the parity already available */
+	avail = 0;
+	for (l = 0; l < state->level; ++l)
+		if (buffer_recov[l] != 0)
+			++avail;
+
+	for (l = 0; l < state->level && avail < count; ++l) {
+		if (!parity_unread[l])
+			continue;
+
+		parity_unread[l] = 0;
+
+		if (parity[l]) {
+			buffer_recov[l] = buffer[diskmax + state->level + l];
+
+			ret = parity_read(parity[l], i, buffer_recov[l], state->block_size, log_error);
+			if (ret == -1) {
+				buffer_recov[l] = 0; /* no parity to use */
+
+				log_tag("parity_error:%u:%s: Read error\n", i, lev_config_name(l));
+				++*error;
+			} else {
+				++avail;
+			}
+		}
+	}
+}
+
 static int state_check_process(struct snapraid_state* state, int fix, struct snapraid_parity_handle** parity, block_off_t blockstart, block_off_t blockmax)
 {
 	struct snapraid_handle* handle;
+	struct snapraid_write_queue* write;
+	struct snapraid_post_queue* post;
 	unsigned diskmax;
 	block_off_t i;
 	unsigned j;
@@ -865,6 +1659,7 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 	unsigned recovered_error;
 	struct failed_struct* failed;
 	unsigned* failed_map;
+	struct snapraid_order order;
 	unsigned l;
 	char esc_buffer[ESC_MAX];
 	char esc_buffer_alt[ESC_MAX];
@@ -885,11 +1680,25 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 	failed = malloc_nofail(diskmax * sizeof(struct failed_struct));
 	failed_map = malloc_nofail(diskmax * sizeof(unsigned));
 
+	/* queues of the writes of the recovered blocks, and of the metadata operations */
+	/* to finalize the fixed files */
+	write = 0;
+	post = 0;
+	if (fix) {
+		write = malloc_nofail(diskmax * sizeof(struct snapraid_write_queue));
+		post = malloc_nofail(diskmax * sizeof(struct snapraid_post_queue));
+		for (j = 0; j < diskmax; ++j) {
+			write_init(&write[j], handle[j].disk, state->block_size);
+			post_init(&post[j], handle[j].disk, &write[j]);
+		}
+	}
+
 	error = 0;
 	unrecoverable_error = 0;
 	recovered_error = 0;
 
 	/* first count the number of blocks to process */
+	profile_begin("plan");
 	countmax = 0;
 	for (i = blockstart; i < blockmax; ++i) {
 		if (!block_is_enabled(state, i, handle, diskmax))
@@ -897,11 +1706,28 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 		++countmax;
 	}
 
+	/* all the blocks of the files are still to process */
+	for (j = 0; j < diskmax; ++j) {
+		tommy_node* node;
+
+		if (!handle[j].disk)
+			continue;
+
+		for (node = handle[j].disk->filelist; node != 0; node = node->next) {
+			struct snapraid_file* file = node->data;
+			file->pending = file->blockmax;
+		}
+	}
+	profile_end();
+
+	/* process first the positions of the priority files */
+	order_init(&order, handle, diskmax, blockstart, blockmax);
+
 	/* check all the blocks in files */
 	countsize = 0;
 	countpos = 0;
 	state_progress_begin(state, blockstart, blockmax, countmax);
-	for (i = blockstart; i < blockmax; ++i) {
+	while (order_next(&order, &i)) {
 		unsigned failed_count;
 		int valid_parity;
 		int used_parity;
@@ -910,7 +1736,7 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 
 		if (!block_is_enabled(state, i, handle, diskmax)) {
 			/* post process the files */
-			ret = file_post(state, fix, i, handle, diskmax);
+			ret = file_post(state, fix, i, handle, post, diskmax);
 			if (ret == -1) {
 				/* LCOV_EXCL_START */
 				log_fatal("Stopping at block %u\n", i);
@@ -946,6 +1772,7 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 		for (j = 0; j < diskmax; ++j) {
 			int read_size;
 			unsigned char hash[HASH_MAX];
+			int is_zero;
 			struct snapraid_disk* disk;
 			struct snapraid_block* block;
 			struct snapraid_file* file;
@@ -1030,7 +1857,7 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 				/* if fixing, and the file is not excluded, we must open for writing */
 				if (fix && !file_flag_has(file, FILE_IS_EXCLUDED)) {
 					/* if fixing, create the file, open for writing and resize if required */
-					ret = handle_create(&handle[j], file, state->file_mode);
+					ret = handle_create(&handle[j], file, handle[j].disk->file_mode);
 					if (ret == -1) {
 						/* LCOV_EXCL_START */
 						if (errno == EACCES) {
@@ -1049,11 +1876,24 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 						/* if fragmented, it may be reopened, so remember that the file */
 						/* was originally missing */
 						file_flag_set(file, FILE_IS_CREATED);
+
+						/* reserve the space, as the blocks are written in background */
+						if (!state->opt.skip_fallocate) {
+							ret = handle_reserve(&handle[j], file->size);
+							if (ret == -1) {
+								/* LCOV_EXCL_START */
+								log_fatal("WARNING! Without a working data disk, it isn't possible to fix errors on it.\n");
+								log_fatal("Stopping at block %u\n", i);
+								++unrecoverable_error;
+								goto bail;
+								/* LCOV_EXCL_STOP */
+							}
+						}
 					}
 				} else {
 					/* open the file only for reading */
 					if (!file_flag_has(file, FILE_IS_MISSING))
-						ret = handle_open(&handle[j], file, state->file_mode,
+						ret = handle_open(&handle[j], file, handle[j].disk->file_mode,
 							log_error, state->opt.expected_missing ? log_expected : 0);
 					else
 						ret = -1; /* if the file is missing, we cannot open it */
@@ -1169,11 +2009,12 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 
 			assert(block_state == BLOCK_STATE_BLK || block_state == BLOCK_STATE_REP);
 
-			/* compute the hash of the block just read */
+			/* compute the hash of the block just read, with zero blocks having a precomputed hash */
+			is_zero = memiszero(buffer[j], read_size);
 			if (rehash) {
-				memhash(state->prevhash, state->prevhashseed, hash, buffer[j], read_size);
+				memhash_zero(&state->zerohash, state->prevhash, state->prevhashseed, hash, buffer[j], read_size, is_zero);
 			} else {
-				memhash(state->hash, state->hashseed, hash, buffer[j], read_size);
+				memhash_zero(&state->zerohash, state->hash, state->hashseed, hash, buffer[j], read_size, is_zero);
 			}
 
 			/* compare the hash */
@@ -1216,34 +2057,38 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 		/* now read and check the parity if requested */
 		if (!state->opt.auditonly) {
 			void* buffer_recov[LEV_MAX];
+			int parity_unread[LEV_MAX];
 			void* buffer_zero;
+			unsigned parity_count;
 
-			/* buffers for parity read and not computed */
-			for (l = 0; l < state->level; ++l)
-				buffer_recov[l] = buffer[diskmax + state->level + l];
-			for (; l < LEV_MAX; ++l)
+			/* buffers for parity read and not computed, set when read */
+			for (l = 0; l < LEV_MAX; ++l) {
 				buffer_recov[l] = 0;
+				parity_unread[l] = 1;
+			}
 
 			/* the zero buffer is the last one */
 			buffer_zero = buffer[buffermax - 1];
 
-			/* read the parity */
-			for (l = 0; l < state->level; ++l) {
-				if (parity[l]) {
-					ret = parity_read(parity[l], i, buffer_recov[l], state->block_size, log_error);
-					if (ret == -1) {
-						buffer_recov[l] = 0; /* no parity to use */
+			/* in quick mode read only the parity needed to recover */
+			if (state->opt.quick)
+				parity_count = parity_quick_count(failed, failed_count);
+			else
+				parity_count = state->level;
 
-						log_tag("parity_error:%u:%s: Read error\n", i, lev_config_name(l));
-						++error;
-					}
-				} else {
-					buffer_recov[l] = 0;
-				}
-			}
+			/* read the parity */
+			parity_read_count(state, parity, i, parity_count, buffer, diskmax, buffer_recov, parity_unread, &error);
 
 			/* try all the recovering strategies */
 			ret = repair(state, rehash, i, diskmax, failed, failed_map, failed_count, buffer, buffer_recov, buffer_zero);
+			if (ret != 0 && parity_count < state->level) {
+				/* if it fails, read all the remaining parity and try again */
+				log_tag("recover_quick:%u: Retry with all the parity\n", i);
+
+				parity_read_count(state, parity, i, state->level, buffer, diskmax, buffer_recov, parity_unread, &error);
+
+				ret = repair(state, rehash, i, diskmax, failed, failed_map, failed_count, buffer, buffer_recov, buffer_zero);
+			}
 			if (ret != 0) {
 				/* increment the number of errors */
 				if (ret > 0)
@@ -1316,7 +2161,9 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 							|| (state->opt.syncedonly && file_flag_has(failed[j].file, FILE_IS_UNSYNCED)))
 							continue;
 
-						ret = handle_write(failed[j].handle, failed[j].file_pos, buffer[failed[j].index], state->block_size);
+						/* queue the write in the disk writer, to write all the disks at the same time */
+						/* the block is reported as recovered only after the write is completed */
+						ret = write_push(&write[failed[j].index], &failed[j], i, buffer[failed[j].index]);
 						if (ret == -1) {
 							/* LCOV_EXCL_START */
 							/* mark the file as damaged */
@@ -1333,20 +2180,6 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 							goto bail;
 							/* LCOV_EXCL_STOP */
 						}
-
-						/* if we are not sure that the recovered content is uptodate */
-						if (failed[j].is_outofdate) {
-							/* mark the file as damaged */
-							file_flag_set(failed[j].file, FILE_IS_DAMAGED);
-							continue;
-						}
-
-						/* mark the file as containing some fixes */
-						/* note that it could be also marked as damaged in other iterations */
-						file_flag_set(failed[j].file, FILE_IS_FIXED);
-
-						log_tag("fixed:%u:%s:%s: Fixed data error at position %u\n", i, failed[j].disk->name, esc_tag(failed[j].file->sub, esc_buffer), failed[j].file_pos);
-						++recovered_error;
 					}
 
 					/*
@@ -1364,6 +2197,8 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 						for (l = 0; l < state->level; ++l) {
 							/* if the parity on disk is wrong */
 							if (buffer_recov[l] == 0
+							        /* and it was read, or at least tried */
+								&& !parity_unread[l]
 							        /* and we have access at the parity */
 								&& parity[l] != 0
 							        /* and the parity is not excluded */
@@ -1406,7 +2241,7 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 		}
 
 		/* post process the files */
-		ret = file_post(state, fix, i, handle, diskmax);
+		ret = file_post(state, fix, i, handle, post, diskmax);
 		if (ret == -1) {
 			/* LCOV_EXCL_START */
 			log_fatal("Stopping at block %u\n", i);
@@ -1430,21 +2265,23 @@ static int state_check_process(struct snapraid_state* state, int fix, struct sna
 	for (i = 0; i < diskmax; ++i) {
 		tommy_node* node;
 		struct snapraid_disk* disk;
+		struct snapraid_file** file_map;
+		unsigned file_count;
+		unsigned file_index;
 
 		if (!handle[i].disk)
 			continue;
 
-		/* for each empty file in the disk */
+		/* for each empty file in the disk, in directory order */
 		disk = handle[i].disk;
-		node = disk->filelist;
-		while (node) {
+		file_map = fs_file_order(disk, &file_count);
+		for (file_index = 0; file_index < file_count; ++file_index) {
 			char path[PATH_MAX];
 			struct stat st;
 			struct snapraid_file* file;
 			int unsuccesful = 0;
 
-			file = node->data;
-			node = node->next; /* next node */
+			file = file_map[file_index];
 
 			/* if not empty, it's already checked and continue to the next one */
 			if (file->size != 0) {
@@ -1802,6 +2639,35 @@ bail:
 		}
 	}
 
+	/* complete all the writes and metadata operations queued */
+	if (fix) {
+		for (j = 0; j < diskmax; ++j) {
+			if (write_flush(&write[j]) != 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("WARNING! Without a working data disk, it isn't possible to fix errors on it.\n");
+				++unrecoverable_error;
+				/* continue, as we are already exiting */
+				/* LCOV_EXCL_STOP */
+			}
+
+			/* count the blocks with the write completed */
+			recovered_error += write[j].recovered;
+		}
+		for (j = 0; j < diskmax; ++j) {
+			if (post_done(&post[j]) != 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("WARNING! Without a working data disk, it isn't possible to fix errors on it.\n");
+				++unrecoverable_error;
+				/* continue, as we are already exiting */
+				/* LCOV_EXCL_STOP */
+			}
+		}
+		for (j = 0; j < diskmax; ++j)
+			write_done(&write[j]);
+		free(post);
+		free(write);
+	}
+
 	/* remove all the files created from scratch that have not finished the processing */
 	/* it happens only when aborting pressing Ctrl+C or other reason. */
 	if (fix) {
@@ -1904,6 +2770,7 @@ bail:
 	}
 	log_flush();
 
+	order_done(&order);
 	free(failed);
 	free(failed_map);
 	free(handle);
@@ -1973,7 +2840,7 @@ int state_check(struct snapraid_state* state, int fix, block_off_t blockstart, b
 			}
 
 			parity_ptr[l] = &parity[l];
-			ret = parity_create(parity_ptr[l], &state->parity[l], l, state->file_mode, state->block_size, state->opt.parity_limit_size);
+			ret = parity_create(parity_ptr[l], &state->parity[l], l, state->parity[l].file_mode, state->block_size, state->opt.parity_limit_size);
 			if (ret == -1) {
 				/* LCOV_EXCL_START */
 				log_fatal("WARNING! Without an accessible %s file, it isn't possible to fix any error.\n", lev_name(l));
@@ -1994,7 +2861,7 @@ int state_check(struct snapraid_state* state, int fix, block_off_t blockstart, b
 		/* it may fail if the file doesn't exist, in this case we continue to check the files */
 		for (l = 0; l < state->level; ++l) {
 			parity_ptr[l] = &parity[l];
-			ret = parity_open(parity_ptr[l], &state->parity[l], l, state->file_mode, state->block_size, state->opt.parity_limit_size);
+			ret = parity_open(parity_ptr[l], &state->parity[l], l, state->parity[l].file_mode, state->block_size, state->opt.parity_limit_size);
 			if (ret == -1) {
 				msg_status("No accessible %s file, only files will be checked.\n", lev_name(l));
 				/* continue anyway */
@@ -2018,7 +2885,9 @@ int state_check(struct snapraid_state* state, int fix, block_off_t blockstart, b
 
 	/* skip degenerated cases of empty parity, or skipping all */
 	if (blockstart < blockmax) {
+		profile_begin(fix ? "fix" : "check");
 		ret = state_check_process(state, fix, parity_ptr, blockstart, blockmax);
+		profile_end();
 		if (ret == -1) {
 			/* LCOV_EXCL_START */
 			++error;
@@ -0,0 +1,568 @@
+/*
+ * Copyright (C) 2011 Andrea Mazzoleni
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "portable.h"
+
+#include "support.h"
+#include "elem.h"
+#include "state.h"
+#include "parity.h"
+
+/****************************************************************************/
+/* compact */
+
+/**
+ * Check if a block can be moved to another parity position.
+ *
+ * Only blocks synced and without errors are moved, because the
+ * relocation keeps their hash to verify the data at the new position.
+ */
+static int compact_is_movable(struct snapraid_state* state, struct snapraid_block* block, block_off_t parity_pos)
+{
+	if (block_state_get(block) != BLOCK_STATE_BLK)
+		return 0;
+
+	if (info_get_bad(info_get(&state->infoarr, parity_pos)))
+		return 0;
+
+	return 1;
+}
+
+/**
+ * Compute the parity size after the compaction.
+ *
+ * It's the max number of blocks used in a disk, increased
+ * to include all the blocks that cannot be moved.
+ */
+static block_off_t compact_size(struct snapraid_state* state, block_off_t blockmax)
+{
+	block_off_t compactmax;
+	tommy_node* i;
+
+	compactmax = 0;
+	for (i = state->disklist; i != 0; i = i->next) {
+		struct snapraid_disk* disk = i->data;
+		block_off_t used;
+		block_off_t j;
+
+		used = 0;
+		for (j = 0; j < blockmax; ++j) {
+			if (block_has_file(fs_par2block_find(disk, j)))
+				++used;
+		}
+
+		if (compactmax < used)
+			compactmax = used;
+	}
+
+	for (i = state->disklist; i != 0; i = i->next) {
+		struct snapraid_disk* disk = i->data;
+		block_off_t j;
+
+		for (j = compactmax; j < blockmax; ++j) {
+			struct snapraid_block* block = fs_par2block_find(disk, j);
+
+			if (block_has_file(block) && !compact_is_movable(state, block, j))
+				compactmax = j + 1;
+		}
+	}
+
+	return compactmax;
+}
+
+/**
+ * Move all the blocks in the specified range of parity positions
+ * in the free positions before the range.
+ *
+ * The old positions are kept as DELETED, with the hash of the data
+ * still contained in the parity, and the new ones are REP, with
+ * the hash used to verify the data when syncing.
+ * Until the sync completes, the parity of the new positions doesn't
+ * include the moved blocks, and neither they nor the blocks of the
+ * other disks in these positions can be recovered.
+ *
+ * Return the number of blocks moved.
+ */
+static block_off_t compact_move(struct snapraid_state* state, block_off_t blockstart, block_off_t blockmax)
+{
+	block_off_t count;
+	tommy_node* i;
+	char esc_buffer[ESC_MAX];
+
+	count = 0;
+	for (i = state->disklist; i != 0; i = i->next) {
+		struct snapraid_disk* disk = i->data;
+		struct snapraid_file* deleted;
+		block_off_t deleted_count;
+		block_off_t deleted_idx;
+		block_off_t hole;
+		block_off_t j;
+
+		deleted_count = 0;
+		for (j = blockstart; j < blockmax; ++j) {
+			if (block_has_file(fs_par2block_find(disk, j)))
+				++deleted_count;
+		}
+
+		if (deleted_count == 0)
+			continue;
+
+		/* the old blocks are moved in a fake deleted file, */
+		/* like the runs of deleted blocks read from the content file */
+		deleted = file_alloc(state->block_size, "<deleted>", deleted_count * (data_off_t)state->block_size, 0, 0, 0, 0);
+		file_flag_set(deleted, FILE_IS_DELETED);
+		tommy_list_insert_tail(&disk->deletedlist, &deleted->nodelist, deleted);
+
+		deleted_idx = 0;
+		hole = 0;
+		for (j = blockstart; j < blockmax; ++j) {
+			struct snapraid_block* block = fs_par2block_find(disk, j);
+			struct snapraid_block* deleted_block;
+			struct snapraid_file* file;
+			block_off_t file_pos;
+
+			if (!block_has_file(block))
+				continue;
+
+			/* search the first free position */
+			while (block_has_file(fs_par2block_find(disk, hole)))
+				++hole;
+
+			if (hole >= blockstart) {
+				/* LCOV_EXCL_START */
+				log_fatal("Internal inconsistency in compacting disk '%s' at position '%u'\n", disk->name, j);
+				os_abort();
+				/* LCOV_EXCL_STOP */
+			}
+
+			file = fs_par2file_get(disk, j, &file_pos);
+
+			fs_deallocate(disk, j);
+
+			/* the old position keeps the hash of the data in the parity */
+			deleted_block = fs_file2block_get(deleted, deleted_idx);
+			block_state_set(deleted_block, BLOCK_STATE_DELETED);
+			memcpy(deleted_block->hash, block->hash, BLOCK_HASH_SIZE);
+			fs_allocate(disk, j, deleted, deleted_idx);
+			++deleted_idx;
+
+			/* allocate the block in the free position */
+			if (fs_par2block_find(disk, hole) != BLOCK_NULL)
+				fs_deallocate(disk, hole);
+
+			/* the hash is kept, but the parity has to be updated */
+			block_state_set(block, BLOCK_STATE_REP);
+
+			fs_allocate(disk, hole, file, file_pos);
+
+			log_tag("compact:%s:%s:%u:%u:%u\n", disk->name, esc_tag(file->sub, esc_buffer), file_pos, j, hole);
+
+			++count;
+		}
+	}
+
+	if (count != 0) {
+		/* state changed */
+		state->need_write = 1;
+	}
+
+	return count;
+}
+
+void state_compact(struct snapraid_state* state)
+{
+	block_off_t blockmax;
+	block_off_t compactmax;
+	block_off_t count;
+
+	/* the hashes of the relocated blocks must be of the current kind */
+	if (state->prevhash != HASH_UNDEFINED) {
+		msg_progress("Skipping compaction because a rehash is in progress.\n");
+		return;
+	}
+
+	msg_progress("Compacting...\n");
+
+	blockmax = parity_allocated_size(state);
+	compactmax = compact_size(state, blockmax);
+
+	/* keep the blocks of the last position, to keep the parity size */
+	/* and the hash of the moved blocks until they are synced again */
+	count = 0;
+	if (compactmax + 1 < blockmax)
+		count = compact_move(state, compactmax, blockmax - 1);
+
+	msg_progress("Moved %u blocks to shrink the parity from %u to %u blocks.\n", count, blockmax, compactmax);
+
+	log_tag("summary:compact_block_count:%u\n", count);
+	log_tag("summary:compact_blockmax:%u\n", blockmax);
+	log_tag("summary:compact_compactmax:%u\n", compactmax);
+	log_flush();
+}
+
+block_off_t state_compact_finish(struct snapraid_state* state)
+{
+	block_off_t blockmax;
+	block_off_t compactmax;
+
+	if (state->prevhash != HASH_UNDEFINED)
+		return 0;
+
+	blockmax = parity_allocated_size(state);
+	compactmax = compact_size(state, blockmax);
+
+	if (compactmax >= blockmax)
+		return 0;
+
+	return compact_move(state, compactmax, blockmax);
+}
+
+/****************************************************************************/
+/* defrag */
+
+/**
+ * Fragmented file candidate to the relocation.
+ */
+struct defrag_file {
+	struct snapraid_disk* disk; /**< Disk of the file. */
+	struct snapraid_file* file; /**< File to relocate. */
+	block_off_t fragment; /**< Number of extra fragments. */
+};
+
+/**
+ * Run of free parity positions in a disk.
+ */
+struct defrag_run {
+	block_off_t pos; /**< First free position. */
+	block_off_t count; /**< Number of free positions. */
+};
+
+/**
+ * Free runs of a disk.
+ */
+struct defrag_disk {
+	struct snapraid_disk* disk; /**< Disk. */
+	struct defrag_run* run_map; /**< Free runs, or 0 if not yet collected. */
+	unsigned run_max; /**< Number of free runs. */
+};
+
+/**
+ * Sort the candidates from the most fragmented.
+ */
+static int defrag_compare(const void* void_a, const void* void_b)
+{
+	const struct defrag_file* a = void_a;
+	const struct defrag_file* b = void_b;
+
+	if (a->fragment > b->fragment)
+		return -1;
+	if (a->fragment < b->fragment)
+		return 1;
+
+	/* prefer smaller files, to fix more files with the same budget */
+	if (a->file->blockmax < b->file->blockmax)
+		return -1;
+	if (a->file->blockmax > b->file->blockmax)
+		return 1;
+
+	return 0;
+}
+
+/**
+ * Return the number of extra fragments of a file, or 0 if the file cannot be relocated.
+ *
+ * Only files fully synced and without errors are relocated, because the
+ * relocation keeps their hash to verify the data when written at the new position.
+ */
+static block_off_t defrag_fragment(struct snapraid_state* state, struct snapraid_disk* disk, struct snapraid_file* file)
+{
+	block_off_t fragment;
+	block_off_t prev_pos;
+	block_off_t i;
+
+	fragment = 0;
+	prev_pos = POS_NULL;
+	for (i = 0; i < file->blockmax; ++i) {
+		struct snapraid_block* block = fs_file2block_get(file, i);
+		block_off_t parity_pos = fs_file2par_get(disk, file, i);
+		snapraid_info info;
+
+		if (block_state_get(block) != BLOCK_STATE_BLK)
+			return 0;
+
+		info = info_get(&state->infoarr, parity_pos);
+		if (info_get_bad(info))
+			return 0;
+
+		if (i != 0 && prev_pos + 1 != parity_pos)
+			++fragment;
+		prev_pos = parity_pos;
+	}
+
+	return fragment;
+}
+
+/**
+ * Collect all the runs of free positions of a disk.
+ */
+static void defrag_run(struct defrag_disk* dd, struct snapraid_disk* disk, block_off_t blockmax)
+{
+	block_off_t i;
+	unsigned run_alloc;
+
+	run_alloc = 16;
+	dd->run_map = malloc_nofail(run_alloc * sizeof(struct defrag_run));
+	dd->run_max = 0;
+
+	i = 0;
+	while (i < blockmax) {
+		block_off_t begin;
+
+		/* skip the used positions */
+		while (i < blockmax && block_has_file(fs_par2block_find(disk, i)))
+			++i;
+
+		begin = i;
+
+		while (i < blockmax && !block_has_file(fs_par2block_find(disk, i)))
+			++i;
+
+		if (i == begin)
+			continue;
+
+		if (dd->run_max == run_alloc) {
+			struct defrag_run* run_map;
+
+			run_alloc *= 2;
+			run_map = malloc_nofail(run_alloc * sizeof(struct defrag_run));
+			memcpy(run_map, dd->run_map, dd->run_max * sizeof(struct defrag_run));
+			free(dd->run_map);
+			dd->run_map = run_map;
+		}
+
+		dd->run_map[dd->run_max].pos = begin;
+		dd->run_map[dd->run_max].count = i - begin;
+		++dd->run_max;
+	}
+}
+
+/**
+ * Find the smallest run with the specified number of free positions.
+ * Return POS_NULL if not found.
+ */
+static block_off_t defrag_fit(struct defrag_disk* dd, block_off_t count)
+{
+	struct defrag_run* best;
+	block_off_t pos;
+	unsigned i;
+
+	best = 0;
+	for (i = 0; i < dd->run_max; ++i) {
+		struct defrag_run* run = &dd->run_map[i];
+		if (run->count >= count && (!best || run->count < best->count))
+			best = run;
+	}
+
+	if (!best)
+		return POS_NULL;
+
+	pos = best->pos;
+	best->pos += count;
+	best->count -= count;
+
+	return pos;
+}
+
+/**
+ * Move a file in a contiguous run of parity positions.
+ *
+ * The old positions are kept as DELETED, with the hash of the data
+ * still contained in the parity, and the new ones are REP, with
+ * the hash used to verify the data when syncing.
+ * Until the sync completes, the parity of the new positions doesn't
+ * include the file, and neither the file nor the blocks of the other
+ * disks in these positions can be recovered.
+ */
+static void defrag_move(struct snapraid_state* state, struct snapraid_disk* disk, struct snapraid_file* file, block_off_t pos)
+{
+	struct snapraid_file* deleted;
+	block_off_t* old_map;
+	block_off_t i;
+
+	/* state changed */
+	state->need_write = 1;
+
+	old_map = malloc_nofail(file->blockmax * sizeof(block_off_t));
+	for (i = 0; i < file->blockmax; ++i)
+		old_map[i] = fs_file2par_get(disk, file, i);
+
+	/* the old blocks are moved in a deleted copy of the file */
+	deleted = file_dup(file);
+
+	for (i = 0; i < file->blockmax; ++i)
+		fs_deallocate(disk, old_map[i]);
+
+	for (i = 0; i < file->blockmax; ++i) {
+		block_state_set(fs_file2block_get(deleted, i), BLOCK_STATE_DELETED);
+		fs_allocate(disk, old_map[i], deleted, i);
+	}
+
+	file_flag_set(deleted, FILE_IS_DELETED);
+	tommy_list_insert_tail(&disk->deletedlist, &deleted->nodelist, deleted);
+
+	/* allocate the file in the new positions */
+	for (i = 0; i < file->blockmax; ++i) {
+		struct snapraid_block* over_block = fs_par2block_find(disk, pos + i);
+
+		if (over_block != BLOCK_NULL)
+			fs_deallocate(disk, pos + i);
+
+		/* the hash is kept, but the parity has to be updated */
+		block_state_set(fs_file2block_get(file, i), BLOCK_STATE_REP);
+
+		fs_allocate(disk, pos + i, file, i);
+	}
+
+	free(old_map);
+}
+
+void state_defrag(struct snapraid_state* state)
+{
+	struct defrag_file* defrag_map;
+	struct defrag_disk* disk_map;
+	unsigned disk_max;
+	unsigned defrag_max;
+	unsigned defrag_alloc;
+	block_off_t blockmax;
+	block_off_t budget;
+	unsigned file_count;
+	block_off_t block_count;
+	block_off_t fragment_count;
+	tommy_node* i;
+	unsigned j;
+	char esc_buffer[ESC_MAX];
+
+	/* the hashes of the relocated blocks must be of the current kind */
+	if (state->prevhash != HASH_UNDEFINED) {
+		msg_progress("Skipping defrag because a rehash is in progress.\n");
+		return;
+	}
+
+	msg_progress("Defragmenting...\n");
+
+	blockmax = parity_allocated_size(state);
+
+	/* don't use the free positions at the end, that the compaction is releasing */
+	if (state->opt.compact)
+		blockmax = compact_size(state, blockmax);
+
+	/* collect the fragmented files */
+	defrag_alloc = 16;
+	defrag_map = malloc_nofail(defrag_alloc * sizeof(struct defrag_file));
+	defrag_max = 0;
+	for (i = state->disklist; i != 0; i = i->next) {
+		struct snapraid_disk* disk = i->data;
+		tommy_node* k;
+
+		for (k = disk->filelist; k != 0; k = k->next) {
+			struct snapraid_file* file = k->data;
+			block_off_t fragment;
+
+			fragment = defrag_fragment(state, disk, file);
+			if (fragment == 0)
+				continue;
+
+			if (defrag_max == defrag_alloc) {
+				struct defrag_file* map;
+
+				defrag_alloc *= 2;
+				map = malloc_nofail(defrag_alloc * sizeof(struct defrag_file));
+				memcpy(map, defrag_map, defrag_max * sizeof(struct defrag_file));
+				free(defrag_map);
+				defrag_map = map;
+			}
+
+			defrag_map[defrag_max].disk = disk;
+			defrag_map[defrag_max].file = file;
+			defrag_map[defrag_max].fragment = fragment;
+			++defrag_max;
+		}
+	}
+
+	qsort(defrag_map, defrag_max, sizeof(struct defrag_file), defrag_compare);
+
+	/* the free runs are collected only for the disks with fragmented files */
+	disk_max = tommy_list_count(&state->disklist);
+	disk_map = malloc_nofail(disk_max * sizeof(struct defrag_disk));
+	for (j = 0, i = state->disklist; i != 0; ++j, i = i->next) {
+		disk_map[j].disk = i->data;
+		disk_map[j].run_map = 0;
+	}
+
+	budget = state->opt.defrag;
+	file_count = 0;
+	block_count = 0;
+	fragment_count = 0;
+	for (j = 0; j < defrag_max && budget != 0; ++j) {
+		struct snapraid_disk* disk = defrag_map[j].disk;
+		struct snapraid_file* file = defrag_map[j].file;
+		struct defrag_disk* dd;
+		block_off_t pos;
+		unsigned d;
+
+		if (file->blockmax > budget)
+			continue;
+
+		dd = disk_map;
+		for (d = 0; d < disk_max; ++d) {
+			if (disk_map[d].disk == disk) {
+				dd = &disk_map[d];
+				break;
+			}
+		}
+
+		if (!dd->run_map)
+			defrag_run(dd, disk, blockmax);
+
+		pos = defrag_fit(dd, file->blockmax);
+		if (pos == POS_NULL)
+			continue;
+
+		log_tag("defrag:%s:%s:%u:%u:%u\n", disk->name, esc_tag(file->sub, esc_buffer), file->blockmax, defrag_map[j].fragment, pos);
+
+		defrag_move(state, disk, file, pos);
+
+		budget -= file->blockmax;
+		++file_count;
+		block_count += file->blockmax;
+		fragment_count += defrag_map[j].fragment;
+	}
+
+	for (j = 0; j < disk_max; ++j)
+		free(disk_map[j].run_map);
+	free(disk_map);
+	free(defrag_map);
+
+	msg_progress("Relocated %u of %u fragmented files, for %u blocks and %u fragments.\n", file_count, defrag_max, block_count, fragment_count);
+
+	log_tag("summary:defrag_fragmented_file_count:%u\n", defrag_max);
+	log_tag("summary:defrag_file_count:%u\n", file_count);
+	log_tag("summary:defrag_block_count:%u\n", block_count);
+	log_tag("summary:defrag_fragment_count:%u\n", fragment_count);
+	log_flush();
+}
+
@@ -19,6 +19,7 @@
 
 #include "support.h"
 #include "state.h"
+#include "parity.h"
 #include "raid/raid.h"
 
 /**
@@ -606,7 +607,7 @@ static double raid_prob_of_one_or_more_failures(double array_failure_rate, doubl
 	return poisson_prob_n_or_more_failures(raid_failure_rate, 1);
 }
 
-static void state_smart(unsigned n, tommy_list* low)
+static void state_smart(struct snapraid_state* state, unsigned n, tommy_list* low)
 {
 	tommy_node* i;
 	unsigned j;
@@ -793,6 +794,8 @@ static void state_smart(unsigned n, tommy_list* low)
 	printf("Probability that at least one disk is going to fail in the next year is %.0f%%.\n", p_at_least_one_failure * 100);
 	log_tag("summary:array_failure:%g:%g\n", array_failure_rate, p_at_least_one_failure);
 
+	state_perf_slow(state);
+
 	/* print extra stats only in verbose mode */
 	if (msg_level < MSG_VERBOSE)
 		goto bail;
@@ -993,10 +996,124 @@ void state_device(struct snapraid_state* state, int operation, tommy_list* filte
 		}
 
 		if (operation == DEVICE_SMART)
-			state_smart(state->level + tommy_list_count(&state->disklist), &low);
+			state_smart(state, state->level + tommy_list_count(&state->disklist), &low);
 	}
 
 	tommy_list_foreach(&high, free);
 	tommy_list_foreach(&low, free);
 }
 
+/**
+ * Max weight given by the SMART Annual Failure Rate.
+ */
+#define RISK_AFR_MAX 4.0
+
+/**
+ * Weight added by the presence of bad blocks.
+ */
+#define RISK_BAD 1.0
+
+void state_risk(struct snapraid_state* state)
+{
+	tommy_node* i;
+	tommy_list high;
+	tommy_list low;
+	block_off_t blockmax;
+	block_off_t b;
+	int ret;
+
+	msg_progress("Estimating the disks risk...\n");
+
+	tommy_list_init(&high);
+	tommy_list_init(&low);
+
+	for (i = state->disklist; i != 0; i = i->next) {
+		struct snapraid_disk* disk = i->data;
+		devinfo_t* entry;
+
+		entry = calloc_nofail(1, sizeof(devinfo_t));
+
+		entry->device = disk->device;
+		pathcpy(entry->name, sizeof(entry->name), disk->name);
+		pathcpy(entry->mount, sizeof(entry->mount), disk->dir);
+		pathcpy(entry->smartctl, sizeof(entry->smartctl), disk->smartctl);
+
+		tommy_list_insert_tail(&high, &entry->node, entry);
+	}
+
+	if (state->opt.fake_device) {
+		tommy_node* j = tommy_list_head(&high);
+
+		ret = devtest(&low, DEVICE_SMART);
+
+		/* assign the fake devices to the disks in order */
+		for (i = tommy_list_head(&low); i != 0 && j != 0; i = i->next, j = j->next) {
+			devinfo_t* devinfo = i->data;
+			devinfo->parent = j->data;
+		}
+	} else {
+		ret = devquery(&high, &low, DEVICE_SMART, 0);
+	}
+
+	/* on error just ignore the SMART info */
+	if (ret != 0) {
+		/* LCOV_EXCL_START */
+		log_fatal("WARNING! Unable to get the SMART attributes. Only bad blocks are considered.\n");
+		/* LCOV_EXCL_STOP */
+	}
+
+	for (i = state->disklist; i != 0; i = i->next) {
+		struct snapraid_disk* disk = i->data;
+		tommy_node* j;
+		double afr = 0;
+
+		/* use the worst device of the disk */
+		for (j = tommy_list_head(&low); j != 0; j = j->next) {
+			devinfo_t* devinfo = j->data;
+			double r;
+
+			if (devinfo->parent == 0 || strcmp(devinfo->parent->name, disk->name) != 0)
+				continue;
+
+			r = smart_afr(devinfo->smart, devinfo->smart_model);
+			if (afr < r)
+				afr = r;
+		}
+
+		/* the weight of the AFR is linear, doubling the block age at 0.25 */
+		disk->risk = 1 + 4 * afr;
+		if (disk->risk > RISK_AFR_MAX)
+			disk->risk = RISK_AFR_MAX;
+
+		log_tag("risk:%s:afr:%g\n", disk->name, afr);
+	}
+
+	tommy_list_foreach(&high, free);
+	tommy_list_foreach(&low, free);
+
+	/* add the weight of bad blocks, as errors recently found */
+	blockmax = parity_allocated_size(state);
+	for (i = state->disklist; i != 0; i = i->next) {
+		struct snapraid_disk* disk = i->data;
+		block_off_t bad = 0;
+
+		for (b = 0; b < blockmax; ++b) {
+			snapraid_info info = info_get(&state->infoarr, b);
+
+			if (info == 0 || !info_get_bad(info))
+				continue;
+
+			if (block_has_file(fs_par2block_find(disk, b)))
+				++bad;
+		}
+
+		if (bad != 0)
+			disk->risk += RISK_BAD;
+
+		log_tag("risk:%s:bad:%u\n", disk->name, bad);
+		log_tag("risk:%s:weight:%g\n", disk->name, disk->risk);
+
+		if (disk->risk > 1)
+			msg_progress("Disk '%s' is scrubbed with a weight of %.1f for %s.\n", disk->name, disk->risk, bad != 0 ? "errors" : "SMART");
+	}
+}
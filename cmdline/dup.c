@@ -33,7 +33,7 @@ struct snapraid_hash {
 	unsigned char hash[HASH_MAX]; /**< Hash of the whole file. */
 
 	/* nodes for data structures */
-	tommy_hashdyn_node node;
+	tommy_hashlin_node node;
 };
 
 struct snapraid_hash* hash_alloc(struct snapraid_state* state, struct snapraid_disk* disk, struct snapraid_file* file)
@@ -88,14 +88,14 @@ int hash_compare(const void* void_arg, const void* void_data)
 
 void state_dup(struct snapraid_state* state)
 {
-	tommy_hashdyn hashset;
+	tommy_hashlin hashset;
 	tommy_node* i;
 	unsigned count;
 	data_off_t size;
 	char esc_buffer[ESC_MAX];
 	char esc_buffer_alt[ESC_MAX];
 
-	tommy_hashdyn_init(&hashset);
+	tommy_hashlin_init(&hashset);
 
 	count = 0;
 	size = 0;
@@ -125,7 +125,7 @@ void state_dup(struct snapraid_state* state)
 
 			hash32 = hash_hash(hash);
 
-			struct snapraid_hash* found = tommy_hashdyn_search(&hashset, hash_compare, hash->hash, hash32);
+			struct snapraid_hash* found = tommy_hashlin_search(&hashset, hash_compare, hash->hash, hash32);
 			if (found) {
 				++count;
 				size += found->file->size;
@@ -133,13 +133,13 @@ void state_dup(struct snapraid_state* state)
 				printf("%12" PRIu64 " %s = %s\n", file->size, fmt_term(disk, file->sub, esc_buffer), fmt_term(found->disk, found->file->sub, esc_buffer_alt));
 				hash_free(hash);
 			} else {
-				tommy_hashdyn_insert(&hashset, &hash->node, hash, hash32);
+				tommy_hashlin_insert(&hashset, &hash->node, hash, hash32);
 			}
 		}
 	}
 
-	tommy_hashdyn_foreach(&hashset, (tommy_foreach_func*)hash_free);
-	tommy_hashdyn_done(&hashset);
+	tommy_hashlin_foreach(&hashset, (tommy_foreach_func*)hash_free);
+	tommy_hashlin_done(&hashset);
 
 	msg_status("\n");
 	msg_status("%8u duplicates, for %" PRIu64 " GB\n", count, size / GIGA);
@@ -368,8 +368,8 @@ struct snapraid_file* file_alloc(unsigned block_size, const char* sub, data_off_
 	struct snapraid_file* file;
 	block_off_t i;
 
-	file = malloc_nofail(sizeof(struct snapraid_file));
-	file->sub = strdup_nofail(sub);
+	file = malloc_nofail_tag(sizeof(struct snapraid_file), MALLOC_FILE);
+	file->sub = strdup_nofail_tag(sub, MALLOC_PATH);
 	file->size = size;
 	file->blockmax = (size + block_size - 1) / block_size;
 	file->mtime_sec = mtime_sec;
@@ -377,7 +377,8 @@ struct snapraid_file* file_alloc(unsigned block_size, const char* sub, data_off_
 	file->inode = inode;
 	file->physical = physical;
 	file->flag = 0;
-	file->blockvec = malloc_nofail(file->blockmax * block_sizeof());
+	file->pending = 0;
+	file->blockvec = malloc_nofail_tag(file->blockmax * block_sizeof(), MALLOC_BLOCK);
 
 	for (i = 0; i < file->blockmax; ++i) {
 		struct snapraid_block* block = file_block(file, i);
@@ -393,8 +394,8 @@ struct snapraid_file* file_dup(struct snapraid_file* copy)
 	struct snapraid_file* file;
 	block_off_t i;
 
-	file = malloc_nofail(sizeof(struct snapraid_file));
-	file->sub = strdup_nofail(copy->sub);
+	file = malloc_nofail_tag(sizeof(struct snapraid_file), MALLOC_FILE);
+	file->sub = strdup_nofail_tag(copy->sub, MALLOC_PATH);
 	file->size = copy->size;
 	file->blockmax = copy->blockmax;
 	file->mtime_sec = copy->mtime_sec;
@@ -402,7 +403,8 @@ struct snapraid_file* file_dup(struct snapraid_file* copy)
 	file->inode = copy->inode;
 	file->physical = copy->physical;
 	file->flag = copy->flag;
-	file->blockvec = malloc_nofail(file->blockmax * block_sizeof());
+	file->pending = 0;
+	file->blockvec = malloc_nofail_tag(file->blockmax * block_sizeof(), MALLOC_BLOCK);
 
 	for (i = 0; i < file->blockmax; ++i) {
 		struct snapraid_block* block = file_block(file, i);
@@ -416,17 +418,17 @@ struct snapraid_file* file_dup(struct snapraid_file* copy)
 
 void file_free(struct snapraid_file* file)
 {
-	free(file->sub);
+	free_tag(file->sub, strlen(file->sub) + 1, MALLOC_PATH);
 	file->sub = 0;
-	free(file->blockvec);
+	free_tag(file->blockvec, file->blockmax * block_sizeof(), MALLOC_BLOCK);
 	file->blockvec = 0;
-	free(file);
+	free_tag(file, sizeof(struct snapraid_file), MALLOC_FILE);
 }
 
 void file_rename(struct snapraid_file* file, const char* sub)
 {
-	free(file->sub);
-	file->sub = strdup_nofail(sub);
+	free_tag(file->sub, strlen(file->sub) + 1, MALLOC_PATH);
+	file->sub = strdup_nofail_tag(sub, MALLOC_PATH);
 }
 
 void file_copy(struct snapraid_file* src_file, struct snapraid_file* dst_file)
@@ -631,7 +633,7 @@ struct snapraid_extent* extent_alloc(block_off_t parity_pos, struct snapraid_fil
 		/* LCOV_EXCL_STOP */
 	}
 
-	extent = malloc_nofail(sizeof(struct snapraid_extent));
+	extent = malloc_nofail_tag(sizeof(struct snapraid_extent), MALLOC_EXTENT);
 	extent->parity_pos = parity_pos;
 	extent->file = file;
 	extent->file_pos = file_pos;
@@ -642,7 +644,7 @@ struct snapraid_extent* extent_alloc(block_off_t parity_pos, struct snapraid_fil
 
 void extent_free(struct snapraid_extent* extent)
 {
-	free(extent);
+	free_tag(extent, sizeof(struct snapraid_extent), MALLOC_EXTENT);
 }
 
 int extent_parity_compare(const void* void_a, const void* void_b)
@@ -680,9 +682,9 @@ struct snapraid_link* link_alloc(const char* sub, const char* linkto, unsigned l
 {
 	struct snapraid_link* slink;
 
-	slink = malloc_nofail(sizeof(struct snapraid_link));
-	slink->sub = strdup_nofail(sub);
-	slink->linkto = strdup_nofail(linkto);
+	slink = malloc_nofail_tag(sizeof(struct snapraid_link), MALLOC_FILE);
+	slink->sub = strdup_nofail_tag(sub, MALLOC_PATH);
+	slink->linkto = strdup_nofail_tag(linkto, MALLOC_PATH);
 	slink->flag = link_flag;
 
 	return slink;
@@ -690,9 +692,9 @@ struct snapraid_link* link_alloc(const char* sub, const char* linkto, unsigned l
 
 void link_free(struct snapraid_link* slink)
 {
-	free(slink->sub);
-	free(slink->linkto);
-	free(slink);
+	free_tag(slink->sub, strlen(slink->sub) + 1, MALLOC_PATH);
+	free_tag(slink->linkto, strlen(slink->linkto) + 1, MALLOC_PATH);
+	free_tag(slink, sizeof(struct snapraid_link), MALLOC_FILE);
 }
 
 int link_name_compare_to_arg(const void* void_arg, const void* void_data)
@@ -715,8 +717,8 @@ struct snapraid_dir* dir_alloc(const char* sub)
 {
 	struct snapraid_dir* dir;
 
-	dir = malloc_nofail(sizeof(struct snapraid_dir));
-	dir->sub = strdup_nofail(sub);
+	dir = malloc_nofail_tag(sizeof(struct snapraid_dir), MALLOC_FILE);
+	dir->sub = strdup_nofail_tag(sub, MALLOC_PATH);
 	dir->flag = 0;
 
 	return dir;
@@ -724,8 +726,8 @@ struct snapraid_dir* dir_alloc(const char* sub)
 
 void dir_free(struct snapraid_dir* dir)
 {
-	free(dir->sub);
-	free(dir);
+	free_tag(dir->sub, strlen(dir->sub) + 1, MALLOC_PATH);
+	free_tag(dir, sizeof(struct snapraid_dir), MALLOC_FILE);
 }
 
 int dir_name_compare(const void* void_arg, const void* void_data)
@@ -756,6 +758,12 @@ struct snapraid_disk* disk_alloc(const char* name, const char* dir, uint64_t dev
 	disk->device = dev;
 	disk->tick = 0;
 	disk->cached = 0;
+	disk->io_tick = 0;
+	disk->io_size = 0;
+	memset(disk->io_latency, 0, sizeof(disk->io_latency));
+	disk->io_error = 0;
+	disk->io_retry = 0;
+	disk->risk = 1;
 	disk->total_blocks = 0;
 	disk->free_blocks = 0;
 	disk->first_free_block = 0;
@@ -766,15 +774,19 @@ struct snapraid_disk* disk_alloc(const char* name, const char* dir, uint64_t dev
 	disk->had_empty_uuid = 0;
 	disk->mapping_idx = -1;
 	disk->skip_access = skip;
+	disk->skip_scan = 0;
+	disk->file_mode = ADVISE_DEFAULT;
 	tommy_list_init(&disk->filelist);
+	disk->file_order = 0;
+	disk->file_order_max = 0;
 	tommy_list_init(&disk->deletedlist);
-	tommy_hashdyn_init(&disk->inodeset);
-	tommy_hashdyn_init(&disk->pathset);
-	tommy_hashdyn_init(&disk->stampset);
+	tommy_hashlin_init(&disk->inodeset);
+	tommy_hashlin_init(&disk->pathset);
+	tommy_hashlin_init(&disk->stampset);
 	tommy_list_init(&disk->linklist);
-	tommy_hashdyn_init(&disk->linkset);
+	tommy_hashlin_init(&disk->linkset);
 	tommy_list_init(&disk->dirlist);
-	tommy_hashdyn_init(&disk->dirset);
+	tommy_hashlin_init(&disk->dirset);
 	tommy_tree_init(&disk->fs_parity, extent_parity_compare);
 	tommy_tree_init(&disk->fs_file, extent_file_compare);
 	disk->fs_last = 0;
@@ -784,16 +796,17 @@ struct snapraid_disk* disk_alloc(const char* name, const char* dir, uint64_t dev
 
 void disk_free(struct snapraid_disk* disk)
 {
+	fs_file_order_reset(disk);
 	tommy_list_foreach(&disk->filelist, (tommy_foreach_func*)file_free);
 	tommy_list_foreach(&disk->deletedlist, (tommy_foreach_func*)file_free);
 	tommy_tree_foreach(&disk->fs_file, (tommy_foreach_func*)extent_free);
-	tommy_hashdyn_done(&disk->inodeset);
-	tommy_hashdyn_done(&disk->pathset);
-	tommy_hashdyn_done(&disk->stampset);
+	tommy_hashlin_done(&disk->inodeset);
+	tommy_hashlin_done(&disk->pathset);
+	tommy_hashlin_done(&disk->stampset);
 	tommy_list_foreach(&disk->linklist, (tommy_foreach_func*)link_free);
-	tommy_hashdyn_done(&disk->linkset);
+	tommy_hashlin_done(&disk->linkset);
 	tommy_list_foreach(&disk->dirlist, (tommy_foreach_func*)dir_free);
-	tommy_hashdyn_done(&disk->dirset);
+	tommy_hashlin_done(&disk->dirset);
 
 #if HAVE_PTHREAD
 	thread_mutex_destroy(&disk->fs_mutex);
@@ -1237,6 +1250,68 @@ block_off_t fs_file2par_find(struct snapraid_disk* disk, struct snapraid_file* f
 	return ret;
 }
 
+int file_order_compare(const struct snapraid_file* file_a, const struct snapraid_file* file_b)
+{
+	const char* slash_a = strrchr(file_a->sub, '/');
+	const char* slash_b = strrchr(file_b->sub, '/');
+	size_t len_a = slash_a ? (size_t)(slash_a - file_a->sub) : 0;
+	size_t len_b = slash_b ? (size_t)(slash_b - file_b->sub) : 0;
+	int ret;
+
+	/* compare the common part of the directory, and then the length */
+	ret = memcmp(file_a->sub, file_b->sub, len_a < len_b ? len_a : len_b);
+	if (ret != 0)
+		return ret;
+	if (len_a < len_b)
+		return -1;
+	if (len_a > len_b)
+		return 1;
+
+	if (file_a->inode < file_b->inode)
+		return -1;
+	if (file_a->inode > file_b->inode)
+		return 1;
+	return 0;
+}
+
+static int file_order_compare_ptr(const void* void_a, const void* void_b)
+{
+	const struct snapraid_file* file_a = *(const struct snapraid_file* const*)void_a;
+	const struct snapraid_file* file_b = *(const struct snapraid_file* const*)void_b;
+
+	return file_order_compare(file_a, file_b);
+}
+
+struct snapraid_file** fs_file_order(struct snapraid_disk* disk, unsigned* count)
+{
+	if (!disk->file_order) {
+		tommy_node* i;
+		unsigned n;
+
+		disk->file_order_max = tommy_list_count(&disk->filelist);
+		disk->file_order = malloc_nofail_tag((disk->file_order_max + 1) * sizeof(struct snapraid_file*), MALLOC_MISC);
+
+		n = 0;
+		for (i = tommy_list_head(&disk->filelist); i != 0; i = i->next)
+			disk->file_order[n++] = i->data;
+
+		qsort(disk->file_order, disk->file_order_max, sizeof(struct snapraid_file*), file_order_compare_ptr);
+	}
+
+	*count = disk->file_order_max;
+	return disk->file_order;
+}
+
+void fs_file_order_reset(struct snapraid_disk* disk)
+{
+	if (!disk->file_order)
+		return;
+
+	free_tag(disk->file_order, (disk->file_order_max + 1) * sizeof(struct snapraid_file*), MALLOC_MISC);
+	disk->file_order = 0;
+	disk->file_order_max = 0;
+}
+
 void fs_allocate(struct snapraid_disk* disk, block_off_t parity_pos, struct snapraid_file* file, block_off_t file_pos)
 {
 	struct snapraid_extent* extent;
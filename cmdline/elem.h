@@ -24,6 +24,7 @@
 #include "tommyds/tommylist.h"
 #include "tommyds/tommytree.h"
 #include "tommyds/tommyhashdyn.h"
+#include "tommyds/tommyhashlin.h"
 #include "tommyds/tommyarray.h"
 #include "tommyds/tommyarrayblkof.h"
 
@@ -35,6 +36,42 @@
  */
 #define PROGRESS_MAX 100
 
+/**
+ * Number of buckets of the IO latency histogram.
+ *
+ * Each power of two of the tick counter is split in four buckets,
+ * giving a resolution of 25% at any scale.
+ */
+#define LATENCY_MAX 256
+
+/**
+ * Get the latency histogram bucket of the specified ticks.
+ */
+static inline unsigned latency_index(uint64_t t)
+{
+	unsigned msb;
+
+	if (t < 4)
+		return t;
+
+	msb = 2;
+	while (msb < 63 && (t >> (msb + 1)) != 0)
+		++msb;
+
+	return (msb - 1) * 4 + ((t >> (msb - 2)) & 3);
+}
+
+/**
+ * Get the lower ticks of the specified latency histogram bucket.
+ */
+static inline uint64_t latency_value(unsigned index)
+{
+	if (index < 4)
+		return index;
+
+	return (uint64_t)(4 + index % 4) << (index / 4 - 1);
+}
+
 /**
  * Max UUID length.
  */
@@ -263,6 +300,12 @@ struct snapraid_block {
 #define FILE_IS_JUNCTION 0x8000 /**< If it's a junction for Windows. Not yet supported. */
 #define FILE_IS_LINK_MASK 0xF000 /**< Mask for link type. */
 
+/**
+ * If the file has to be processed before the others.
+ * It's used only in fix and check to process first the positions of these files.
+ */
+#define FILE_IS_PRIORITY 0x10000
+
 /**
  * File.
  */
@@ -275,13 +318,14 @@ struct snapraid_file {
 	int mtime_nsec; /**< Modification time nanoseconds. In the range 0 <= x < 1,000,000,000, or STAT_NSEC_INVALID if not present. */
 	block_off_t blockmax; /**< Number of blocks. */
 	unsigned flag; /**< FILE_IS_* flags. */
+	block_off_t pending; /**< Number of blocks still to process. Used only by check and fix. */
 	char* sub; /**< Sub path of the file. Without the disk dir. The disk is implicit. */
 
 	/* nodes for data structures */
 	tommy_node nodelist;
-	tommy_hashdyn_node nodeset;
-	tommy_hashdyn_node pathset;
-	tommy_hashdyn_node stampset;
+	tommy_hashlin_node nodeset;
+	tommy_hashlin_node pathset;
+	tommy_hashlin_node stampset;
 };
 
 /**
@@ -294,7 +338,7 @@ struct snapraid_link {
 
 	/* nodes for data structures */
 	tommy_node nodelist;
-	tommy_hashdyn_node nodeset;
+	tommy_hashlin_node nodeset;
 };
 
 /**
@@ -306,7 +350,7 @@ struct snapraid_dir {
 
 	/* nodes for data structures */
 	tommy_node nodelist;
-	tommy_hashdyn_node nodeset;
+	tommy_hashlin_node nodeset;
 };
 
 /**
@@ -339,6 +383,12 @@ struct snapraid_disk {
 	uint64_t tick; /**< Usage time. */
 	uint64_t progress_tick[PROGRESS_MAX]; /**< Last ticks of progress. */
 	unsigned cached; /**< Number of IO blocks cached. */
+	uint64_t io_tick; /**< Time spent by the disk in IO. */
+	data_off_t io_size; /**< Size of the IO done by the disk. */
+	uint32_t io_latency[LATENCY_MAX]; /**< Histogram of the IO latency in ticks. */
+	unsigned io_error; /**< Number of IO errors. */
+	unsigned io_retry; /**< Number of IO retried, like the slow reads recovered from parity. */
+	double risk; /**< Scrub weight for the risk of failure. 1 for no extra risk. */
 
 	/**
 	 * First free searching block.
@@ -354,6 +404,8 @@ struct snapraid_disk {
 	int had_empty_uuid; /**< If the disk had an empty UUID, meaning that it's a new disk. */
 	int mapping_idx; /**< Index in the mapping vector. Used only as buffer when writing the content file. */
 	int skip_access; /**< If the disk is inaccessible and it should be skipped. */
+	int file_mode; /**< File access mode. One of ADVISE_*. */
+	int skip_scan; /**< If the disk is not scanned, and its stored state is trusted. */
 
 #if HAVE_PTHREAD
 	/**
@@ -386,6 +438,15 @@ struct snapraid_disk {
 	 */
 	tommy_list filelist;
 
+	/**
+	 * Files of the disk grouped by parent directory, and sorted by inode in each directory.
+	 *
+	 * It's built at the first use by fs_file_order(), and discarded by fs_file_order_reset()
+	 * when the file list changes.
+	 */
+	struct snapraid_file** file_order;
+	unsigned file_order_max; /**< Number of files in ::file_order. */
+
 	/**
 	 * List of all the deleted file for the disk.
 	 *
@@ -394,13 +455,13 @@ struct snapraid_disk {
 	 */
 	tommy_list deletedlist;
 
-	tommy_hashdyn inodeset; /**< Hashtable by inode of all the files. */
-	tommy_hashdyn pathset; /**< Hashtable by path of all the files. */
-	tommy_hashdyn stampset; /**< Hashtable by stamp (size and time) of all the files. */
+	tommy_hashlin inodeset; /**< Hashtable by inode of all the files. */
+	tommy_hashlin pathset; /**< Hashtable by path of all the files. */
+	tommy_hashlin stampset; /**< Hashtable by stamp (size and time) of all the files. */
 	tommy_list linklist; /**< List of all the links. */
-	tommy_hashdyn linkset; /**< Hashtable by name of all the links. */
+	tommy_hashlin linkset; /**< Hashtable by name of all the links. */
 	tommy_list dirlist; /**< List of all the empty dirs. */
-	tommy_hashdyn dirset; /**< Hashtable by name of all the empty dirs. */
+	tommy_hashlin dirset; /**< Hashtable by name of all the empty dirs. */
 
 	/* nodes for data structures */
 	tommy_node node;
@@ -465,9 +526,16 @@ struct snapraid_parity {
 	block_off_t free_blocks; /**< Number of free blocks at the last sync. */
 	int is_excluded_by_filter; /**< If the parity is excluded by filters. */
 	int skip_access; /**< If at least one of the parity disk is inaccessible and it should be skipped. */
+	int is_new; /**< If the parity is new and it's the only one computed and written by sync. */
+	int file_mode; /**< File access mode. One of ADVISE_*. */
 	uint64_t tick; /**< Usage time. */
 	uint64_t progress_tick[PROGRESS_MAX]; /**< Last cpu ticks of progress. */
 	unsigned cached; /**< Number of IO blocks cached. */
+	uint64_t io_tick; /**< Time spent by the parity in IO. */
+	data_off_t io_size; /**< Size of the IO done by the parity. */
+	uint32_t io_latency[LATENCY_MAX]; /**< Histogram of the IO latency in ticks. */
+	unsigned io_error; /**< Number of IO errors. */
+	unsigned io_retry; /**< Number of IO retried. */
 };
 
 /**
@@ -992,6 +1060,30 @@ int fs_is_empty(struct snapraid_disk* disk, block_off_t blockmax);
  */
 int fs_check(struct snapraid_disk* disk);
 
+/**
+ * Compare two files of the same disk by parent directory, and then by inode.
+ * It's the order of fs_file_order().
+ */
+int file_order_compare(const struct snapraid_file* file_a, const struct snapraid_file* file_b);
+
+/**
+ * Get the files of the disk grouped by parent directory, and sorted by inode in each directory.
+ *
+ * Accessing the files in this order reduces the directory lookups and the seeks
+ * to read the inodes, compared to the order of the content file.
+ * The vector is built at the first call, and kept until the file list changes.
+ *
+ * \param count Where to return the number of files.
+ * \return The vector of files, valid until the next fs_file_order_reset().
+ */
+struct snapraid_file** fs_file_order(struct snapraid_disk* disk, unsigned* count);
+
+/**
+ * Discard the ordered vector of files.
+ * It must be called every time a file is added or removed from the ::filelist.
+ */
+void fs_file_order_reset(struct snapraid_disk* disk);
+
 /**
  * Allocate a parity position for the specified file position.
  *
@@ -1105,7 +1197,15 @@ void map_free(struct snapraid_map* map);
  *
  * These bits reduce the granularity of the time in the memory representation.
  */
-#define INFO_MASK 0x7
+#define INFO_MASK 0x3F
+
+/**
+ * Bits used to store the step of the parity cycle.
+ *
+ * The parity cycle is limited to the number of parity levels, and it fits in three bits.
+ */
+#define INFO_CYCLE_MASK 0x38
+#define INFO_CYCLE_SHIFT 3
 
 /**
  * Make an info.
@@ -1177,6 +1277,48 @@ static inline snapraid_info info_set_rehash(snapraid_info info)
 	return info | 0x2;
 }
 
+/**
+ * Extract the step of the parity cycle.
+ */
+static inline unsigned info_get_cycle(snapraid_info info)
+{
+	return (info & INFO_CYCLE_MASK) >> INFO_CYCLE_SHIFT;
+}
+
+/**
+ * Set the step of the parity cycle.
+ */
+static inline snapraid_info info_set_cycle(snapraid_info info, unsigned step)
+{
+	return (info & ~INFO_CYCLE_MASK) | ((step << INFO_CYCLE_SHIFT) & INFO_CYCLE_MASK);
+}
+
+/**
+ * Check if a scrub of the block address verifies the specified parity level.
+ *
+ * With a parity cycle, the parity levels are verified in rotation, and each
+ * one is verified once every ::cycle scrubs of the block address.
+ * The position spreads the levels verified by a single scrub over all the parity disks.
+ */
+static inline int info_has_parity(snapraid_info info, block_off_t pos, unsigned level, unsigned cycle)
+{
+	if (cycle <= 1)
+		return 1;
+
+	return (info_get_cycle(info) + pos + level) % cycle == 0;
+}
+
+/**
+ * Get the step of the parity cycle of the next scrub of the block address.
+ */
+static inline unsigned info_next_cycle(snapraid_info info, unsigned cycle)
+{
+	if (cycle <= 1)
+		return 0;
+
+	return (info_get_cycle(info) + 1) % cycle;
+}
+
 /**
  * Set the info at the specified position.
  * The position is allocated if not yet done.
@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2013 Andrea Mazzoleni
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "portable.h"
+
+#include "support.h"
+#include "export.h"
+
+/****************************************************************************/
+/* export */
+
+int export_format(const char* name)
+{
+	if (strcmp(name, "json") == 0)
+		return EXPORT_JSON;
+	if (strcmp(name, "tsv") == 0)
+		return EXPORT_TSV;
+	return EXPORT_NONE;
+}
+
+void export_init(struct snapraid_export* exp, int format, FILE* f)
+{
+	exp->format = format;
+	exp->f = f;
+	exp->size = EXPORT_BUFFER_SIZE;
+	exp->pos = 0;
+	exp->buffer = malloc_nofail_tag(exp->size, MALLOC_BUFFER);
+}
+
+void export_flush(struct snapraid_export* exp)
+{
+	if (exp->pos == 0)
+		return;
+
+	if (fwrite(exp->buffer, exp->pos, 1, exp->f) != 1) {
+		/* LCOV_EXCL_START */
+		log_fatal("Error writing the export output. %s.\n", strerror(errno));
+		exit(EXIT_FAILURE);
+		/* LCOV_EXCL_STOP */
+	}
+
+	exp->pos = 0;
+}
+
+void export_done(struct snapraid_export* exp)
+{
+	if (exp->f) {
+		export_flush(exp);
+
+		if (fflush(exp->f) != 0) {
+			/* LCOV_EXCL_START */
+			log_fatal("Error writing the export output. %s.\n", strerror(errno));
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	free_tag(exp->buffer, exp->size, MALLOC_BUFFER);
+	exp->buffer = 0;
+}
+
+/**
+ * Ensure to have the specified free space in the buffer.
+ */
+static void export_reserve(struct snapraid_export* exp, size_t len)
+{
+	size_t size;
+	char* buffer;
+
+	if (exp->pos + len <= exp->size)
+		return;
+
+	if (exp->f) {
+		export_flush(exp);
+		if (len <= exp->size)
+			return;
+	}
+
+	/* grow the buffer */
+	size = exp->size;
+	while (exp->pos + len > size)
+		size *= 2;
+
+	buffer = malloc_nofail_tag(size, MALLOC_BUFFER);
+	memcpy(buffer, exp->buffer, exp->pos);
+	free_tag(exp->buffer, exp->size, MALLOC_BUFFER);
+
+	exp->buffer = buffer;
+	exp->size = size;
+}
+
+void export_append(struct snapraid_export* exp, struct snapraid_export* src)
+{
+	if (exp->f && src->pos > exp->size) {
+		/* write directly large chunks */
+		export_flush(exp);
+		if (fwrite(src->buffer, src->pos, 1, exp->f) != 1) {
+			/* LCOV_EXCL_START */
+			log_fatal("Error writing the export output. %s.\n", strerror(errno));
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+	} else {
+		export_reserve(exp, src->pos);
+		memcpy(exp->buffer + exp->pos, src->buffer, src->pos);
+		exp->pos += src->pos;
+	}
+
+	src->pos = 0;
+}
+
+/**
+ * Write a raw string.
+ */
+static void export_raw(struct snapraid_export* exp, const char* str)
+{
+	size_t len = strlen(str);
+
+	export_reserve(exp, len);
+	memcpy(exp->buffer + exp->pos, str, len);
+	exp->pos += len;
+}
+
+/**
+ * Write an unsigned number.
+ */
+static void export_u64(struct snapraid_export* exp, uint64_t value)
+{
+	char digit[24];
+	unsigned len = 0;
+
+	do {
+		digit[len++] = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+
+	export_reserve(exp, len);
+	while (len > 0)
+		exp->buffer[exp->pos++] = digit[--len];
+}
+
+/**
+ * Write a signed number.
+ */
+static void export_i64(struct snapraid_export* exp, int64_t value)
+{
+	if (value < 0) {
+		export_raw(exp, "-");
+		export_u64(exp, -(uint64_t)value);
+	} else {
+		export_u64(exp, value);
+	}
+}
+
+/**
+ * Write a string escaped for the output format.
+ *
+ * In JSON the string is quoted, and quotes, backslashes and control chars are escaped.
+ * Invalid UTF-8 sequences in file names are written as they are.
+ * In TSV only tabs, newlines, carriage returns and backslashes are escaped.
+ */
+static void export_str(struct snapraid_export* exp, const char* str)
+{
+	static const char hex[] = "0123456789abcdef";
+	size_t len = strlen(str);
+	char* p;
+
+	/* worst case is JSON with all control chars as \u00XX and quotes */
+	export_reserve(exp, len * 6 + 2);
+
+	p = exp->buffer + exp->pos;
+
+	if (exp->format == EXPORT_JSON) {
+		*p++ = '"';
+		for (; *str; ++str) {
+			unsigned char c = *str;
+			switch (c) {
+			case '"' : *p++ = '\\'; *p++ = '"'; break;
+			case '\\' : *p++ = '\\'; *p++ = '\\'; break;
+			case '\n' : *p++ = '\\'; *p++ = 'n'; break;
+			case '\r' : *p++ = '\\'; *p++ = 'r'; break;
+			case '\t' : *p++ = '\\'; *p++ = 't'; break;
+			default :
+				if (c < 0x20) {
+					*p++ = '\\';
+					*p++ = 'u';
+					*p++ = '0';
+					*p++ = '0';
+					*p++ = hex[c >> 4];
+					*p++ = hex[c & 0xF];
+				} else {
+					*p++ = c;
+				}
+			}
+		}
+		*p++ = '"';
+	} else {
+		for (; *str; ++str) {
+			char c = *str;
+			switch (c) {
+			case '\\' : *p++ = '\\'; *p++ = '\\'; break;
+			case '\n' : *p++ = '\\'; *p++ = 'n'; break;
+			case '\r' : *p++ = '\\'; *p++ = 'r'; break;
+			case '\t' : *p++ = '\\'; *p++ = 't'; break;
+			default : *p++ = c;
+			}
+		}
+	}
+
+	exp->pos = p - exp->buffer;
+}
+
+/**
+ * Write a field name and separator.
+ * In JSON it's the key of the object, in TSV only the separator.
+ */
+static void export_key(struct snapraid_export* exp, const char* key, int first)
+{
+	if (exp->format == EXPORT_JSON) {
+		export_raw(exp, first ? "{\"" : ",\"");
+		export_raw(exp, key);
+		export_raw(exp, "\":");
+	} else {
+		if (!first)
+			export_raw(exp, "\t");
+	}
+}
+
+/**
+ * Write a missing value.
+ */
+static void export_null(struct snapraid_export* exp)
+{
+	if (exp->format == EXPORT_JSON)
+		export_raw(exp, "null");
+}
+
+/**
+ * Terminate the record.
+ */
+static void export_end(struct snapraid_export* exp)
+{
+	if (exp->format == EXPORT_JSON)
+		export_raw(exp, "}\n");
+	else
+		export_raw(exp, "\n");
+}
+
+void export_list_header(struct snapraid_export* exp)
+{
+	if (exp->format == EXPORT_TSV)
+		export_raw(exp, "type\tdisk\tpath\tsize\tmtime\tmtime_nsec\tinode\tlinkto\n");
+}
+
+void export_list_file(struct snapraid_export* exp, struct snapraid_disk* disk, struct snapraid_file* file)
+{
+	export_key(exp, "type", 1);
+	export_str(exp, "file");
+	export_key(exp, "disk", 0);
+	export_str(exp, disk->name);
+	export_key(exp, "path", 0);
+	export_str(exp, file->sub);
+	export_key(exp, "size", 0);
+	export_u64(exp, file->size);
+	export_key(exp, "mtime", 0);
+	export_i64(exp, file->mtime_sec);
+	export_key(exp, "mtime_nsec", 0);
+	if (file->mtime_nsec != STAT_NSEC_INVALID)
+		export_u64(exp, file->mtime_nsec);
+	else
+		export_null(exp);
+	export_key(exp, "inode", 0);
+	export_u64(exp, file->inode);
+	if (exp->format == EXPORT_TSV)
+		export_raw(exp, "\t");
+	export_end(exp);
+}
+
+void export_list_link(struct snapraid_export* exp, struct snapraid_disk* disk, struct snapraid_link* slink, const char* type)
+{
+	export_key(exp, "type", 1);
+	export_str(exp, type);
+	export_key(exp, "disk", 0);
+	export_str(exp, disk->name);
+	export_key(exp, "path", 0);
+	export_str(exp, slink->sub);
+	if (exp->format == EXPORT_TSV)
+		export_raw(exp, "\t\t\t\t");
+	export_key(exp, "linkto", 0);
+	export_str(exp, slink->linkto);
+	export_end(exp);
+}
+
+void export_diff_header(struct snapraid_export* exp)
+{
+	if (exp->format == EXPORT_TSV)
+		export_raw(exp, "type\tdisk\tpath\tto_disk\tto_path\n");
+}
+
+void export_diff(struct snapraid_export* exp, const char* op, struct snapraid_disk* disk, const char* sub, struct snapraid_disk* to_disk, const char* to_sub)
+{
+	export_key(exp, "type", 1);
+	export_str(exp, op);
+	export_key(exp, "disk", 0);
+	export_str(exp, disk->name);
+	export_key(exp, "path", 0);
+	export_str(exp, sub);
+	if (to_disk) {
+		export_key(exp, "to_disk", 0);
+		export_str(exp, to_disk->name);
+		export_key(exp, "to_path", 0);
+		export_str(exp, to_sub);
+	} else if (exp->format == EXPORT_TSV) {
+		export_raw(exp, "\t\t");
+	}
+	export_end(exp);
+}
+
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2013 Andrea Mazzoleni
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __EXPORT_H
+#define __EXPORT_H
+
+#include "elem.h"
+
+/****************************************************************************/
+/* export */
+
+/**
+ * Export formats.
+ */
+#define EXPORT_NONE 0 /**< No export, human readable output. */
+#define EXPORT_JSON 1 /**< One JSON object for each line (NDJSON). */
+#define EXPORT_TSV 2 /**< Tab separated values with an header line. */
+
+/**
+ * Size of the export buffer.
+ */
+#define EXPORT_BUFFER_SIZE (1024 * 1024)
+
+/**
+ * Export writer.
+ *
+ * All the records are formatted in a memory buffer without using
+ * printf(), locale or time conversions, and written in large chunks.
+ */
+struct snapraid_export {
+	int format; /**< Format used, one of EXPORT_*. */
+	FILE* f; /**< Output stream. If 0 the buffer grows in memory until written with export_append(). */
+	char* buffer; /**< Formatting buffer. */
+	size_t size; /**< Allocated size of the buffer. */
+	size_t pos; /**< Used size of the buffer. */
+};
+
+/**
+ * Parse the export format name.
+ * Return EXPORT_NONE if not recognized.
+ */
+int export_format(const char* name);
+
+/**
+ * Initialize the writer.
+ * \param f Output stream, or 0 to only accumulate in memory.
+ */
+void export_init(struct snapraid_export* exp, int format, FILE* f);
+
+/**
+ * Flush and deallocate the writer.
+ */
+void export_done(struct snapraid_export* exp);
+
+/**
+ * Write all the buffered data to the output stream.
+ */
+void export_flush(struct snapraid_export* exp);
+
+/**
+ * Move all the data of a memory writer into another writer.
+ * The source writer is left empty and ready to be reused.
+ */
+void export_append(struct snapraid_export* exp, struct snapraid_export* src);
+
+/**
+ * Write the TSV header of the list records.
+ */
+void export_list_header(struct snapraid_export* exp);
+
+/**
+ * Write a file record of the list.
+ */
+void export_list_file(struct snapraid_export* exp, struct snapraid_disk* disk, struct snapraid_file* file);
+
+/**
+ * Write a link record of the list.
+ */
+void export_list_link(struct snapraid_export* exp, struct snapraid_disk* disk, struct snapraid_link* slink, const char* type);
+
+/**
+ * Write the TSV header of the diff records.
+ */
+void export_diff_header(struct snapraid_export* exp);
+
+/**
+ * Write a diff record.
+ * \param op Operation, like "add", "remove" or "move".
+ * \param to_disk Destination disk for "move" and "copy", otherwise 0.
+ */
+void export_diff(struct snapraid_export* exp, const char* op, struct snapraid_disk* disk, const char* sub, struct snapraid_disk* to_disk, const char* to_sub);
+
+#endif
+
@@ -141,6 +141,39 @@ int handle_truncate(struct snapraid_handle* handle, struct snapraid_file* file)
 	return 0;
 }
 
+int handle_reserve(struct snapraid_handle* handle, data_off_t size)
+{
+#if HAVE_FALLOCATE && defined(FALLOC_FL_KEEP_SIZE)
+	int ret;
+
+	ret = fallocate(handle->f, FALLOC_FL_KEEP_SIZE, 0, size);
+
+	/* in some legacy system fallocate() may return the error number as positive integer */
+	if (ret > 0) {
+		/* LCOV_EXCL_START */
+		errno = ret;
+		ret = -1;
+		/* LCOV_EXCL_STOP */
+	}
+
+	/* if not supported by the file-system, there is nothing to reserve */
+	if (ret != 0 && (errno == EOPNOTSUPP || errno == ENOSYS))
+		ret = 0;
+
+	if (ret != 0) {
+		/* LCOV_EXCL_START */
+		log_fatal("Error reserving space for file '%s'. %s.\n", handle->path, strerror(errno));
+		return -1;
+		/* LCOV_EXCL_STOP */
+	}
+#else
+	(void)handle;
+	(void)size;
+#endif
+
+	return 0;
+}
+
 int handle_open(struct snapraid_handle* handle, struct snapraid_file* file, int mode, fptr* out, fptr* out_missing)
 {
 	int ret;
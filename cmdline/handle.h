@@ -50,6 +50,13 @@ int handle_create(struct snapraid_handle* handle, struct snapraid_file* file, in
  */
 int handle_truncate(struct snapraid_handle* handle, struct snapraid_file* file);
 
+/**
+ * Reserve the space of a file, without changing its size.
+ * It allows to write the blocks in any order without fragmenting the file.
+ * If not supported by the platform or by the file-system, nothing is done.
+ */
+int handle_reserve(struct snapraid_handle* handle, data_off_t size);
+
 /**
  * Open a file.
  * The file is opened for reading.
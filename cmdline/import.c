@@ -64,11 +64,11 @@ static void import_file(struct snapraid_state* state, const char* path, uint64_t
 	unsigned block_size = state->block_size;
 	struct advise_struct advise;
 
-	file = malloc_nofail(sizeof(struct snapraid_import_file));
-	file->path = strdup_nofail(path);
+	file = malloc_nofail_tag(sizeof(struct snapraid_import_file), MALLOC_IMPORT);
+	file->path = strdup_nofail_tag(path, MALLOC_IMPORT);
 	file->size = size;
 	file->blockmax = (size + block_size - 1) / block_size;
-	file->blockimp = malloc_nofail(file->blockmax * sizeof(struct snapraid_import_block));
+	file->blockimp = malloc_nofail_tag(file->blockmax * sizeof(struct snapraid_import_block), MALLOC_IMPORT);
 
 	buffer = malloc_nofail(block_size);
 
@@ -112,13 +112,13 @@ static void import_file(struct snapraid_state* state, const char* path, uint64_t
 		block->size = read_size;
 
 		memhash(state->hash, state->hashseed, block->hash, buffer, read_size);
-		tommy_hashdyn_insert(&state->importset, &block->nodeset, block, import_block_hash(block->hash));
+		tommy_hashlin_insert(&state->importset, &block->nodeset, block, import_block_hash(block->hash));
 
 		/* if we are in a rehash state */
 		if (state->prevhash != HASH_UNDEFINED) {
 			/* compute also the previous hash */
 			memhash(state->prevhash, state->prevhashseed, block->prevhash, buffer, read_size);
-			tommy_hashdyn_insert(&state->previmportset, &block->prevnodeset, block, import_block_hash(block->prevhash));
+			tommy_hashlin_insert(&state->previmportset, &block->prevnodeset, block, import_block_hash(block->prevhash));
 		}
 
 		offset += read_size;
@@ -140,9 +140,9 @@ static void import_file(struct snapraid_state* state, const char* path, uint64_t
 
 void import_file_free(struct snapraid_import_file* file)
 {
-	free(file->path);
-	free(file->blockimp);
-	free(file);
+	free_tag(file->path, strlen(file->path) + 1, MALLOC_IMPORT);
+	free_tag(file->blockimp, file->blockmax * sizeof(struct snapraid_import_block), MALLOC_IMPORT);
+	free_tag(file, sizeof(struct snapraid_import_file), MALLOC_IMPORT);
 }
 
 int state_import_fetch(struct snapraid_state* state, int rehash, struct snapraid_block* missing_block, unsigned char* buffer)
@@ -157,9 +157,9 @@ int state_import_fetch(struct snapraid_state* state, int rehash, struct snapraid
 	const char* path;
 
 	if (rehash) {
-		block = tommy_hashdyn_search(&state->previmportset, import_block_prevhash_compare, hash, import_block_hash(hash));
+		block = tommy_hashlin_search(&state->previmportset, import_block_prevhash_compare, hash, import_block_hash(hash));
 	} else {
-		block = tommy_hashdyn_search(&state->importset, import_block_hash_compare, hash, import_block_hash(hash));
+		block = tommy_hashlin_search(&state->importset, import_block_hash_compare, hash, import_block_hash(hash));
 	}
 	if (!block)
 		return -1;
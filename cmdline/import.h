@@ -36,8 +36,8 @@ struct snapraid_import_block {
 	unsigned char prevhash[HASH_MAX]; /**< Previous hash of the block. Valid only if we are in rehash state. */
 
 	/* nodes for data structures */
-	tommy_hashdyn_node nodeset;
-	tommy_hashdyn_node prevnodeset;
+	tommy_hashlin_node nodeset;
+	tommy_hashlin_node prevnodeset;
 };
 
 /**
@@ -38,6 +38,34 @@ static block_off_t io_position_next(struct snapraid_io* io)
 	return blockcur;
 }
 
+/**
+ * Setup the next pending task for a reader.
+ */
+static void io_reader_setup(struct snapraid_io* io, struct snapraid_worker* worker, int task_index, block_off_t blockcur)
+{
+	struct snapraid_task* task = &worker->task_map[task_index];
+	unsigned i = worker - io->reader_map;
+
+	/* setup the new pending task */
+	if (blockcur < io->block_max)
+		task->state = TASK_STATE_READY;
+	else
+		task->state = TASK_STATE_EMPTY;
+
+	task->path[0] = 0;
+	if (worker->handle)
+		task->disk = worker->handle->disk;
+	else
+		task->disk = 0;
+	task->buffer = io->buffer_map[task_index][worker->buffer_skew + i];
+	task->position = blockcur;
+	task->block = 0;
+	task->file = 0;
+	task->file_pos = 0;
+	task->read_size = 0;
+	task->is_timestamp_different = 0;
+}
+
 /**
  * Setup the next pending task for all readers.
  */
@@ -45,29 +73,10 @@ static void io_reader_sched(struct snapraid_io* io, int task_index, block_off_t
 {
 	unsigned i;
 
-	for (i = 0; i < io->reader_max; ++i) {
-		struct snapraid_worker* worker = &io->reader_map[i];
-		struct snapraid_task* task = &worker->task_map[task_index];
-
-		/* setup the new pending task */
-		if (blockcur < io->block_max)
-			task->state = TASK_STATE_READY;
-		else
-			task->state = TASK_STATE_EMPTY;
+	io->reader_position[task_index] = blockcur;
 
-		task->path[0] = 0;
-		if (worker->handle)
-			task->disk = worker->handle->disk;
-		else
-			task->disk = 0;
-		task->buffer = io->buffer_map[task_index][worker->buffer_skew + i];
-		task->position = blockcur;
-		task->block = 0;
-		task->file = 0;
-		task->file_pos = 0;
-		task->read_size = 0;
-		task->is_timestamp_different = 0;
-	}
+	for (i = 0; i < io->reader_max; ++i)
+		io_reader_setup(io, &io->reader_map[i], task_index, blockcur);
 }
 
 /**
@@ -173,6 +182,72 @@ static void io_write_next_mono(struct snapraid_io* io, block_off_t blockcur, int
 		writer_error[i] = io->writer_error[i];
 }
 
+/**
+ * Run the worker function on the task, measuring its time and size.
+ */
+static void io_work(struct snapraid_worker* worker, struct snapraid_task* task)
+{
+	uint64_t start = tick();
+	uint64_t elapsed;
+
+	worker->func(worker, task);
+
+	elapsed = tick() - start;
+	worker->io_tick += elapsed;
+	++worker->io_latency[latency_index(elapsed)];
+	if (task->state == TASK_STATE_IOERROR || task->state == TASK_STATE_IOERROR_CONTINUE)
+		++worker->io_error;
+	if (task->state == TASK_STATE_DONE) {
+		if (worker->handle)
+			worker->io_size += task->read_size;
+		else
+			worker->io_size += worker->io->state->block_size;
+	}
+}
+
+/**
+ * Add the IO measured by the worker to its disk or parity.
+ */
+static void io_account_worker(struct snapraid_io* io, struct snapraid_worker* worker)
+{
+	unsigned i;
+
+	if (worker->handle) {
+		struct snapraid_disk* disk = worker->handle->disk;
+
+		if (disk) {
+			disk->io_tick += worker->io_tick;
+			disk->io_size += worker->io_size;
+			for (i = 0; i < LATENCY_MAX; ++i)
+				disk->io_latency[i] += worker->io_latency[i];
+			disk->io_error += worker->io_error;
+		}
+	} else {
+		struct snapraid_parity* parity = &io->state->parity[worker->parity_handle->level];
+
+		parity->io_tick += worker->io_tick;
+		parity->io_size += worker->io_size;
+		for (i = 0; i < LATENCY_MAX; ++i)
+			parity->io_latency[i] += worker->io_latency[i];
+		parity->io_error += worker->io_error;
+	}
+}
+
+/**
+ * Add the IO measured by all the workers to their disk or parity.
+ *
+ * It's called when stopping, as the handles may be freed before ::io_done().
+ */
+static void io_account(struct snapraid_io* io)
+{
+	unsigned i;
+
+	for (i = 0; i < io->reader_max; ++i)
+		io_account_worker(io, &io->reader_map[i]);
+	for (i = 0; i < io->writer_max; ++i)
+		io_account_worker(io, &io->writer_map[i]);
+}
+
 static void io_refresh_mono(struct snapraid_io* io)
 {
 	(void)io;
@@ -194,7 +269,7 @@ static struct snapraid_task* io_task_read_mono(struct snapraid_io* io, unsigned
 
 	/* do the work */
 	if (task->state != TASK_STATE_EMPTY)
-		worker->func(worker, task);
+		io_work(worker, task);
 
 	/* return the position */
 	*pos = i - base;
@@ -232,7 +307,7 @@ static void io_parity_write_mono(struct snapraid_io* io, unsigned* pos, unsigned
 
 	/* do the work */
 	if (task->state != TASK_STATE_EMPTY)
-		worker->func(worker, task);
+		io_work(worker, task);
 
 	/* return the position */
 	*pos = i;
@@ -255,7 +330,7 @@ static void io_start_mono(struct snapraid_io* io,
 
 static void io_stop_mono(struct snapraid_io* io)
 {
-	(void)io;
+	io_account(io);
 }
 
 /*****************************************************************************/
@@ -277,7 +352,7 @@ static struct snapraid_task* io_reader_step(struct snapraid_worker* worker)
 	thread_mutex_lock(&io->io_mutex);
 
 	while (1) {
-		unsigned next_index;
+		unsigned next_seq;
 
 		/* check if the worker has to exit */
 		/* even if there is work to do */
@@ -287,24 +362,33 @@ static struct snapraid_task* io_reader_step(struct snapraid_worker* worker)
 		}
 
 		/* get the next pending task */
-		next_index = (worker->index + 1) % io->io_max;
+		next_seq = worker->seq + 1;
+
+		/* if the caller already went over it, the read was hedged */
+		/* and we skip directly to the task of the caller */
+		if ((int)(io->reader_seq - next_seq) > 0)
+			next_seq = io->reader_seq;
 
 		/* if the queue of pending tasks is not empty */
-		if (next_index != io->reader_index) {
+		if ((int)(io->reader_seq + io->io_max - next_seq) > 0) {
 			struct snapraid_task* task;
 
-			/* the index that the IO may be waiting for */
-			unsigned waiting_index = io->reader_index;
+			/* the task that the IO may be waiting for */
+			unsigned waiting_seq = io->reader_seq;
 
-			/* the index that worker just completed */
-			unsigned done_index = worker->index;
+			/* the task that worker just completed */
+			unsigned done_seq = worker->seq;
 
 			/* get the new working task */
-			worker->index = next_index;
+			worker->index = (worker->index + (next_seq - worker->seq)) % io->io_max;
+			worker->seq = next_seq;
 			task = &worker->task_map[worker->index];
 
+			/* setup it with the position scheduled by the IO */
+			io_reader_setup(io, worker, worker->index, io->reader_position[worker->index]);
+
 			/* if the just completed task is at this index */
-			if (done_index == waiting_index) {
+			if (done_seq == waiting_seq) {
 				/* notify the IO that a new read is complete */
 				thread_cond_signal_and_unlock(&io->read_done, &io->io_mutex);
 			} else {
@@ -407,13 +491,16 @@ static block_off_t io_read_next_thread(struct snapraid_io* io, void*** buffer)
 	thread_mutex_lock(&io->io_mutex);
 
 	/* schedule the next read */
-	io_reader_sched(io, io->reader_index, blockcur_schedule);
+	/* the workers setup their task when they reach it, because */
+	/* a hedged one may be still working on the previous task at this index */
+	io->reader_position[io->reader_index] = blockcur_schedule;
 
 	/* set the index for the tasks to return to the caller */
 	io->reader_index = (io->reader_index + 1) % io->io_max;
+	++io->reader_seq;
 
-	/* get the position to operate at high level from one task */
-	blockcur_caller = io->reader_map[0].task_map[io->reader_index].position;
+	/* get the position to operate at high level */
+	blockcur_caller = io->reader_position[io->reader_index];
 
 	/* set the buffer to use */
 	*buffer = io->buffer_map[io->reader_index];
@@ -478,16 +565,14 @@ static void io_refresh_thread(struct snapraid_io* io)
 
 	/* for all readers, count the number of read blocks */
 	for (i = 0; i < io->reader_max; ++i) {
-		unsigned begin, end, cached;
+		unsigned cached;
 		struct snapraid_worker* worker = &io->reader_map[i];
 
-		/* the first block read */
-		begin = io->reader_index + 1;
-		/* the block in reading */
-		end = worker->index;
-		if (begin > end)
-			end += io->io_max;
-		cached = end - begin;
+		/* the blocks read after the one of the caller */
+		if ((int)(worker->seq - io->reader_seq) > 0)
+			cached = worker->seq - io->reader_seq - 1;
+		else
+			cached = 0;
 
 		if (worker->parity_handle)
 			io->state->parity[worker->parity_handle->level].cached = cached;
@@ -518,6 +603,7 @@ static void io_refresh_thread(struct snapraid_io* io)
 static struct snapraid_task* io_task_read_thread(struct snapraid_io* io, unsigned base, unsigned count, unsigned* pos, unsigned* waiting_map, unsigned* waiting_mac)
 {
 	unsigned waiting_cycle;
+	uint64_t hedge_deadline;
 
 	/* count the waiting cycle */
 	waiting_cycle = 0;
@@ -525,17 +611,26 @@ static struct snapraid_task* io_task_read_thread(struct snapraid_io* io, unsigne
 	/* clear the waiting indexes */
 	*waiting_mac = 0;
 
+	/* hedging is started only when a single read is missing */
+	hedge_deadline = 0;
+
 	/* the synchronization is protected by the io mutex */
 	thread_mutex_lock(&io->io_mutex);
 
 	while (1) {
 		unsigned char* let;
-		unsigned busy_index;
+		unsigned char* pending_let;
+		unsigned pending;
+		unsigned busy_seq;
 
-		/* get the index the IO is using */
-		/* we must ensure that this index has not a read in progress */
+		/* get the task the IO is using */
+		/* we must ensure that this task has not a read in progress */
 		/* to avoid a concurrent access */
-		busy_index = io->reader_index;
+		busy_seq = io->reader_seq;
+
+		/* count the workers still reading */
+		pending = 0;
+		pending_let = 0;
 
 		/* search for a worker that has already finished */
 		let = &io->reader_list[0];
@@ -558,8 +653,8 @@ static struct snapraid_task* io_task_read_thread(struct snapraid_io* io, unsigne
 
 				worker = &io->reader_map[i];
 
-				/* if the worker has finished this index */
-				if (busy_index != worker->index) {
+				/* if the worker has finished this task */
+				if ((int)(worker->seq - busy_seq) > 0) {
 					struct snapraid_task* task;
 
 					task = &worker->task_map[io->reader_index];
@@ -579,14 +674,42 @@ static struct snapraid_task* io_task_read_thread(struct snapraid_io* io, unsigne
 
 					return task;
 				}
+
+				++pending;
+				pending_let = let;
 			}
 
 			/* next position to check */
 			let = &io->reader_list[i + 1];
 		}
 
-		/* if no worker is ready, wait for an event */
-		thread_cond_wait(&io->read_done, &io->io_mutex);
+		/* if only one data read is missing, and it's allowed to give up on it */
+		if (io->hedge_wait != 0 && base == io->data_base && pending == 1) {
+			uint64_t now = tick_ms();
+
+			if (hedge_deadline == 0)
+				hedge_deadline = now + io->hedge_wait;
+
+			if (now >= hedge_deadline) {
+				unsigned i = *pending_let;
+
+				thread_mutex_unlock(&io->io_mutex);
+
+				/* mark the worker as processed, it will skip the task when done */
+				*pending_let = io->reader_list[i + 1];
+
+				/* return the position */
+				*pos = i - base;
+
+				return 0;
+			}
+
+			/* wait for an event, or for the timeout */
+			thread_cond_timedwait(&io->read_done, &io->io_mutex, hedge_deadline - now);
+		} else {
+			/* if no worker is ready, wait for an event */
+			thread_cond_wait(&io->read_done, &io->io_mutex);
+		}
 
 		/* count the cycles */
 		++waiting_cycle;
@@ -685,7 +808,7 @@ static void io_reader_worker(struct snapraid_worker* worker, struct snapraid_tas
 		/* complete a dummy task */
 		task->state = TASK_STATE_EMPTY;
 	} else {
-		worker->func(worker, task);
+		io_work(worker, task);
 	}
 }
 
@@ -743,7 +866,7 @@ static void* io_writer_thread(void* arg)
 		assert(task->state == TASK_STATE_READY);
 
 		/* work on the assigned task */
-		worker->func(worker, task);
+		io_work(worker, task);
 
 		/* save the resulting state */
 		latest_state = task->state;
@@ -766,6 +889,7 @@ static void io_start_thread(struct snapraid_io* io,
 
 	io->done = 0;
 	io->reader_index = io->io_max - 1;
+	io->reader_seq = io->io_max - 1;
 	io->writer_index = 0;
 
 	/* clear writer errors */
@@ -790,8 +914,9 @@ static void io_start_thread(struct snapraid_io* io,
 		struct snapraid_worker* worker = &io->reader_map[i];
 
 		worker->index = 0;
+		worker->seq = io->io_max;
 
-		thread_create(&worker->thread, 0, io_reader_thread, worker);
+		thread_pool_run(&worker->job, 0, io_reader_thread, worker);
 	}
 
 	/* start the writer threads */
@@ -800,7 +925,7 @@ static void io_start_thread(struct snapraid_io* io,
 
 		worker->index = io->io_max - 1;
 
-		thread_create(&worker->thread, 0, io_writer_thread, worker);
+		thread_pool_run(&worker->job, 0, io_writer_thread, worker);
 	}
 }
 
@@ -825,7 +950,7 @@ static void io_stop_thread(struct snapraid_io* io)
 		void* retval;
 
 		/* wait for thread termination */
-		thread_join(worker->thread, &retval);
+		thread_pool_join(&worker->job, &retval);
 	}
 
 	/* wait for all writers to terminate */
@@ -834,8 +959,10 @@ static void io_stop_thread(struct snapraid_io* io)
 		void* retval;
 
 		/* wait for thread termination */
-		thread_join(worker->thread, &retval);
+		thread_pool_join(&worker->job, &retval);
 	}
+
+	io_account(io);
 }
 
 #endif
@@ -853,8 +980,10 @@ void io_init(struct snapraid_io* io, struct snapraid_state* state,
 {
 	unsigned i;
 	size_t allocated;
+	size_t avail;
 
 	io->state = state;
+	io->hedge_wait = 0;
 
 #if HAVE_PTHREAD
 	if (io_cache == 0) {
@@ -877,10 +1006,37 @@ void io_init(struct snapraid_io* io, struct snapraid_state* state,
 
 	assert(io->io_max == 1 || (io->io_max >= IO_MIN && io->io_max <= IO_MAX));
 
+	/* reduce the cache to fit the memory limit */
+	avail = malloc_limit_avail();
+	if (avail != SIZE_MAX) {
+		/* reserve the space for the workers allocated later */
+		size_t workers = sizeof(struct snapraid_worker) * (handle_max + 2 * parity_handle_max);
+		size_t fit = avail > workers ? (avail - workers) / ((size_t)state->block_size * buffer_max) : 0;
+		unsigned io_min = io->io_max == 1 ? 1 : IO_MIN;
+
+		if (fit < io_min) {
+			/* LCOV_EXCL_START */
+			log_fatal("The 'memorylimit' of %u MiB is not enough to process the array.\n", (unsigned)(malloc_limit_get() / MEBI));
+			log_fatal("Already used %u MiB, and at least %u MiB more are needed for the IO.\n", (unsigned)(malloc_counter_get() / MEBI), (unsigned)((workers + (size_t)state->block_size * buffer_max * io_min + MEBI - 1) / MEBI));
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+
+		if (fit < io->io_max) {
+			log_tag("memusage:io_cache:%u:%u\n", io->io_max, (unsigned)fit);
+			msg_progress("Reducing the IO cache from %u to %u blocks to fit the memory limit.\n", io->io_max, (unsigned)fit);
+			io->io_max = fit;
+		}
+	}
+
 	io->buffer_max = buffer_max;
+
+	/* account the cache buffers, released in io_done() */
+	malloc_counter_inc((size_t)state->block_size * buffer_max * io->io_max, MALLOC_BUFFER);
+
 	allocated = 0;
 	for (i = 0; i < io->io_max; ++i) {
-		if (state->file_mode != ADVISE_DIRECT)
+		if (!state->direct_mode)
 			io->buffer_map[i] = malloc_nofail_vector_align(handle_max, buffer_max, state->block_size, &io->buffer_alloc_map[i]);
 		else
 			io->buffer_map[i] = malloc_nofail_vector_direct(handle_max, buffer_max, state->block_size, &io->buffer_alloc_map[i]);
@@ -891,18 +1047,19 @@ void io_init(struct snapraid_io* io, struct snapraid_state* state,
 
 	msg_progress("Using %u MiB of memory for %u blocks of IO cache.\n", (unsigned)(allocated / MEBI), io->io_max);
 
-	if (parity_writer) {
-		io->reader_max = handle_max;
+	/* the parity can be both read and written, to update it in place */
+	io->reader_max = handle_max;
+	if (parity_reader)
+		io->reader_max += parity_handle_max;
+	if (parity_writer)
 		io->writer_max = parity_handle_max;
-	} else {
-		io->reader_max = handle_max + parity_handle_max;
+	else
 		io->writer_max = 0;
-	}
 
-	io->reader_map = malloc_nofail(sizeof(struct snapraid_worker) * io->reader_max);
-	io->reader_list = malloc_nofail(io->reader_max + 1);
-	io->writer_map = malloc_nofail(sizeof(struct snapraid_worker) * io->writer_max);
-	io->writer_list = malloc_nofail(io->writer_max + 1);
+	io->reader_map = malloc_nofail_tag(sizeof(struct snapraid_worker) * io->reader_max, MALLOC_MISC);
+	io->reader_list = malloc_nofail_tag(io->reader_max + 1, MALLOC_MISC);
+	io->writer_map = malloc_nofail_tag(sizeof(struct snapraid_worker) * io->writer_max, MALLOC_MISC);
+	io->writer_list = malloc_nofail_tag(io->writer_max + 1, MALLOC_MISC);
 
 	io->data_base = 0;
 	io->data_count = handle_max;
@@ -913,6 +1070,10 @@ void io_init(struct snapraid_io* io, struct snapraid_state* state,
 		struct snapraid_worker* worker = &io->reader_map[i];
 
 		worker->io = io;
+		worker->io_tick = 0;
+		worker->io_size = 0;
+		memset(worker->io_latency, 0, sizeof(worker->io_latency));
+		worker->io_error = 0;
 
 		if (i < handle_max) {
 			/* it's a data read */
@@ -937,6 +1098,10 @@ void io_init(struct snapraid_io* io, struct snapraid_state* state,
 		struct snapraid_worker* worker = &io->writer_map[i];
 
 		worker->io = io;
+		worker->io_tick = 0;
+		worker->io_size = 0;
+		memset(worker->io_latency, 0, sizeof(worker->io_latency));
+		worker->io_error = 0;
 
 		/* it's a parity write */
 		worker->handle = 0;
@@ -988,10 +1153,12 @@ void io_done(struct snapraid_io* io)
 		free(io->buffer_alloc_map[i]);
 	}
 
-	free(io->reader_map);
-	free(io->reader_list);
-	free(io->writer_map);
-	free(io->writer_list);
+	malloc_counter_dec((size_t)io->state->block_size * io->buffer_max * io->io_max, MALLOC_BUFFER);
+
+	free_tag(io->reader_map, sizeof(struct snapraid_worker) * io->reader_max, MALLOC_MISC);
+	free_tag(io->reader_list, io->reader_max + 1, MALLOC_MISC);
+	free_tag(io->writer_map, sizeof(struct snapraid_worker) * io->writer_max, MALLOC_MISC);
+	free_tag(io->writer_list, io->writer_max + 1, MALLOC_MISC);
 
 #if HAVE_PTHREAD
 	if (io->io_max > 1) {
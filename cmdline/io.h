@@ -88,7 +88,7 @@ struct snapraid_task {
  */
 struct snapraid_worker {
 #if HAVE_PTHREAD
-	pthread_t thread; /**< Thread context for the worker. */
+	struct thread_job job; /**< Job running the worker in the thread pool. */
 #endif
 
 	struct snapraid_io* io; /**< Parent pointer. */
@@ -117,10 +117,28 @@ struct snapraid_worker {
 	 */
 	unsigned index;
 
+	/**
+	 * The sequence number of the task in progress by the worker thread.
+	 *
+	 * It's an always increasing counter, and ::index follows it in the ring.
+	 * A reader may stay behind the caller if its read was hedged.
+	 */
+	unsigned seq;
+
 	/**
 	 * Which buffer base index should be used for destination.
 	 */
 	unsigned buffer_skew;
+
+	/**
+	 * Time, size, latency and errors of the IO completed by the worker.
+	 *
+	 * At the end they are added to the disk or parity.
+	 */
+	uint64_t io_tick;
+	data_off_t io_size;
+	uint32_t io_latency[LATENCY_MAX];
+	unsigned io_error;
 };
 
 /**
@@ -271,6 +289,34 @@ struct snapraid_io {
 	 */
 	unsigned reader_index;
 
+	/**
+	 * The sequence number of the task currently used by the caller.
+	 *
+	 * It's an always increasing counter, and ::reader_index follows it in the ring.
+	 *
+	 * A reader has completed the task of the caller only if its sequence
+	 * number is greater than this one.
+	 */
+	unsigned reader_seq;
+
+	/**
+	 * The position scheduled for each task of the ring.
+	 *
+	 * Readers setup their task with it when they reach the index.
+	 */
+	block_off_t reader_position[IO_MAX];
+
+	/**
+	 * Milliseconds to wait for the latest data read of a position.
+	 *
+	 * When all the other data reads of the position are completed and
+	 * this time expires, the read is abandoned, and io_data_read() returns 0
+	 * to let the caller recover the block from the parity.
+	 *
+	 * 0 to always wait. It's used only in multithread mode.
+	 */
+	unsigned hedge_wait;
+
 	/**
 	 * The task currently used by the caller.
 	 *
@@ -341,7 +387,7 @@ block_off_t (*io_read_next)(struct snapraid_io* io, void*** buffer);
  *
  * \param io InputOutput context.
  * \param diskcur The position of the data block in the ::handle_map vector.
- * \return The completed task.
+ * \return The completed task, or 0 if the read was abandoned because of ::hedge_wait.
  */
 struct snapraid_task* (*io_data_read)(struct snapraid_io* io, unsigned* diskcur, unsigned* waiting_map, unsigned* waiting_mac);
 
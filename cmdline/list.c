@@ -22,10 +22,198 @@
 #include "state.h"
 #include "parity.h"
 #include "handle.h"
+#include "export.h"
 
 /****************************************************************************/
 /* list */
 
+/**
+ * Name of the link type.
+ */
+static const char* link_type(struct snapraid_link* slink)
+{
+	switch (slink->flag & FILE_IS_LINK_MASK) {
+	case FILE_IS_HARDLINK : return "hardlink";
+	case FILE_IS_SYMLINK : return "symlink";
+	case FILE_IS_SYMDIR : return "symdir";
+	case FILE_IS_JUNCTION : return "junction";
+	}
+
+	return "unknown"; /* LCOV_EXCL_LINE */
+}
+
+/**
+ * Number of files formatted by each export job.
+ */
+#define LIST_CHUNK 16384
+
+/**
+ * Max number of export jobs in progress.
+ * It bounds the memory used to keep the output ordered.
+ */
+#define LIST_WINDOW 8
+
+/**
+ * Export job formatting a range of files of a disk.
+ */
+struct list_chunk {
+	struct snapraid_export exp; /**< Memory writer with the formatted output. */
+	struct snapraid_disk* disk; /**< Disk of the files. */
+	tommy_node* begin; /**< First file. */
+	unsigned count; /**< Number of files. */
+	int running; /**< If the job is in progress. */
+#if HAVE_PTHREAD
+	struct thread_job job; /**< Job in the thread pool. */
+#endif
+};
+
+static void* list_chunk_format(void* arg)
+{
+	struct list_chunk* chunk = arg;
+	tommy_node* j = chunk->begin;
+	unsigned n;
+
+	for (n = 0; n < chunk->count; ++n) {
+		struct snapraid_file* file = j->data;
+
+		if (!file_flag_has(file, FILE_IS_EXCLUDED))
+			export_list_file(&chunk->exp, chunk->disk, file);
+		j = j->next;
+	}
+
+	return 0;
+}
+
+/**
+ * Wait for the job and write its output.
+ */
+static void list_chunk_write(struct snapraid_export* exp, struct list_chunk* chunk)
+{
+#if HAVE_PTHREAD
+	void* retval;
+#endif
+
+	if (!chunk->running)
+		return;
+
+#if HAVE_PTHREAD
+	thread_pool_join(&chunk->job, &retval);
+#endif
+
+	export_append(exp, &chunk->exp);
+
+	chunk->running = 0;
+}
+
+/**
+ * List in machine readable format.
+ *
+ * The files of each disk are formatted in parallel in chunks,
+ * and written in order.
+ */
+static void state_list_export(struct snapraid_state* state)
+{
+	struct snapraid_export exp;
+	struct list_chunk* chunk_map;
+	unsigned chunk_next;
+	tommy_node* i;
+	unsigned file_count;
+	data_off_t file_size;
+	unsigned link_count;
+	unsigned l;
+
+	file_count = 0;
+	file_size = 0;
+	link_count = 0;
+
+	export_init(&exp, state->opt.export_format, stdout);
+
+	chunk_map = malloc_nofail(LIST_WINDOW * sizeof(struct list_chunk));
+	for (l = 0; l < LIST_WINDOW; ++l) {
+		export_init(&chunk_map[l].exp, state->opt.export_format, 0);
+		chunk_map[l].running = 0;
+	}
+	chunk_next = 0;
+
+	export_list_header(&exp);
+
+	/* for each disk */
+	for (i = state->disklist; i != 0; i = i->next) {
+		tommy_node* j;
+		struct snapraid_disk* disk = i->data;
+
+		/* sort by name */
+		tommy_list_sort(&disk->filelist, file_path_compare);
+
+		/* for each chunk of files */
+		j = disk->filelist;
+		while (j != 0) {
+			struct list_chunk* chunk = &chunk_map[chunk_next];
+
+			chunk_next = (chunk_next + 1) % LIST_WINDOW;
+
+			/* write the oldest job to reuse its slot */
+			list_chunk_write(&exp, chunk);
+
+			chunk->disk = disk;
+			chunk->begin = j;
+			chunk->count = 0;
+			while (j != 0 && chunk->count < LIST_CHUNK) {
+				struct snapraid_file* file = j->data;
+
+				if (!file_flag_has(file, FILE_IS_EXCLUDED)) {
+					++file_count;
+					file_size += file->size;
+				}
+
+				++chunk->count;
+				j = j->next;
+			}
+
+			chunk->running = 1;
+#if HAVE_PTHREAD
+			thread_pool_run(&chunk->job, 1, list_chunk_format, chunk);
+#else
+			list_chunk_format(chunk);
+#endif
+		}
+
+		/* write all the pending jobs, in order */
+		for (l = 0; l < LIST_WINDOW; ++l) {
+			list_chunk_write(&exp, &chunk_map[chunk_next]);
+			chunk_next = (chunk_next + 1) % LIST_WINDOW;
+		}
+
+		/* sort by name */
+		tommy_list_sort(&disk->linklist, link_alpha_compare);
+
+		/* for each link */
+		for (j = disk->linklist; j != 0; j = j->next) {
+			struct snapraid_link* slink = j->data;
+
+			/* excluded links are not listed */
+			if (link_flag_has(slink, FILE_IS_EXCLUDED))
+				continue;
+
+			++link_count;
+
+			export_list_link(&exp, disk, slink, link_type(slink));
+		}
+	}
+
+	for (l = 0; l < LIST_WINDOW; ++l)
+		export_done(&chunk_map[l].exp);
+	free(chunk_map);
+
+	export_done(&exp);
+
+	log_tag("summary:file_count:%u\n", file_count);
+	log_tag("summary:file_size:%" PRIu64 "\n", file_size);
+	log_tag("summary:link_count:%u\n", link_count);
+	log_tag("summary:exit:ok\n");
+	log_flush();
+}
+
 void state_list(struct snapraid_state* state)
 {
 	tommy_node* i;
@@ -39,6 +227,11 @@ void state_list(struct snapraid_state* state)
 	file_size = 0;
 	link_count = 0;
 
+	if (state->opt.export_format != EXPORT_NONE) {
+		state_list_export(state);
+		return;
+	}
+
 	msg_progress("Listing...\n");
 
 	/* for each disk */
@@ -58,6 +251,10 @@ void state_list(struct snapraid_state* state)
 			struct tm* tm;
 			time_t t;
 
+			/* excluded files are not listed */
+			if (file_flag_has(file, FILE_IS_EXCLUDED))
+				continue;
+
 			++file_count;
 			file_size += file->size;
 
@@ -86,17 +283,11 @@ void state_list(struct snapraid_state* state)
 		/* for each link */
 		for (j = disk->linklist; j != 0; j = j->next) {
 			struct snapraid_link* slink = j->data;
-			const char* type;
-
-			switch (slink->flag & FILE_IS_LINK_MASK) {
-			case FILE_IS_HARDLINK : type = "hardlink"; break;
-			case FILE_IS_SYMLINK : type = "symlink"; break;
-			case FILE_IS_SYMDIR : type = "symdir"; break;
-			case FILE_IS_JUNCTION : type = "junction"; break;
-			/* LCOV_EXCL_START */
-			default : type = "unknown"; break;
-				/* LCOV_EXCL_STOP */
-			}
+			const char* type = link_type(slink);
+
+			/* excluded links are not listed */
+			if (link_flag_has(slink, FILE_IS_EXCLUDED))
+				continue;
 
 			++link_count;
 
@@ -21,6 +21,8 @@
 
 #include "support.h"
 
+#include <psapi.h>
+
 /**
  * Exit codes.
  */
@@ -52,6 +54,12 @@ static BOOLEAN (WINAPI* ptr_RtlGenRandom)(PVOID, ULONG);
  */
 static ULONGLONG (WINAPI* ptr_GetTickCount64)(void);
 
+/**
+ * Direct access to K32GetProcessMemoryInfo().
+ * This function is available only from Windows 7.
+ */
+static BOOL (WINAPI* ptr_K32GetProcessMemoryInfo)(HANDLE, PPROCESS_MEMORY_COUNTERS, DWORD);
+
 /**
  * Description of the last error.
  * It's stored in the thread local storage.
@@ -160,6 +168,9 @@ void os_init(int opt)
 	/* get pointer to RtlGenRandom, note that it was reported missing in some cases */
 	ptr_GetTickCount64 = (void*)GetProcAddress(kernel32, "GetTickCount64");
 
+	/* get pointer to K32GetProcessMemoryInfo, not available in Windows XP */
+	ptr_K32GetProcessMemoryInfo = (void*)GetProcAddress(kernel32, "K32GetProcessMemoryInfo");
+
 	/* set the thread execution level to avoid sleep */
 	/* first try for Windows 7 */
 	if (SetThreadExecutionState(WIN32_ES_CONTINUOUS | WIN32_ES_SYSTEM_REQUIRED | WIN32_ES_AWAYMODE_REQUIRED) == 0) {
@@ -1680,6 +1691,17 @@ int devuuid(uint64_t device, char* uuid, size_t uuid_size)
 	return 0;
 }
 
+int devattr(uint64_t device, int* rotational, unsigned* queue_depth, unsigned* logical_block_size)
+{
+	/* the device parameter is the volume serial number, not a physical disk */
+	log_tag("attr:windows:%u: not supported\n", (unsigned)device);
+
+	(void)rotational;
+	(void)queue_depth;
+	(void)logical_block_size;
+	return -1;
+}
+
 int filephy(const char* file, uint64_t size, uint64_t* physical)
 {
 	wchar_t conv_buf[CONV_MAX];
@@ -2038,6 +2060,41 @@ uint64_t tick_ms(void)
 	return GetTickCount();
 }
 
+int procstat(uint64_t* cpu_ms, uint64_t* read_bytes, uint64_t* write_bytes, uint64_t* peak_rss)
+{
+	HANDLE h = GetCurrentProcess();
+	FILETIME creation, exit, kernel, user;
+	IO_COUNTERS io;
+	PROCESS_MEMORY_COUNTERS mem;
+
+	*cpu_ms = 0;
+	*read_bytes = 0;
+	*write_bytes = 0;
+	*peak_rss = 0;
+
+	if (!GetProcessTimes(h, &creation, &exit, &kernel, &user)) {
+		windows_errno(GetLastError());
+		return -1;
+	}
+
+	/* FILETIME is in 100 nanoseconds unit */
+	*cpu_ms = ((((uint64_t)kernel.dwHighDateTime) << 32) + kernel.dwLowDateTime
+		+ (((uint64_t)user.dwHighDateTime) << 32) + user.dwLowDateTime) / 10000;
+
+	if (GetProcessIoCounters(h, &io)) {
+		*read_bytes = io.ReadTransferCount;
+		*write_bytes = io.WriteTransferCount;
+	}
+
+	if (ptr_K32GetProcessMemoryInfo != 0) {
+		mem.cb = sizeof(mem);
+		if (ptr_K32GetProcessMemoryInfo(h, &mem, sizeof(mem)))
+			*peak_rss = mem.PeakWorkingSetSize;
+	}
+
+	return 0;
+}
+
 int randomize(void* void_ptr, size_t size)
 {
 	size_t i;
@@ -2580,25 +2637,31 @@ static int device_thread(tommy_list* list, void* (*func)(void* arg))
 {
 	int fail = 0;
 	tommy_node* i;
+	struct thread_job* job;
+	unsigned j;
+
+	job = malloc_nofail(tommy_list_count(list) * sizeof(struct thread_job));
 
 	/* starts all threads */
+	j = 0;
 	for (i = tommy_list_head(list); i != 0; i = i->next) {
 		devinfo_t* devinfo = i->data;
 
-		thread_create(&devinfo->thread, 0, func, devinfo);
+		thread_pool_run(&job[j++], 0, func, devinfo);
 	}
 
 	/* joins all threads */
-	for (i = tommy_list_head(list); i != 0; i = i->next) {
-		devinfo_t* devinfo = i->data;
+	for (j = 0; j < tommy_list_count(list); ++j) {
 		void* retval;
 
-		thread_join(devinfo->thread, &retval);
+		thread_pool_join(&job[j], &retval);
 
 		if (retval != 0)
 			++fail;
 	}
 
+	free(job);
+
 	if (fail != 0) {
 		/* LCOV_EXCL_START */
 		return -1;
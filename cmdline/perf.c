@@ -0,0 +1,831 @@
+/*
+ * Copyright (C) 2011 Andrea Mazzoleni
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "portable.h"
+
+#include "support.h"
+#include "elem.h"
+#include "state.h"
+
+/****************************************************************************/
+/* performance history */
+
+/**
+ * Max number of runs kept in the history file.
+ */
+#define PERF_RUN_MAX 64
+
+/**
+ * Number of the most recent runs used for the estimate.
+ */
+#define PERF_RECENT 8
+
+/**
+ * Max length of a line in the history file.
+ */
+#define PERF_LINE_MAX 65536
+
+/**
+ * Speed assumed for a device without history.
+ */
+#define PERF_DEFAULT_SPEED (100 * MEGA)
+
+/**
+ * Min number of previous runs to have a baseline of the device speed.
+ */
+#define PERF_SLOW_RUN 3
+
+/**
+ * Min size processed by a device in a run to compare its speed.
+ */
+#define PERF_SLOW_SIZE (256 * MEGA)
+
+/**
+ * Percentage of the baseline speed under which a device is slow.
+ */
+#define PERF_SLOW_SPEED 70
+
+/**
+ * Times of the baseline latency over which a device is slow.
+ */
+#define PERF_SLOW_LATENCY 3
+
+/**
+ * History of a device.
+ */
+struct perf_device {
+	char name[PATH_MAX];
+	uint64_t size; /**< Size processed. */
+	uint64_t busy_us; /**< Time spent processing it. */
+	uint64_t p50_us; /**< Median latency of a single IO. 0 if not recorded. */
+	uint64_t p99_us; /**< 99th percentile latency of a single IO. 0 if not recorded. */
+	unsigned error; /**< Number of IO errors. */
+	unsigned retry; /**< Number of IO retried. */
+};
+
+/**
+ * Set of devices.
+ */
+struct perf_device_set {
+	struct perf_device* map;
+	unsigned max;
+	unsigned mac;
+};
+
+/**
+ * History of a command.
+ */
+struct perf_history {
+	unsigned run; /**< Number of runs found. */
+	uint64_t size; /**< Size processed in the data disks. */
+	uint64_t elapsed_ms; /**< Time elapsed processing it. */
+	struct perf_device_set device; /**< Devices with the sum of all the runs. */
+};
+
+/**
+ * Single run.
+ */
+struct perf_run {
+	uint64_t time; /**< Time of the run. */
+	char* command; /**< Command of the run. It points inside the line. */
+	uint64_t elapsed_ms; /**< Time elapsed. */
+	uint64_t size; /**< Size processed in the data disks. */
+	struct perf_device_set device; /**< Devices of the run. */
+};
+
+/**
+ * Get the device with the specified name, adding it if missing.
+ */
+static struct perf_device* perf_device_get(struct perf_device_set* set, const char* name)
+{
+	struct perf_device* device;
+	unsigned i;
+
+	for (i = 0; i < set->mac; ++i)
+		if (strcmp(set->map[i].name, name) == 0)
+			return &set->map[i];
+
+	if (set->mac == set->max) {
+		struct perf_device* map;
+		set->max = set->max * 2 + 8;
+		map = malloc_nofail(set->max * sizeof(struct perf_device));
+		if (set->mac)
+			memcpy(map, set->map, set->mac * sizeof(struct perf_device));
+		free(set->map);
+		set->map = map;
+	}
+
+	device = &set->map[set->mac++];
+	pathcpy(device->name, sizeof(device->name), name);
+	device->size = 0;
+	device->busy_us = 0;
+	device->p50_us = 0;
+	device->p99_us = 0;
+	device->error = 0;
+	device->retry = 0;
+
+	return device;
+}
+
+/**
+ * Read all the lines of the history file.
+ * Return the number of lines read, with only the last ::max ones kept in ::line_map.
+ */
+static unsigned perf_load(const char* path, char** line_map, unsigned max)
+{
+	FILE* f;
+	char* buffer;
+	unsigned count;
+
+	f = fopen(path, "rt");
+	if (!f)
+		return 0;
+
+	buffer = malloc_nofail(PERF_LINE_MAX);
+
+	count = 0;
+	while (fgets(buffer, PERF_LINE_MAX, f) != 0) {
+		char* s;
+
+		/* skip incomplete lines */
+		s = strchr(buffer, '\n');
+		if (!s)
+			continue;
+		*s = 0;
+
+		free(line_map[count % max]);
+		line_map[count % max] = strdup_nofail(buffer);
+		++count;
+	}
+
+	fclose(f);
+	free(buffer);
+
+	return count;
+}
+
+/**
+ * Number of numeric fields of a device in a run.
+ */
+#define PERF_FIELD_MAX 6
+
+/**
+ * Number of numeric fields of a device in the older runs.
+ */
+#define PERF_FIELD_OLD 2
+
+/**
+ * Split the device stored in the record, modifying it.
+ * Return 0 on success, or -1 if the record is invalid.
+ *
+ * The fields are split from the right, as the device name may contain ':'.
+ */
+static int perf_split_device(struct perf_run* run, char* record)
+{
+	struct perf_device* device;
+	char* sep[PERF_FIELD_MAX];
+	uint64_t value[PERF_FIELD_MAX];
+	unsigned n;
+	unsigned i;
+	char* e;
+
+	/* search the trailing numeric fields, keeping a not empty name */
+	n = 0;
+	e = record + strlen(record);
+	while (n < PERF_FIELD_MAX) {
+		char* s = e;
+
+		while (s > record && isdigit((unsigned char)s[-1]))
+			--s;
+
+		if (s == e || s - 1 <= record || s[-1] != ':')
+			break;
+
+		e = s - 1;
+		sep[n++] = e;
+	}
+
+	/* use the last fields of the format found */
+	if (n < PERF_FIELD_OLD)
+		return -1;
+	if (n < PERF_FIELD_MAX)
+		n = PERF_FIELD_OLD;
+
+	/* the fields are collected from the right */
+	for (i = 0; i < n; ++i)
+		value[n - 1 - i] = strtoull(sep[i] + 1, 0, 10);
+
+	/* terminate the name */
+	*sep[n - 1] = 0;
+
+	device = perf_device_get(&run->device, record);
+
+	device->size = value[0];
+	device->busy_us = value[1];
+	if (n == PERF_FIELD_MAX) {
+		device->p50_us = value[2];
+		device->p99_us = value[3];
+		device->error = value[4];
+		device->retry = value[5];
+	}
+
+	return 0;
+}
+
+/**
+ * Split the run stored in the line, modifying it.
+ * Return 0 on success, or -1 if the line is invalid.
+ *
+ * The line format is:
+ * TIME COMMAND ELAPSED_MS DATA_SIZE NAME:SIZE:BUSY_US:P50_US:P99_US:ERROR:RETRY ...
+ *
+ * Older records have only NAME:SIZE:BUSY_US.
+ */
+static int perf_split(struct perf_run* run, char* line)
+{
+	char* s;
+	char* e;
+
+	run->device.mac = 0;
+
+	run->time = strtoull(line, &e, 10);
+	if (e == line || *e != ' ')
+		return -1;
+	s = e + 1;
+
+	e = strchr(s, ' ');
+	if (!e)
+		return -1;
+	*e = 0;
+	run->command = s;
+	s = e + 1;
+
+	run->elapsed_ms = strtoull(s, &e, 10);
+	if (e == s || *e != ' ')
+		return -1;
+	s = e + 1;
+
+	run->size = strtoull(s, &e, 10);
+	if (e == s)
+		return -1;
+	s = e;
+
+	while (*s == ' ') {
+		char* record = s + 1;
+		int last;
+
+		/* device names don't contain spaces */
+		s = record + strcspn(record, " ");
+		last = *s == 0;
+		*s = 0;
+
+		if (perf_split_device(run, record) != 0)
+			return -1;
+
+		if (last)
+			break;
+		*s = ' ';
+	}
+
+	return 0;
+}
+
+/**
+ * Add the run stored in the line to the history, if it's of the specified command.
+ */
+static void perf_parse(struct perf_history* history, struct perf_run* run, const char* command, char* line)
+{
+	unsigned i;
+
+	if (perf_split(run, line) != 0)
+		return;
+
+	if (strcmp(run->command, command) != 0)
+		return;
+
+	++history->run;
+	history->elapsed_ms += run->elapsed_ms;
+	history->size += run->size;
+
+	for (i = 0; i < run->device.mac; ++i) {
+		struct perf_device* device = perf_device_get(&history->device, run->device.map[i].name);
+
+		device->size += run->device.map[i].size;
+		device->busy_us += run->device.map[i].busy_us;
+	}
+}
+
+/**
+ * Get the latency in us at the specified percentile of the histogram.
+ */
+static uint64_t perf_latency(const uint32_t* io_latency, unsigned percentile, uint64_t elapsed_tick, uint64_t elapsed_ms)
+{
+	uint64_t count;
+	uint64_t limit;
+	unsigned i;
+
+	count = 0;
+	for (i = 0; i < LATENCY_MAX; ++i)
+		count += io_latency[i];
+
+	if (count == 0 || elapsed_tick == 0)
+		return 0;
+
+	limit = (count * percentile + 99) / 100;
+
+	count = 0;
+	for (i = 0; i < LATENCY_MAX; ++i) {
+		count += io_latency[i];
+		if (count >= limit)
+			break;
+	}
+
+	return (uint64_t)((double)elapsed_ms * 1000 * latency_value(i) / elapsed_tick);
+}
+
+/**
+ * Add a device entry to the run line.
+ */
+static void perf_device(char* line, size_t size, const char* name, data_off_t io_size, uint64_t io_tick, const uint32_t* io_latency, unsigned io_error, unsigned io_retry, uint64_t elapsed_tick, uint64_t elapsed_ms)
+{
+	uint64_t busy_us;
+	uint64_t p50_us;
+	uint64_t p99_us;
+	size_t len;
+
+	/* nothing done */
+	if (io_size == 0 && io_error == 0)
+		return;
+
+	/* convert the tick in us using the elapsed time as reference */
+	if (elapsed_tick != 0)
+		busy_us = (uint64_t)((double)elapsed_ms * 1000 * io_tick / elapsed_tick);
+	else
+		busy_us = 0;
+
+	p50_us = perf_latency(io_latency, 50, elapsed_tick, elapsed_ms);
+	p99_us = perf_latency(io_latency, 99, elapsed_tick, elapsed_ms);
+
+	log_tag("perf:%s:%" PRIu64 ":%" PRIu64 ":%" PRIu64 ":%" PRIu64 ":%u:%u\n", name, (uint64_t)io_size, busy_us, p50_us, p99_us, io_error, io_retry);
+
+	len = strlen(line);
+	snprintf(line + len, size - len, " %s:%" PRIu64 ":%" PRIu64 ":%" PRIu64 ":%" PRIu64 ":%u:%u", name, (uint64_t)io_size, busy_us, p50_us, p99_us, io_error, io_retry);
+}
+
+void state_perf_begin(struct snapraid_state* state)
+{
+	tommy_node* i;
+	unsigned l;
+
+	for (i = state->disklist; i != 0; i = i->next) {
+		struct snapraid_disk* disk = i->data;
+		disk->io_tick = 0;
+		disk->io_size = 0;
+		memset(disk->io_latency, 0, sizeof(disk->io_latency));
+		disk->io_error = 0;
+		disk->io_retry = 0;
+	}
+
+	for (l = 0; l < state->level; ++l) {
+		state->parity[l].io_tick = 0;
+		state->parity[l].io_size = 0;
+		memset(state->parity[l].io_latency, 0, sizeof(state->parity[l].io_latency));
+		state->parity[l].io_error = 0;
+		state->parity[l].io_retry = 0;
+	}
+
+	state->perf_tick = tick();
+	state->perf_ms = tick_ms();
+}
+
+void state_perf_end(struct snapraid_state* state, const char* command)
+{
+	char** line_map;
+	char* line;
+	char path[PATH_MAX];
+	uint64_t elapsed_tick;
+	uint64_t elapsed_ms;
+	uint64_t size;
+	unsigned count;
+	unsigned first;
+	unsigned i;
+	tommy_node* j;
+	unsigned l;
+	FILE* f;
+
+	elapsed_tick = tick() - state->perf_tick;
+	elapsed_ms = tick_ms() - state->perf_ms;
+
+	size = 0;
+	for (j = state->disklist; j != 0; j = j->next) {
+		struct snapraid_disk* disk = j->data;
+		size += disk->io_size;
+	}
+
+	/* nothing to record */
+	if (size == 0 || state->perffile[0] == 0)
+		return;
+
+	log_tag("perf:%s:%" PRIu64 ":%" PRIu64 "\n", command, size, elapsed_ms);
+
+	line = malloc_nofail(PERF_LINE_MAX);
+	snprintf(line, PERF_LINE_MAX, "%" PRIu64 " %s %" PRIu64 " %" PRIu64, (uint64_t)time(0), command, elapsed_ms, size);
+
+	for (j = state->disklist; j != 0; j = j->next) {
+		struct snapraid_disk* disk = j->data;
+		perf_device(line, PERF_LINE_MAX, disk->name, disk->io_size, disk->io_tick, disk->io_latency, disk->io_error, disk->io_retry, elapsed_tick, elapsed_ms);
+	}
+
+	for (l = 0; l < state->level; ++l) {
+		struct snapraid_parity* parity = &state->parity[l];
+		perf_device(line, PERF_LINE_MAX, lev_config_name(l), parity->io_size, parity->io_tick, parity->io_latency, parity->io_error, parity->io_retry, elapsed_tick, elapsed_ms);
+	}
+
+	/* keep only the latest runs */
+	line_map = calloc_nofail(PERF_RUN_MAX, sizeof(char*));
+	count = perf_load(state->perffile, line_map, PERF_RUN_MAX - 1);
+	first = count > PERF_RUN_MAX - 1 ? count - (PERF_RUN_MAX - 1) : 0;
+
+	/* write a new file, and rename it over the old one */
+	pathprint(path, sizeof(path), "%s.tmp", state->perffile);
+	f = fopen(path, "wt");
+	if (!f) {
+		/* LCOV_EXCL_START */
+		log_fatal("WARNING! Error creating the performance history file '%s'. %s.\n", path, strerror(errno));
+		goto bail;
+		/* LCOV_EXCL_STOP */
+	}
+
+	for (i = first; i < count; ++i)
+		fprintf(f, "%s\n", line_map[i % (PERF_RUN_MAX - 1)]);
+	fprintf(f, "%s\n", line);
+
+	if (fclose(f) != 0) {
+		/* LCOV_EXCL_START */
+		log_fatal("WARNING! Error writing the performance history file '%s'. %s.\n", path, strerror(errno));
+		goto bail;
+		/* LCOV_EXCL_STOP */
+	}
+
+	if (rename(path, state->perffile) != 0) {
+		/* LCOV_EXCL_START */
+		log_fatal("WARNING! Error renaming the performance history file '%s' to '%s'. %s.\n", path, state->perffile, strerror(errno));
+		goto bail;
+		/* LCOV_EXCL_STOP */
+	}
+
+bail:
+	for (i = 0; i < PERF_RUN_MAX; ++i)
+		free(line_map[i]);
+	free(line_map);
+	free(line);
+}
+
+/**
+ * Estimate the time in ms to process the size with the device history.
+ */
+static uint64_t perf_time(struct perf_history* history, const char* name, uint64_t size, int* is_default)
+{
+	unsigned i;
+
+	for (i = 0; i < history->device.mac; ++i) {
+		struct perf_device* device = &history->device.map[i];
+
+		if (strcmp(device->name, name) == 0 && device->size != 0) {
+			*is_default = 0;
+			return (uint64_t)((double)size * device->busy_us / device->size / 1000);
+		}
+	}
+
+	*is_default = 1;
+	return size * 1000 / PERF_DEFAULT_SPEED;
+}
+
+/**
+ * Print the estimate of a device.
+ */
+static void perf_print(const char* command, const char* name, uint64_t size, uint64_t time_ms, int is_default)
+{
+	log_tag("estimate:%s:%s:%" PRIu64 ":%" PRIu64 "\n", command, name, size, time_ms / 1000);
+
+	printf("%8" PRIu64, size / MEGA);
+	if (time_ms != 0)
+		printf("%8" PRIu64, size * 1000 / time_ms / MEGA);
+	else
+		printf("       -");
+	printf("%8" PRIu64, time_ms / 60000);
+	printf(" %s%s\n", name, is_default ? " (no history)" : "");
+}
+
+void state_estimate(struct snapraid_state* state, const char* command, block_off_t blockstart, block_off_t blockmax, int (*block_is_enabled)(void*, block_off_t), void* arg)
+{
+	struct perf_history history;
+	struct perf_run run;
+	char** line_map;
+	block_off_t* pos_map;
+	block_off_t countmax;
+	block_off_t i;
+	uint64_t total_size;
+	uint64_t time_ms;
+	uint64_t device_ms;
+	unsigned count;
+	unsigned first;
+	unsigned k;
+	tommy_node* j;
+	unsigned l;
+	int is_default;
+
+	/* load the most recent runs of the command */
+	memset(&history, 0, sizeof(history));
+	memset(&run, 0, sizeof(run));
+	line_map = calloc_nofail(PERF_RUN_MAX, sizeof(char*));
+	count = perf_load(state->perffile, line_map, PERF_RUN_MAX);
+	first = count > PERF_RUN_MAX ? count - PERF_RUN_MAX : 0;
+	for (k = count; k > first && history.run < PERF_RECENT; --k)
+		perf_parse(&history, &run, command, line_map[(k - 1) % PERF_RUN_MAX]);
+	for (k = 0; k < PERF_RUN_MAX; ++k)
+		free(line_map[k]);
+	free(line_map);
+
+	/* get the positions to process, calling the plan only once for each one */
+	pos_map = malloc_nofail_tag((blockmax - blockstart + 1) * sizeof(block_off_t), MALLOC_MISC);
+	countmax = 0;
+	for (i = blockstart; i < blockmax; ++i) {
+		if (block_is_enabled(arg, i))
+			pos_map[countmax++] = i;
+	}
+
+	log_tag("estimate:%s:blocks:%u\n", command, countmax);
+	log_tag("estimate:%s:history:%u\n", command, history.run);
+
+	printf("\n");
+	printf("Estimate of '%s' for %u blocks from the history of %u runs:\n", command, countmax, history.run);
+	printf("\n");
+	printf("    Size   Speed    Time\n");
+	printf("    (MB)  (MB/s)   (min)\n");
+	printf("\n");
+
+	/* the devices work in parallel, and the slowest one sets the time */
+	time_ms = 0;
+	total_size = 0;
+	for (j = state->disklist; j != 0; j = j->next) {
+		struct snapraid_disk* disk = j->data;
+		uint64_t size = 0;
+		block_off_t b;
+
+		for (b = 0; b < countmax; ++b) {
+			block_off_t file_pos;
+			struct snapraid_file* file = fs_par2file_find(disk, pos_map[b], &file_pos);
+
+			if (file)
+				size += file_block_size(file, file_pos, state->block_size);
+		}
+
+		if (size == 0)
+			continue;
+
+		total_size += size;
+		device_ms = perf_time(&history, disk->name, size, &is_default);
+		if (time_ms < device_ms)
+			time_ms = device_ms;
+
+		perf_print(command, disk->name, size, device_ms, is_default);
+	}
+
+	for (l = 0; l < state->level; ++l) {
+		uint64_t size = 0;
+		block_off_t b;
+
+		/* only the parity verified in this cycle is read */
+		for (b = 0; b < countmax; ++b) {
+			if (info_has_parity(info_get(&state->infoarr, pos_map[b]), pos_map[b], l, state->opt.parity_cycle))
+				size += state->block_size;
+		}
+
+		if (size == 0)
+			continue;
+
+		device_ms = perf_time(&history, lev_config_name(l), size, &is_default);
+		if (time_ms < device_ms)
+			time_ms = device_ms;
+
+		perf_print(command, lev_config_name(l), size, device_ms, is_default);
+	}
+
+	/* the whole run may be slower than the devices, for example for CPU */
+	if (history.size != 0) {
+		device_ms = (uint64_t)((double)total_size * history.elapsed_ms / history.size);
+		if (time_ms < device_ms)
+			time_ms = device_ms;
+	}
+
+	log_tag("estimate:%s:total:%" PRIu64 ":%" PRIu64 "\n", command, total_size, time_ms / 1000);
+
+	printf("\n");
+	printf("Estimated duration %u:%02u (hours:minutes)\n", (unsigned)(time_ms / 3600000), (unsigned)((time_ms / 60000) % 60));
+
+	free_tag(pos_map, (blockmax - blockstart + 1) * sizeof(block_off_t), MALLOC_MISC);
+	free(history.device.map);
+	free(run.device.map);
+}
+
+static int perf_cmp(const void* void_a, const void* void_b)
+{
+	uint64_t a = *(const uint64_t*)void_a;
+	uint64_t b = *(const uint64_t*)void_b;
+
+	if (a < b)
+		return -1;
+	if (a > b)
+		return 1;
+	return 0;
+}
+
+/**
+ * Get the speed in bytes for second.
+ *
+ * It's computed in floating point, as the size in bytes multiplied
+ * by the us in a second overflows with a few TB.
+ */
+static uint64_t perf_speed(uint64_t size, uint64_t busy_us)
+{
+	return (uint64_t)((double)size * 1000000 / busy_us);
+}
+
+/**
+ * Get the median of the values, reordering them.
+ */
+static uint64_t perf_median(uint64_t* map, unsigned count)
+{
+	qsort(map, count, sizeof(uint64_t), perf_cmp);
+
+	return map[count / 2];
+}
+
+/**
+ * Print the header of the report at the first line printed.
+ */
+static void perf_slow_header(int* header)
+{
+	if (*header)
+		return;
+
+	*header = 1;
+	printf("\n");
+}
+
+/**
+ * Compare the devices of the latest run of the command with their previous runs.
+ * Return the number of devices slower than their baseline, and increment ::compared
+ * for each device with enough history to have a baseline.
+ */
+static unsigned perf_slow_command(struct perf_run* run_map, unsigned run_count, const char* command, unsigned* compared, int* header)
+{
+	struct perf_run* last;
+	uint64_t* speed_map;
+	uint64_t* latency_map;
+	unsigned slow;
+	unsigned i;
+	unsigned k;
+
+	/* search the latest run of the command */
+	for (k = run_count; k > 0; --k)
+		if (strcmp(run_map[k - 1].command, command) == 0)
+			break;
+	if (k == 0)
+		return 0;
+	last = &run_map[k - 1];
+
+	speed_map = malloc_nofail(run_count * sizeof(uint64_t));
+	latency_map = malloc_nofail(run_count * sizeof(uint64_t));
+
+	slow = 0;
+	for (i = 0; i < last->device.mac; ++i) {
+		struct perf_device* device = &last->device.map[i];
+		unsigned speed_count;
+		unsigned latency_count;
+		uint64_t speed;
+		unsigned j;
+
+		if (device->error != 0 || device->retry != 0) {
+			perf_slow_header(header);
+			printf("WARNING! Disk '%s' had %u IO errors and %u slow reads in the last '%s'.\n", device->name, device->error, device->retry, command);
+			log_tag("perf_error:%s:%s:%u:%u\n", command, device->name, device->error, device->retry);
+		}
+
+		/* too little work to be measured */
+		if (device->size < PERF_SLOW_SIZE || device->busy_us == 0)
+			continue;
+
+		speed = perf_speed(device->size, device->busy_us);
+
+		/* collect the previous runs of the same device */
+		speed_count = 0;
+		latency_count = 0;
+		for (j = 0; j + 1 < k; ++j) {
+			struct perf_device* prev;
+			unsigned d;
+
+			if (strcmp(run_map[j].command, command) != 0)
+				continue;
+
+			for (d = 0; d < run_map[j].device.mac; ++d)
+				if (strcmp(run_map[j].device.map[d].name, device->name) == 0)
+					break;
+			if (d == run_map[j].device.mac)
+				continue;
+			prev = &run_map[j].device.map[d];
+
+			if (prev->size < PERF_SLOW_SIZE || prev->busy_us == 0)
+				continue;
+
+			speed_map[speed_count++] = perf_speed(prev->size, prev->busy_us);
+			if (prev->p99_us != 0)
+				latency_map[latency_count++] = prev->p99_us;
+		}
+
+		/* not enough history for a baseline */
+		if (speed_count < PERF_SLOW_RUN)
+			continue;
+
+		++*compared;
+
+		if (speed * 100 < perf_median(speed_map, speed_count) * PERF_SLOW_SPEED) {
+			uint64_t baseline = perf_median(speed_map, speed_count);
+			perf_slow_header(header);
+			printf("WARNING! Disk '%s' in the last '%s' was at %" PRIu64 " MB/s, slower than its usual %" PRIu64 " MB/s.\n", device->name, command, speed / MEGA, baseline / MEGA);
+			log_tag("perf_slow:%s:%s:speed:%" PRIu64 ":%" PRIu64 "\n", command, device->name, speed, baseline);
+			++slow;
+		} else if (latency_count >= PERF_SLOW_RUN && device->p99_us != 0
+			&& device->p99_us > perf_median(latency_map, latency_count) * PERF_SLOW_LATENCY) {
+			uint64_t baseline = perf_median(latency_map, latency_count);
+			perf_slow_header(header);
+			printf("WARNING! Disk '%s' in the last '%s' had a 99%% latency of %" PRIu64 " ms, over its usual %" PRIu64 " ms.\n", device->name, command, device->p99_us / 1000, baseline / 1000);
+			log_tag("perf_slow:%s:%s:latency:%" PRIu64 ":%" PRIu64 "\n", command, device->name, device->p99_us, baseline);
+			++slow;
+		}
+	}
+
+	free(speed_map);
+	free(latency_map);
+
+	return slow;
+}
+
+void state_perf_slow(struct snapraid_state* state)
+{
+	struct perf_run* run_map;
+	char** line_map;
+	unsigned run_count;
+	unsigned count;
+	unsigned first;
+	unsigned slow;
+	unsigned compared;
+	unsigned k;
+	int header;
+
+	line_map = calloc_nofail(PERF_RUN_MAX, sizeof(char*));
+	count = perf_load(state->perffile, line_map, PERF_RUN_MAX);
+	first = count > PERF_RUN_MAX ? count - PERF_RUN_MAX : 0;
+
+	/* split all the runs, from the oldest to the newest */
+	run_map = calloc_nofail(PERF_RUN_MAX, sizeof(struct perf_run));
+	run_count = 0;
+	for (k = first; k < count; ++k) {
+		if (perf_split(&run_map[run_count], line_map[k % PERF_RUN_MAX]) == 0)
+			++run_count;
+	}
+
+	header = 0;
+	compared = 0;
+	slow = perf_slow_command(run_map, run_count, "sync", &compared, &header);
+	slow += perf_slow_command(run_map, run_count, "scrub", &compared, &header);
+
+	log_tag("summary:perf_slow:%u:%u\n", compared, slow);
+
+	if (compared != 0 && slow == 0) {
+		perf_slow_header(&header);
+		printf("No disk is slower than its usual performance.\n");
+	}
+
+	for (k = 0; k < PERF_RUN_MAX; ++k) {
+		free(run_map[k].device.map);
+		free(line_map[k]);
+	}
+	free(run_map);
+	free(line_map);
+}
@@ -242,10 +242,14 @@ void state_pool(struct snapraid_state* state)
 	for (i = state->disklist; i != 0; i = i->next) {
 		tommy_node* j;
 		struct snapraid_disk* disk = i->data;
-
-		/* for each file */
-		for (j = disk->filelist; j != 0; j = j->next) {
-			struct snapraid_file* file = j->data;
+		struct snapraid_file** file_map;
+		unsigned file_count;
+		unsigned k;
+
+		/* for each file, in directory order */
+		file_map = fs_file_order(disk, &file_count);
+		for (k = 0; k < file_count; ++k) {
+			struct snapraid_file* file = file_map[k];
 			make_link(pool_dir, share_dir, disk, file->sub, file->mtime_sec, file->mtime_nsec);
 			++count;
 		}
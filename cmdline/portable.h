@@ -113,6 +113,10 @@
 #include <sys/statfs.h>
 #endif
 
+#if HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
 #if HAVE_SYS_FILE_H
 #include <sys/file.h>
 #endif
@@ -313,6 +317,15 @@ static inline int hardlink(const char* a, const char* b)
  */
 int devuuid(uint64_t device, char* uuid, size_t size);
 
+/**
+ * Get the I/O characteristics of the device.
+ * \param rotational If the device is rotational, like HDD and SMR.
+ * \param queue_depth Max number of requests in the device queue. 0 if unknown.
+ * \param logical_block_size Logical block size in bytes. 0 if unknown.
+ * Return 0 on success.
+ */
+int devattr(uint64_t device, int* rotational, unsigned* queue_depth, unsigned* logical_block_size);
+
 /**
  * Physical offset not yet read.
  */
@@ -360,6 +373,17 @@ uint64_t tick(void);
  */
 uint64_t tick_ms(void);
 
+/**
+ * Get the resource usage of the current process.
+ * \param cpu_ms CPU time, user and system, in milliseconds.
+ * \param read_bytes Bytes read by the process.
+ * \param write_bytes Bytes written by the process.
+ * \param peak_rss Peak resident memory in bytes.
+ * The values not available are set to 0.
+ * Return -1 on error, 0 on success.
+ */
+int procstat(uint64_t* cpu_ms, uint64_t* read_bytes, uint64_t* write_bytes, uint64_t* peak_rss);
+
 /**
  * Initializes the system.
  */
@@ -468,9 +492,6 @@ struct devinfo_struct {
 	char smart_serial[SMART_MAX]; /**< SMART serial number. */
 	char smart_vendor[SMART_MAX]; /**< SMART vendor. */
 	char smart_model[SMART_MAX]; /**< SMART model. */
-#if HAVE_PTHREAD
-	pthread_t thread;
-#endif
 	tommy_node node;
 };
 typedef struct devinfo_struct devinfo_t;
@@ -0,0 +1,825 @@
+/*
+ * Copyright (C) 2011 Andrea Mazzoleni
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "portable.h"
+
+#include "support.h"
+#include "elem.h"
+#include "state.h"
+#include "parity.h"
+#include "handle.h"
+#include "io.h"
+#include "raid/raid.h"
+
+/****************************************************************************/
+/* retire */
+
+/**
+ * Check if we have to process the specified block index ::i.
+ *
+ * Only the positions where the retiring disk has a block still
+ * contained in the parity are processed.
+ */
+static int block_is_enabled(void* void_disk, block_off_t i)
+{
+	struct snapraid_disk* disk = void_disk;
+	struct snapraid_block* block = fs_par2block_find(disk, i);
+
+	return block_state_get(block) == BLOCK_STATE_DELETED;
+}
+
+static void retire_data_reader(struct snapraid_worker* worker, struct snapraid_task* task)
+{
+	struct snapraid_io* io = worker->io;
+	struct snapraid_state* state = io->state;
+	struct snapraid_handle* handle = worker->handle;
+	struct snapraid_disk* disk = handle->disk;
+	block_off_t blockcur = task->position;
+	unsigned char* buffer = task->buffer;
+	int ret;
+	char esc_buffer[ESC_MAX];
+
+	/* get the block */
+	task->block = fs_par2block_find(disk, blockcur);
+
+	/* if the block is not contained in the parity */
+	if (block_state_get(task->block) != BLOCK_STATE_DELETED) {
+		/* use an empty block */
+		memset(buffer, 0, state->block_size);
+		task->state = TASK_STATE_DONE;
+		return;
+	}
+
+	/* get the file of this block */
+	task->file = fs_par2file_get(disk, blockcur, &task->file_pos);
+
+	/* if the file is different than the current one, close it */
+	if (handle->file != 0 && handle->file != task->file) {
+		/* keep a pointer at the file we are going to close for error reporting */
+		struct snapraid_file* report = handle->file;
+		ret = handle_close(handle);
+		if (ret == -1) {
+			/* LCOV_EXCL_START */
+			/* This one is really an unexpected error, because we are only reading */
+			/* and closing a descriptor should never fail */
+			if (errno == EIO) {
+				log_tag("error:%u:%s:%s: Close EIO error. %s\n", blockcur, disk->name, esc_tag(report->sub, esc_buffer), strerror(errno));
+				log_fatal("DANGER! Unexpected input/output close error in a data disk, it isn't possible to retire.\n");
+				log_fatal("Ensure that disk '%s' is sane and that file '%s' can be accessed.\n", disk->dir, handle->path);
+				log_fatal("Stopping at block %u\n", blockcur);
+				task->state = TASK_STATE_IOERROR;
+				return;
+			}
+
+			log_tag("error:%u:%s:%s: Close error. %s\n", blockcur, disk->name, esc_tag(report->sub, esc_buffer), strerror(errno));
+			log_fatal("WARNING! Unexpected close error in a data disk, it isn't possible to retire.\n");
+			log_fatal("Ensure that file '%s' can be accessed.\n", handle->path);
+			log_fatal("Stopping at block %u\n", blockcur);
+			task->state = TASK_STATE_ERROR;
+			return;
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	ret = handle_open(handle, task->file, handle->disk->file_mode, log_error, 0);
+	if (ret == -1) {
+		if (errno == EIO) {
+			/* LCOV_EXCL_START */
+			log_tag("error:%u:%s:%s: Open EIO error. %s\n", blockcur, disk->name, esc_tag(task->file->sub, esc_buffer), strerror(errno));
+			log_fatal("DANGER! Unexpected input/output open error in a data disk, it isn't possible to retire.\n");
+			log_fatal("Ensure that disk '%s' is sane and that file '%s' can be accessed.\n", disk->dir, handle->path);
+			log_fatal("Stopping at block %u\n", blockcur);
+			task->state = TASK_STATE_IOERROR;
+			return;
+			/* LCOV_EXCL_STOP */
+		}
+
+		log_tag("error:%u:%s:%s: Open error. %s\n", blockcur, disk->name, esc_tag(task->file->sub, esc_buffer), strerror(errno));
+		task->state = TASK_STATE_ERROR_CONTINUE;
+		return;
+	}
+
+	/* note that we don't check the file attributes, as only the hash */
+	/* tells if the data is still the one contained in the parity */
+
+	task->read_size = handle_read(handle, task->file_pos, buffer, state->block_size, log_error, 0);
+	if (task->read_size == -1) {
+		if (errno == EIO) {
+			log_tag("error:%u:%s:%s: Read EIO error at position %u. %s\n", blockcur, disk->name, esc_tag(task->file->sub, esc_buffer), task->file_pos, strerror(errno));
+			log_error("Input/Output error in file '%s' at position '%u'\n", handle->path, task->file_pos);
+			task->state = TASK_STATE_IOERROR_CONTINUE;
+			return;
+		}
+
+		log_tag("error:%u:%s:%s: Read error at position %u. %s\n", blockcur, disk->name, esc_tag(task->file->sub, esc_buffer), task->file_pos, strerror(errno));
+		task->state = TASK_STATE_ERROR_CONTINUE;
+		return;
+	}
+
+	/* store the path of the opened file */
+	pathcpy(task->path, sizeof(task->path), handle->path);
+
+	task->state = TASK_STATE_DONE;
+}
+
+static void retire_parity_reader(struct snapraid_worker* worker, struct snapraid_task* task)
+{
+	struct snapraid_io* io = worker->io;
+	struct snapraid_state* state = io->state;
+	struct snapraid_parity_handle* parity_handle = worker->parity_handle;
+	unsigned level = parity_handle->level;
+	block_off_t blockcur = task->position;
+	unsigned char* buffer = task->buffer;
+	int ret;
+
+	/* read the parity */
+	ret = parity_read(parity_handle, blockcur, buffer, state->block_size, log_error);
+	if (ret == -1) {
+		if (errno == EIO) {
+			log_tag("parity_error:%u:%s: Read EIO error. %s\n", blockcur, lev_config_name(level), strerror(errno));
+			log_error("Input/Output error in parity '%s' at position '%u'\n", lev_config_name(level), blockcur);
+			task->state = TASK_STATE_IOERROR_CONTINUE;
+			return;
+		}
+
+		log_tag("parity_error:%u:%s: Read error. %s\n", blockcur, lev_config_name(level), strerror(errno));
+		task->state = TASK_STATE_ERROR_CONTINUE;
+		return;
+	}
+
+	task->state = TASK_STATE_DONE;
+}
+
+static void retire_parity_writer(struct snapraid_worker* worker, struct snapraid_task* task)
+{
+	struct snapraid_io* io = worker->io;
+	struct snapraid_state* state = io->state;
+	struct snapraid_parity_handle* parity_handle = worker->parity_handle;
+	unsigned level = parity_handle->level;
+	block_off_t blockcur = task->position;
+	unsigned char* buffer = task->buffer;
+	int ret;
+
+	/* write parity */
+	ret = parity_write(parity_handle, blockcur, buffer, state->block_size);
+	if (ret == -1) {
+		/* LCOV_EXCL_START */
+		if (errno == EIO) {
+			log_tag("parity_error:%u:%s: Write EIO error. %s\n", blockcur, lev_config_name(level), strerror(errno));
+			log_error("Input/Output error in parity '%s' at position '%u'\n", lev_config_name(level), blockcur);
+			task->state = TASK_STATE_IOERROR_CONTINUE;
+			return;
+		}
+
+		log_tag("parity_error:%u:%s: Write error. %s\n", blockcur, lev_config_name(level), strerror(errno));
+		log_fatal("WARNING! Unexpected write error in the %s disk, it isn't possible to retire.\n", lev_name(level));
+		log_fatal("Ensure that disk '%s' is sane.\n", lev_config_name(level));
+		log_fatal("Stopping at block %u\n", blockcur);
+		task->state = TASK_STATE_ERROR;
+		return;
+		/* LCOV_EXCL_STOP */
+	}
+
+	task->state = TASK_STATE_DONE;
+}
+
+/**
+ * Remove all the files, links and dirs of the disk from the state.
+ *
+ * The blocks of the files are kept as DELETED, because the parity
+ * still contains their data, until it's removed by the retire process.
+ */
+static void retire_disk_content(struct snapraid_state* state, struct snapraid_disk* disk)
+{
+	tommy_node* i;
+
+	/* state changed */
+	state->need_write = 1;
+
+	i = tommy_list_head(&disk->filelist);
+	while (i) {
+		struct snapraid_file* file = i->data;
+		block_off_t j;
+
+		/* go to the next file before removing */
+		i = i->next;
+
+		/* remove the file from the containers */
+		if (!file_flag_has(file, FILE_IS_WITHOUT_INODE))
+			tommy_hashlin_remove_existing(&disk->inodeset, &file->nodeset);
+		tommy_hashlin_remove_existing(&disk->pathset, &file->pathset);
+		tommy_hashlin_remove_existing(&disk->stampset, &file->stampset);
+		tommy_list_remove_existing(&disk->filelist, &file->nodelist);
+		fs_file_order_reset(disk);
+
+		/* set all the blocks as deleted, keeping the hash of the data in the parity */
+		for (j = 0; j < file->blockmax; ++j) {
+			struct snapraid_block* block = fs_file2block_get(file, j);
+
+			if (block_state_get(block) != BLOCK_STATE_BLK) {
+				/* LCOV_EXCL_START */
+				log_fatal("Internal inconsistency in file '%s' retiring block '%u:%u' state %u\n", file->sub, j, file->blockmax, block_state_get(block));
+				os_abort();
+				/* LCOV_EXCL_STOP */
+			}
+
+			block_state_set(block, BLOCK_STATE_DELETED);
+		}
+
+		/* mark the file as deleted */
+		file_flag_set(file, FILE_IS_DELETED);
+
+		/* insert it in the list of deleted blocks */
+		tommy_list_insert_tail(&disk->deletedlist, &file->nodelist, file);
+	}
+
+	i = tommy_list_head(&disk->linklist);
+	while (i) {
+		struct snapraid_link* slink = i->data;
+
+		/* go to the next link before removing */
+		i = i->next;
+
+		tommy_hashlin_remove_existing(&disk->linkset, &slink->nodeset);
+		tommy_list_remove_existing(&disk->linklist, &slink->nodelist);
+		link_free(slink);
+	}
+
+	i = tommy_list_head(&disk->dirlist);
+	while (i) {
+		struct snapraid_dir* dir = i->data;
+
+		/* go to the next dir before removing */
+		i = i->next;
+
+		tommy_hashlin_remove_existing(&disk->dirset, &dir->nodeset);
+		tommy_list_remove_existing(&disk->dirlist, &dir->nodelist);
+		dir_free(dir);
+	}
+}
+
+static int state_retire_process(struct snapraid_state* state, struct snapraid_disk* disk, unsigned position, struct snapraid_parity_handle* parity_handle, block_off_t blockstart, block_off_t blockmax)
+{
+	struct snapraid_io io;
+	struct snapraid_handle* handle;
+	block_off_t blockcur;
+	unsigned j;
+	unsigned buffermax;
+	data_off_t countsize;
+	block_off_t countpos;
+	block_off_t countmax;
+	block_off_t autosavedone;
+	block_off_t autosavelimit;
+	block_off_t autosavemissing;
+	int ret;
+	unsigned error;
+	unsigned silent_error;
+	unsigned io_error;
+	unsigned l;
+	unsigned* waiting_map;
+	unsigned waiting_mac;
+	char esc_buffer[ESC_MAX];
+
+	/* only the retiring disk is read */
+	handle = malloc_nofail(sizeof(struct snapraid_handle));
+	handle->disk = disk;
+	handle->file = 0;
+	handle->f = -1;
+	handle->valid_size = 0;
+
+	/* we need 1 * data + 2 * parity */
+	/* the data is followed by the parity to write, and then by the parity read */
+	/* and this is the same layout expected by raid_sub() */
+	buffermax = 1 + 2 * state->level;
+
+	/* initialize the io threads */
+	io_init(&io, state, state->opt.io_cache, buffermax, retire_data_reader, handle, 1, retire_parity_reader, retire_parity_writer, parity_handle, state->level);
+
+	/* possibly waiting disks */
+	waiting_mac = RAID_PARITY_MAX;
+	waiting_map = malloc_nofail(waiting_mac * sizeof(unsigned));
+
+	error = 0;
+	silent_error = 0;
+	io_error = 0;
+
+	/* first count the number of blocks to process */
+	countmax = 0;
+	for (blockcur = blockstart; blockcur < blockmax; ++blockcur) {
+		if (!block_is_enabled(disk, blockcur))
+			continue;
+		++countmax;
+	}
+
+	/* compute the autosave size for the only disk read */
+	autosavelimit = state->autosave / state->block_size;
+	autosavemissing = countmax; /* blocks to do */
+	autosavedone = 0; /* blocks done */
+
+	/* drop until now */
+	state_usage_waste(state);
+
+	countsize = 0;
+	countpos = 0;
+
+	/* start all the worker threads */
+	io_start(&io, blockstart, blockmax, &block_is_enabled, disk);
+
+	state_progress_begin(state, blockstart, blockmax, countmax);
+	while (1) {
+		int writer_error[IO_WRITER_ERROR_MAX];
+		snapraid_info info;
+		int error_on_this_block;
+		struct snapraid_task* task;
+		unsigned char hash[HASH_MAX];
+		struct snapraid_block* block;
+		struct snapraid_file* file;
+		block_off_t file_pos;
+		int read_size;
+		unsigned diskcur;
+		void** buffer;
+
+		/* go to the next block */
+		blockcur = io_read_next(&io, &buffer);
+		if (blockcur >= blockmax)
+			break;
+
+		/* until now is scheduling */
+		state_usage_sched(state);
+
+		/* one more block processed for autosave */
+		++autosavedone;
+		--autosavemissing;
+
+		/* by default process the block, and skip it if something goes wrong */
+		error_on_this_block = 0;
+
+		/* get block specific info */
+		info = info_get(&state->infoarr, blockcur);
+
+		/* get the next task */
+		task = io_data_read(&io, &diskcur, waiting_map, &waiting_mac);
+
+		/* until now is disk */
+		state_usage_disk(state, handle, waiting_map, waiting_mac);
+
+		/* get the task results */
+		block = task->block;
+		file = task->file;
+		file_pos = task->file_pos;
+		read_size = task->read_size;
+
+		/* handle error conditions */
+		if (task->state == TASK_STATE_IOERROR) {
+			/* LCOV_EXCL_START */
+			++io_error;
+			goto bail;
+			/* LCOV_EXCL_STOP */
+		}
+		if (task->state == TASK_STATE_ERROR) {
+			/* LCOV_EXCL_START */
+			++error;
+			goto bail;
+			/* LCOV_EXCL_STOP */
+		}
+		if (task->state == TASK_STATE_ERROR_CONTINUE) {
+			++error;
+			error_on_this_block = 1;
+		}
+		if (task->state == TASK_STATE_IOERROR_CONTINUE) {
+			++io_error;
+			if (io_error >= state->opt.io_error_limit) {
+				/* LCOV_EXCL_START */
+				log_fatal("DANGER! Too many input/output read error in a data disk, it isn't possible to retire.\n");
+				log_fatal("Ensure that disk '%s' is sane and that file '%s' can be accessed.\n", disk->dir, task->path);
+				log_fatal("Stopping at block %u\n", blockcur);
+				goto bail;
+				/* LCOV_EXCL_STOP */
+			}
+
+			/* otherwise continue */
+			error_on_this_block = 1;
+		}
+
+		if (!error_on_this_block) {
+			if (task->state != TASK_STATE_DONE) {
+				/* LCOV_EXCL_START */
+				log_fatal("Internal inconsistency in task state\n");
+				os_abort();
+				/* LCOV_EXCL_STOP */
+			}
+
+			countsize += read_size;
+
+			/* compute the hash, using the old one if required */
+			if (info_get_rehash(info))
+				memhash(state->prevhash, state->prevhashseed, hash, buffer[0], read_size);
+			else
+				memhash(state->hash, state->hashseed, hash, buffer[0], read_size);
+
+			/* until now is hash */
+			state_usage_hash(state);
+
+			/* only the data with the same hash is the one contained in the parity */
+			if (memcmp(hash, block->hash, BLOCK_HASH_SIZE) != 0) {
+				unsigned diff = memdiff(hash, block->hash, BLOCK_HASH_SIZE);
+
+				log_tag("error:%u:%s:%s: Data error at position %u, diff bits %u/%u\n", blockcur, disk->name, esc_tag(file->sub, esc_buffer), file_pos, diff, BLOCK_HASH_SIZE*8);
+				log_error("Data error in file '%s' at position '%u', diff bits %u/%u\n", task->path, file_pos, diff, BLOCK_HASH_SIZE*8);
+				++silent_error;
+				error_on_this_block = 1;
+			}
+		}
+
+		/* until now is misc */
+		state_usage_misc(state);
+
+		/* read the parity */
+		for (l = 0; l < state->level; ++l) {
+			unsigned levcur;
+
+			task = io_parity_read(&io, &levcur, waiting_map, &waiting_mac);
+
+			/* until now is parity */
+			state_usage_parity(state, waiting_map, waiting_mac);
+
+			/* handle error conditions */
+			if (task->state == TASK_STATE_IOERROR) {
+				/* LCOV_EXCL_START */
+				++io_error;
+				goto bail;
+				/* LCOV_EXCL_STOP */
+			}
+			if (task->state == TASK_STATE_ERROR) {
+				/* LCOV_EXCL_START */
+				++error;
+				goto bail;
+				/* LCOV_EXCL_STOP */
+			}
+			if (task->state == TASK_STATE_ERROR_CONTINUE) {
+				++error;
+				error_on_this_block = 1;
+				continue;
+			}
+			if (task->state == TASK_STATE_IOERROR_CONTINUE) {
+				++io_error;
+				if (io_error >= state->opt.io_error_limit) {
+					/* LCOV_EXCL_START */
+					log_fatal("DANGER! Too many input/output read error in the %s disk, it isn't possible to retire.\n", lev_name(levcur));
+					log_fatal("Ensure that disk '%s' is sane and can be read.\n", lev_config_name(levcur));
+					log_fatal("Stopping at block %u\n", blockcur);
+					goto bail;
+					/* LCOV_EXCL_STOP */
+				}
+
+				/* otherwise continue */
+				error_on_this_block = 1;
+				continue;
+			}
+			if (task->state != TASK_STATE_DONE) {
+				/* LCOV_EXCL_START */
+				log_fatal("Internal inconsistency in task state\n");
+				os_abort();
+				/* LCOV_EXCL_STOP */
+			}
+		}
+
+		/* if all the data and parity is correct, remove the data from the parity */
+		if (!error_on_this_block) {
+			/* copy the parity read in the buffers to write */
+			for (l = 0; l < state->level; ++l)
+				memcpy(buffer[1 + l], buffer[1 + state->level + l], state->block_size);
+
+			raid_sub(position, state->level, state->block_size, buffer);
+
+			/* until now is raid */
+			state_usage_raid(state);
+		}
+
+		/* write start */
+		io_write_preset(&io, blockcur, error_on_this_block);
+
+		/* write the parity */
+		for (l = 0; l < state->level; ++l) {
+			unsigned levcur;
+
+			io_parity_write(&io, &levcur, waiting_map, &waiting_mac);
+
+			/* until now is parity */
+			state_usage_parity(state, waiting_map, waiting_mac);
+		}
+
+		/* write finished */
+		io_write_next(&io, blockcur, error_on_this_block, writer_error);
+
+		/* handle errors reported */
+		for (j = 0; j < IO_WRITER_ERROR_MAX; ++j) {
+			if (writer_error[j]) {
+				switch (j + IO_WRITER_ERROR_BASE) {
+				case TASK_STATE_IOERROR_CONTINUE :
+					++io_error;
+					if (io_error >= state->opt.io_error_limit) {
+						/* LCOV_EXCL_START */
+						log_fatal("DANGER! Unexpected input/output write error in a parity disk, it isn't possible to retire.\n");
+						log_fatal("Stopping at block %u\n", blockcur);
+						goto bail;
+						/* LCOV_EXCL_STOP */
+					}
+					break;
+				case TASK_STATE_ERROR_CONTINUE :
+					++error;
+					break;
+				case TASK_STATE_IOERROR :
+					/* LCOV_EXCL_START */
+					++io_error;
+					goto bail;
+					/* LCOV_EXCL_STOP */
+				case TASK_STATE_ERROR :
+					/* LCOV_EXCL_START */
+					++error;
+					goto bail;
+					/* LCOV_EXCL_STOP */
+				}
+			}
+		}
+
+		/* the parity doesn't contain anymore the block, so it's now empty */
+		/* if something went wrong, the block is kept as DELETED, */
+		/* and a later 'sync' will recompute the parity without it */
+		if (!error_on_this_block) {
+			fs_deallocate(disk, blockcur);
+
+			/* mark the state as needing write */
+			state->need_write = 1;
+		} else {
+			/* mark the block as bad to have check/fix to handle it */
+			info_set(&state->infoarr, blockcur, info_set_bad(info));
+		}
+
+		/* count the number of processed block */
+		++countpos;
+
+		/* progress */
+		if (state_progress(state, &io, blockcur, countpos, countmax, countsize)) {
+			/* LCOV_EXCL_START */
+			break;
+			/* LCOV_EXCL_STOP */
+		}
+
+		/* autosave */
+		if (state->autosave != 0
+			&& autosavedone >= autosavelimit /* if we have reached the limit */
+			&& autosavemissing >= autosavelimit /* if we have at least a full step to do */
+		) {
+			autosavedone = 0; /* restart the counter */
+
+			/* until now is misc */
+			state_usage_misc(state);
+
+			state_progress_stop(state);
+
+			msg_progress("Autosaving...\n");
+
+			/* before writing the new content file we ensure that */
+			/* the parity is really written flushing the disk cache */
+			for (l = 0; l < state->level; ++l) {
+				ret = parity_sync(&parity_handle[l]);
+				if (ret == -1) {
+					/* LCOV_EXCL_START */
+					log_tag("parity_error:%u:%s: Sync error\n", blockcur, lev_config_name(l));
+					log_fatal("DANGER! Unexpected sync error in %s disk.\n", lev_name(l));
+					log_fatal("Ensure that disk '%s' is sane.\n", lev_config_name(l));
+					log_fatal("Stopping at block %u\n", blockcur);
+					++error;
+					goto bail;
+					/* LCOV_EXCL_STOP */
+				}
+			}
+
+			/* now we can safely write the content file */
+			profile_begin("autosave");
+			state_write(state);
+			profile_end();
+
+			state_progress_restart(state);
+
+			/* drop until now */
+			state_usage_waste(state);
+		}
+	}
+
+	state_progress_end(state, countpos, countmax, countsize);
+
+	state_usage_print(state);
+
+	/* before returning we ensure that */
+	/* the parity is really written flushing the disk cache */
+	for (l = 0; l < state->level; ++l) {
+		ret = parity_sync(&parity_handle[l]);
+		if (ret == -1) {
+			/* LCOV_EXCL_START */
+			log_tag("parity_error:%u:%s: Sync error\n", blockcur, lev_config_name(l));
+			log_fatal("DANGER! Unexpected sync error in %s disk.\n", lev_name(l));
+			log_fatal("Ensure that disk '%s' is sane.\n", lev_config_name(l));
+			log_fatal("Stopping at block %u\n", blockcur);
+			++error;
+			goto bail;
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	if (error || silent_error || io_error) {
+		msg_status("\n");
+		msg_status("%8u file errors\n", error);
+		msg_status("%8u io errors\n", io_error);
+		msg_status("%8u data errors\n", silent_error);
+	} else {
+		/* print the result only if processed something */
+		if (countpos != 0)
+			msg_status("Everything OK\n");
+	}
+
+	if (error)
+		log_fatal("WARNING! Unexpected file errors!\n");
+	if (io_error)
+		log_fatal("DANGER! Unexpected input/output errors! The failing blocks are now marked as bad!\n");
+	if (silent_error)
+		log_fatal("WARNING! Data changed from the latest sync! The failing blocks are now marked as bad!\n");
+
+	log_tag("summary:error_file:%u\n", error);
+	log_tag("summary:error_io:%u\n", io_error);
+	log_tag("summary:error_data:%u\n", silent_error);
+	if (error + silent_error + io_error == 0)
+		log_tag("summary:exit:ok\n");
+	else
+		log_tag("summary:exit:error\n");
+	log_flush();
+
+bail:
+	/* stop all the worker threads */
+	io_stop(&io);
+
+	if (handle->file != 0) {
+		struct snapraid_file* file = handle->file;
+		ret = handle_close(handle);
+		if (ret == -1) {
+			/* LCOV_EXCL_START */
+			log_tag("error:%u:%s:%s: Close error. %s\n", blockcur, disk->name, esc_tag(file->sub, esc_buffer), strerror(errno));
+			log_fatal("DANGER! Unexpected close error in a data disk.\n");
+			++error;
+			/* continue, as we are already exiting */
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	free(handle);
+	free(waiting_map);
+	io_done(&io);
+
+	if (error + silent_error + io_error != 0)
+		return -1;
+	return 0;
+}
+
+int state_retire(struct snapraid_state* state, tommy_list* filterlist_disk)
+{
+	block_off_t blockmax;
+	int ret;
+	struct snapraid_parity_handle parity_handle[LEV_MAX];
+	struct snapraid_disk* disk;
+	struct snapraid_map* map;
+	unsigned error;
+	unsigned l;
+	tommy_node* i;
+
+	if (tommy_list_empty(filterlist_disk)) {
+		log_fatal("You must select the data disk to retire with -d, --filter-disk.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* search the disk to retire */
+	disk = 0;
+	for (i = state->disklist; i != 0; i = i->next) {
+		struct snapraid_disk* other = i->data;
+
+		if (filter_path(filterlist_disk, 0, other->name, 0) != 0)
+			continue;
+
+		if (disk != 0) {
+			/* LCOV_EXCL_START */
+			log_fatal("You can retire only one disk at time. Both '%s' and '%s' are selected.\n", disk->name, other->name);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+
+		disk = other;
+	}
+	if (disk == 0) {
+		/* LCOV_EXCL_START */
+		log_fatal("No data disk selected to retire.\n");
+		exit(EXIT_FAILURE);
+		/* LCOV_EXCL_STOP */
+	}
+
+	/* search the mapping of the disk */
+	for (i = state->maplist; i != 0; i = i->next) {
+		map = i->data;
+		if (strcmp(disk->name, map->name) == 0)
+			break;
+	}
+	if (i == 0) {
+		/* LCOV_EXCL_START */
+		log_fatal("Internal inconsistency for unmapped disk '%s'\n", disk->name);
+		os_abort();
+		/* LCOV_EXCL_STOP */
+	}
+
+	/* the parity must contain exactly the data of the latest sync */
+	if (parity_is_invalid(state)) {
+		log_fatal("The array is not synced. Run a 'snapraid sync' before retiring a disk.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	msg_progress("Retiring disk %s...\n", disk->name);
+
+	/* remove all the disk content, keeping its blocks as DELETED */
+	retire_disk_content(state, disk);
+
+	/* save the content file before modifying the parity */
+	/* if the process is interrupted without saving the content file again, */
+	/* all the blocks not yet removed from the parity are still DELETED, */
+	/* and a 'sync' is always able to recompute the parity without them */
+	/* note that this also clears the blocks in positions not used by other disks */
+	/* as the parity in such positions doesn't need to be updated */
+	state_write(state);
+
+	blockmax = parity_allocated_size(state);
+
+	/* open the parity for reading and writing */
+	for (l = 0; l < state->level; ++l) {
+		ret = parity_create(&parity_handle[l], &state->parity[l], l, state->parity[l].file_mode, state->block_size, state->opt.parity_limit_size);
+		if (ret == -1) {
+			/* LCOV_EXCL_START */
+			log_fatal("WARNING! Without an accessible %s file, it isn't possible to retire.\n", lev_name(l));
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	error = 0;
+
+	/* skip degenerated cases of empty parity */
+	if (blockmax > 0) {
+		ret = state_retire_process(state, disk, map->position, parity_handle, 0, blockmax);
+		if (ret == -1) {
+			++error;
+			/* continue, as we are already exiting */
+		}
+	}
+
+	for (l = 0; l < state->level; ++l) {
+		ret = parity_close(&parity_handle[l]);
+		if (ret == -1) {
+			/* LCOV_EXCL_START */
+			log_fatal("DANGER! Unexpected close error in %s disk.\n", lev_name(l));
+			++error;
+			/* continue, as we are already exiting */
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	/* if all the disk blocks are removed from the parity, drop its mapping */
+	if (fs_is_empty(disk, blockmax)) {
+		tommy_list_remove_existing(&state->maplist, &map->node);
+		map_free(map);
+
+		/* mark the disk as without mapping */
+		disk->mapping_idx = -1;
+
+		state->need_write = 1;
+
+		msg_status("Disk '%s' retired. You can now remove it from the configuration file.\n", disk->name);
+	} else {
+		log_fatal("WARNING! Disk '%s' is not completely retired.\n", disk->name);
+		log_fatal("To complete it, replace its directory with an empty one, and run 'snapraid sync'.\n");
+		++error;
+	}
+
+	if (error != 0)
+		return -1;
+	return 0;
+}
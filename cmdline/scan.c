@@ -21,10 +21,13 @@
 #include "elem.h"
 #include "state.h"
 #include "parity.h"
+#include "handle.h"
+#include "export.h"
 
 struct snapraid_scan {
 	struct snapraid_state* state; /**< State used. */
 	struct snapraid_disk* disk; /**< Disk used. */
+	struct snapraid_export* exp; /**< Export writer of the differences, or 0 for the human readable output. */
 
 	/**
 	 * Counters of changes.
@@ -36,6 +39,7 @@ struct snapraid_scan {
 	unsigned count_copy; /**< Files new, with same name size and timestamp of a file in a different disk. */
 	unsigned count_insert; /**< Files new. */
 	unsigned count_remove; /**< Files removed. */
+	unsigned count_hash; /**< Files new hashed in the scan. */
 
 	tommy_list file_insert_list; /**< Files to insert. */
 	tommy_list link_insert_list; /**< Links to insert. */
@@ -45,6 +49,26 @@ struct snapraid_scan {
 	tommy_node node;
 };
 
+/**
+ * Report a difference found by the diff command.
+ * \param to_disk Destination disk for "move" and "copy", otherwise 0.
+ */
+static void scan_diff(struct snapraid_scan* scan, const char* op, struct snapraid_disk* disk, const char* sub, struct snapraid_disk* to_disk, const char* to_sub)
+{
+	char esc_buffer[ESC_MAX];
+	char esc_buffer_alt[ESC_MAX];
+
+	if (scan->exp) {
+		export_diff(scan->exp, op, disk, sub, to_disk, to_sub);
+		return;
+	}
+
+	if (to_disk)
+		printf("%s %s -> %s\n", op, fmt_term(disk, sub, esc_buffer), fmt_term(to_disk, to_sub, esc_buffer_alt));
+	else
+		printf("%s %s\n", op, fmt_term(disk, sub, esc_buffer));
+}
+
 /**
  * Remove the specified link from the data set.
  */
@@ -57,7 +81,7 @@ static void scan_link_remove(struct snapraid_scan* scan, struct snapraid_link* s
 	state->need_write = 1;
 
 	/* remove the file from the link containers */
-	tommy_hashdyn_remove_existing(&disk->linkset, &slink->nodeset);
+	tommy_hashlin_remove_existing(&disk->linkset, &slink->nodeset);
 	tommy_list_remove_existing(&disk->linklist, &slink->nodelist);
 
 	/* deallocate */
@@ -76,7 +100,7 @@ static void scan_link_insert(struct snapraid_scan* scan, struct snapraid_link* s
 	state->need_write = 1;
 
 	/* insert the link in the link containers */
-	tommy_hashdyn_insert(&disk->linkset, &slink->nodeset, slink, link_name_hash(slink->sub));
+	tommy_hashlin_insert(&disk->linkset, &slink->nodeset, slink, link_name_hash(slink->sub));
 	tommy_list_insert_tail(&disk->linklist, &slink->nodelist, slink);
 }
 
@@ -91,7 +115,7 @@ static void scan_link(struct snapraid_scan* scan, int is_diff, const char* sub,
 	char esc_buffer[ESC_MAX];
 
 	/* check if the link already exists */
-	slink = tommy_hashdyn_search(&disk->linkset, link_name_compare_to_arg, sub, link_name_hash(sub));
+	slink = tommy_hashlin_search(&disk->linkset, link_name_compare_to_arg, sub, link_name_hash(sub));
 	if (slink) {
 		/* check if multiple files have the same name */
 		if (link_flag_has(slink, FILE_IS_PRESENT)) {
@@ -122,12 +146,12 @@ static void scan_link(struct snapraid_scan* scan, int is_diff, const char* sub,
 
 			log_tag("scan:update:%s:%s\n", disk->name, esc_tag(slink->sub, esc_buffer));
 			if (is_diff) {
-				printf("update %s\n", fmt_term(disk, slink->sub, esc_buffer));
+				scan_diff(scan, "update", disk, slink->sub, 0, 0);
 			}
 
 			/* update it */
-			free(slink->linkto);
-			slink->linkto = strdup_nofail(linkto);
+			free_tag(slink->linkto, strlen(slink->linkto) + 1, MALLOC_PATH);
+			slink->linkto = strdup_nofail_tag(linkto, MALLOC_PATH);
 			link_flag_let(slink, link_flag, FILE_IS_LINK_MASK);
 		}
 
@@ -139,7 +163,7 @@ static void scan_link(struct snapraid_scan* scan, int is_diff, const char* sub,
 
 		log_tag("scan:add:%s:%s\n", disk->name, esc_tag(sub, esc_buffer));
 		if (is_diff) {
-			printf("add %s\n", fmt_term(disk, sub, esc_buffer));
+			scan_diff(scan, "add", disk, sub, 0, 0);
 		}
 
 		/* and continue to insert it */
@@ -248,6 +272,7 @@ static void scan_file_allocate(struct snapraid_scan* scan, struct snapraid_file*
 
 	/* insert in the list of contained files */
 	tommy_list_insert_tail(&disk->filelist, &file->nodelist, file);
+	fs_file_order_reset(disk);
 }
 
 /**
@@ -265,6 +290,7 @@ static void scan_file_deallocate(struct snapraid_scan* scan, struct snapraid_fil
 
 	/* remove from the list of contained files */
 	tommy_list_remove_existing(&disk->filelist, &file->nodelist);
+	fs_file_order_reset(disk);
 
 	/* state changed */
 	state->need_write = 1;
@@ -546,9 +572,9 @@ static void scan_file_insert(struct snapraid_scan* scan, struct snapraid_file* f
 
 	/* insert the file in the containers */
 	if (!file_flag_has(file, FILE_IS_WITHOUT_INODE))
-		tommy_hashdyn_insert(&disk->inodeset, &file->nodeset, file, file_inode_hash(file->inode));
-	tommy_hashdyn_insert(&disk->pathset, &file->pathset, file, file_path_hash(file->sub));
-	tommy_hashdyn_insert(&disk->stampset, &file->stampset, file, file_stamp_hash(file->size, file->mtime_sec, file->mtime_nsec));
+		tommy_hashlin_insert(&disk->inodeset, &file->nodeset, file, file_inode_hash(file->inode));
+	tommy_hashlin_insert(&disk->pathset, &file->pathset, file, file_path_hash(file->sub));
+	tommy_hashlin_insert(&disk->stampset, &file->stampset, file, file_stamp_hash(file->size, file->mtime_sec, file->mtime_nsec));
 
 	/* delayed allocation of the parity */
 	scan_file_delayed_allocate(scan, file);
@@ -565,9 +591,9 @@ static void scan_file_remove(struct snapraid_scan* scan, struct snapraid_file* f
 
 	/* remove the file from the containers */
 	if (!file_flag_has(file, FILE_IS_WITHOUT_INODE))
-		tommy_hashdyn_remove_existing(&disk->inodeset, &file->nodeset);
-	tommy_hashdyn_remove_existing(&disk->pathset, &file->pathset);
-	tommy_hashdyn_remove_existing(&disk->stampset, &file->stampset);
+		tommy_hashlin_remove_existing(&disk->inodeset, &file->nodeset);
+	tommy_hashlin_remove_existing(&disk->pathset, &file->pathset);
+	tommy_hashlin_remove_existing(&disk->stampset, &file->stampset);
 
 	/* deallocate the file from the parity */
 	scan_file_deallocate(scan, file);
@@ -650,7 +676,7 @@ static void scan_file(struct snapraid_scan* scan, int is_diff, const char* sub,
 	/* with the eventual presence of also the past inodes */
 	uint64_t inode = st->st_ino;
 
-	file = tommy_hashdyn_search(&disk->inodeset, file_inode_compare_to_arg, &inode, file_inode_hash(inode));
+	file = tommy_hashlin_search(&disk->inodeset, file_inode_compare_to_arg, &inode, file_inode_hash(inode));
 
 	/* identify moved files with past inodes and hardlinks with the new inodes */
 	if (file) {
@@ -699,17 +725,17 @@ static void scan_file(struct snapraid_scan* scan, int is_diff, const char* sub,
 
 				log_tag("scan:move:%s:%s:%s\n", disk->name, esc_tag(file->sub, esc_buffer), esc_tag(sub, esc_buffer_alt));
 				if (is_diff) {
-					printf("move %s -> %s\n", fmt_term(disk, file->sub, esc_buffer), fmt_term(disk, sub, esc_buffer_alt));
+					scan_diff(scan, "move", disk, file->sub, disk, sub);
 				}
 
 				/* remove from the name set */
-				tommy_hashdyn_remove_existing(&disk->pathset, &file->pathset);
+				tommy_hashlin_remove_existing(&disk->pathset, &file->pathset);
 
 				/* save the new name */
 				file_rename(file, sub);
 
 				/* reinsert in the name set */
-				tommy_hashdyn_insert(&disk->pathset, &file->pathset, file, file_path_hash(file->sub));
+				tommy_hashlin_insert(&disk->pathset, &file->pathset, file, file_path_hash(file->sub));
 
 				/* we have to save the new name */
 				state->need_write = 1;
@@ -748,7 +774,7 @@ static void scan_file(struct snapraid_scan* scan, int is_diff, const char* sub,
 		/* otherwise, it will get removed */
 
 		/* remove from the inode set */
-		tommy_hashdyn_remove_existing(&disk->inodeset, &file->nodeset);
+		tommy_hashlin_remove_existing(&disk->inodeset, &file->nodeset);
 
 		/* clear the inode */
 		/* this is not really needed for correct functionality */
@@ -767,7 +793,7 @@ static void scan_file(struct snapraid_scan* scan, int is_diff, const char* sub,
 	is_original_file_size_different_than_zero = 0;
 
 	/* then try finding it by name */
-	file = tommy_hashdyn_search(&disk->pathset, file_path_compare_to_arg, sub, file_path_hash(sub));
+	file = tommy_hashlin_search(&disk->pathset, file_path_compare_to_arg, sub, file_path_hash(sub));
 
 	/* keep track if the file already exists */
 	is_file_already_present = file != 0;
@@ -779,7 +805,7 @@ static void scan_file(struct snapraid_scan* scan, int is_diff, const char* sub,
 			file->inode = st->st_ino;
 
 			/* insert in the set */
-			tommy_hashdyn_insert(&disk->inodeset, &file->nodeset, file, file_inode_hash(file->inode));
+			tommy_hashlin_insert(&disk->inodeset, &file->nodeset, file, file_inode_hash(file->inode));
 
 			/* unmark as missing inode */
 			file_flag_clear(file, FILE_IS_WITHOUT_INODE);
@@ -836,17 +862,17 @@ static void scan_file(struct snapraid_scan* scan, int is_diff, const char* sub,
 
 				log_tag("scan:restore:%s:%s\n", disk->name, esc_tag(sub, esc_buffer));
 				if (is_diff) {
-					printf("restore %s\n", fmt_term(disk, sub, esc_buffer));
+					scan_diff(scan, "restore", disk, sub, 0, 0);
 				}
 
 				/* remove from the inode set */
-				tommy_hashdyn_remove_existing(&disk->inodeset, &file->nodeset);
+				tommy_hashlin_remove_existing(&disk->inodeset, &file->nodeset);
 
 				/* save the new inode */
 				file->inode = st->st_ino;
 
 				/* reinsert in the inode set */
-				tommy_hashdyn_insert(&disk->inodeset, &file->nodeset, file, file_inode_hash(file->inode));
+				tommy_hashlin_insert(&disk->inodeset, &file->nodeset, file, file_inode_hash(file->inode));
 
 				/* we have to save the new inode */
 				state->need_write = 1;
@@ -937,9 +963,9 @@ static void scan_file(struct snapraid_scan* scan, int is_diff, const char* sub,
 			/* if the nanosecond part of the time stamp is valid, search */
 			/* for name and stamp, otherwise for path and stamp */
 			if (file->mtime_nsec != 0 && file->mtime_nsec != STAT_NSEC_INVALID)
-				other_file = tommy_hashdyn_search(&other_disk->stampset, file_namestamp_compare, file, hash);
+				other_file = tommy_hashlin_search(&other_disk->stampset, file_namestamp_compare, file, hash);
 			else
-				other_file = tommy_hashdyn_search(&other_disk->stampset, file_pathstamp_compare, file, hash);
+				other_file = tommy_hashlin_search(&other_disk->stampset, file_pathstamp_compare, file, hash);
 
 			/* if found, and it's a fully hashed file */
 			if (other_file && file_is_full_hashed_and_stable(scan->state, other_disk, other_file)) {
@@ -951,7 +977,7 @@ static void scan_file(struct snapraid_scan* scan, int is_diff, const char* sub,
 
 				log_tag("scan:copy:%s:%s:%s:%s\n", other_disk->name, esc_tag(other_file->sub, esc_buffer), disk->name, esc_tag(file->sub, esc_buffer_alt));
 				if (is_diff) {
-					printf("copy %s -> %s\n", fmt_term(other_disk, other_file->sub, esc_buffer), fmt_term(disk, file->sub, esc_buffer_alt));
+					scan_diff(scan, "copy", other_disk, other_file->sub, disk, file->sub);
 				}
 
 				/* mark it as reported */
@@ -975,14 +1001,14 @@ static void scan_file(struct snapraid_scan* scan, int is_diff, const char* sub,
 			);
 
 			if (is_diff) {
-				printf("update %s\n", fmt_term(disk, sub, esc_buffer));
+				scan_diff(scan, "update", disk, sub, 0, 0);
 			}
 		} else {
 			++scan->count_insert;
 
 			log_tag("scan:add:%s:%s\n", disk->name, esc_tag(sub, esc_buffer));
 			if (is_diff) {
-				printf("add %s\n", fmt_term(disk, sub, esc_buffer));
+				scan_diff(scan, "add", disk, sub, 0, 0);
 			}
 		}
 	}
@@ -1003,7 +1029,7 @@ static void scan_emptydir_remove(struct snapraid_scan* scan, struct snapraid_dir
 	state->need_write = 1;
 
 	/* remove the file from the dir containers */
-	tommy_hashdyn_remove_existing(&disk->dirset, &dir->nodeset);
+	tommy_hashlin_remove_existing(&disk->dirset, &dir->nodeset);
 	tommy_list_remove_existing(&disk->dirlist, &dir->nodelist);
 
 	/* deallocate */
@@ -1022,7 +1048,7 @@ static void scan_emptydir_insert(struct snapraid_scan* scan, struct snapraid_dir
 	state->need_write = 1;
 
 	/* insert the dir in the dir containers */
-	tommy_hashdyn_insert(&disk->dirset, &dir->nodeset, dir, dir_name_hash(dir->sub));
+	tommy_hashlin_insert(&disk->dirset, &dir->nodeset, dir, dir_name_hash(dir->sub));
 	tommy_list_insert_tail(&disk->dirlist, &dir->nodelist, dir);
 }
 
@@ -1035,7 +1061,7 @@ static void scan_emptydir(struct snapraid_scan* scan, const char* sub)
 	struct snapraid_dir* dir;
 
 	/* check if the dir already exists */
-	dir = tommy_hashdyn_search(&disk->dirset, dir_name_compare, sub, dir_name_hash(sub));
+	dir = tommy_hashlin_search(&disk->dirset, dir_name_compare, sub, dir_name_hash(sub));
 	if (dir) {
 		/* check if multiple files have the same name */
 		if (dir_flag_has(dir, FILE_IS_PRESENT)) {
@@ -1425,6 +1451,197 @@ static int scan_dir(struct snapraid_scan* scan, int level, int is_diff, const ch
 	return processed;
 }
 
+/**
+ * Max number of new files hashed by a single job.
+ */
+#define SCAN_HASH_CHUNK 64
+
+/**
+ * Max number of hashing jobs running at the same time.
+ */
+#define SCAN_HASH_WINDOW 16
+
+/**
+ * Job hashing a chunk of the new files of a disk.
+ */
+struct scan_hash_chunk {
+	struct snapraid_scan* scan; /**< Scan of the disk. */
+	tommy_node* begin; /**< First file. */
+	tommy_node* end; /**< File after the last one, or 0 for the end of the list. */
+	unsigned count; /**< Number of files hashed. */
+	void* buffer; /**< Buffer for reading. */
+	void* buffer_alloc;
+	int running; /**< If the job is in progress. */
+#if HAVE_PTHREAD
+	struct thread_job job; /**< Job in the thread pool. */
+#endif
+};
+
+/**
+ * Check if the file has to be hashed in the scan.
+ * Only new files are selected, as the copies already have the hash.
+ */
+static int scan_hash_is_selected(struct snapraid_state* state, struct snapraid_file* file)
+{
+	return file->size != 0
+	       && file->size <= state->opt.scan_hash
+	       && block_state_get(file_block(file, 0)) == BLOCK_STATE_CHG;
+}
+
+/**
+ * Hash the file, setting its blocks as REP like the sync prehash does.
+ *
+ * Any error is ignored, and the file is left to be processed by sync.
+ * Return 0 if the file is hashed.
+ */
+static int scan_hash_file(struct snapraid_state* state, struct snapraid_disk* disk, struct snapraid_file* file, void* buffer)
+{
+	struct snapraid_handle handle;
+	block_off_t i;
+	int ret;
+
+	handle.disk = disk;
+	handle.file = 0;
+	handle.f = -1;
+
+	ret = handle_open(&handle, file, disk->file_mode, msg_verbose, 0);
+	if (ret == -1)
+		return -1;
+
+	/* if the file is changed after the scan, leave it to the sync */
+	if (handle.st.st_size != file->size
+		|| handle.st.st_mtime != file->mtime_sec
+		|| STAT_NSEC(&handle.st) != file->mtime_nsec
+		|| handle.st.st_ino != file->inode
+	) {
+		handle_close(&handle);
+		return -1;
+	}
+
+	for (i = 0; i < file->blockmax; ++i) {
+		struct snapraid_block* block = file_block(file, i);
+		int read_size;
+
+		read_size = handle_read(&handle, i, buffer, state->block_size, msg_verbose, 0);
+		if (read_size == -1) {
+			handle_close(&handle);
+			return -1;
+		}
+
+		/* the hash is of the new data, and the parity is not yet updated */
+		memhash(state->hash, state->hashseed, block->hash, buffer, read_size);
+		block_state_set(block, BLOCK_STATE_REP);
+	}
+
+	if (handle_close(&handle) != 0)
+		return -1;
+
+	return 0;
+}
+
+static void* scan_hash_chunk_process(void* arg)
+{
+	struct scan_hash_chunk* chunk = arg;
+	struct snapraid_scan* scan = chunk->scan;
+	tommy_node* j;
+
+	for (j = chunk->begin; j != chunk->end; j = j->next) {
+		struct snapraid_file* file = j->data;
+
+		if (!scan_hash_is_selected(scan->state, file))
+			continue;
+
+		if (scan_hash_file(scan->state, scan->disk, file, chunk->buffer) == 0)
+			++chunk->count;
+	}
+
+	return 0;
+}
+
+/**
+ * Wait for the job and collect its result.
+ */
+static void scan_hash_chunk_wait(struct scan_hash_chunk* chunk)
+{
+#if HAVE_PTHREAD
+	void* retval;
+#endif
+
+	if (!chunk->running)
+		return;
+
+#if HAVE_PTHREAD
+	thread_pool_join(&chunk->job, &retval);
+#endif
+
+	chunk->scan->count_hash += chunk->count;
+
+	chunk->running = 0;
+}
+
+/**
+ * Hash the small new files of the disk, as the sync prehash would do.
+ *
+ * The files are just opened by the scan and likely small, so they are
+ * read by parallel jobs while still in cache, saving the prehash pass.
+ * All the jobs are completed before returning, because the files
+ * are later accessed when scanning the other disks.
+ */
+static void scan_hash(struct snapraid_scan* scan)
+{
+	struct snapraid_state* state = scan->state;
+	struct scan_hash_chunk* chunk_map;
+	unsigned chunk_next;
+	tommy_node* j;
+	unsigned l;
+
+	chunk_map = malloc_nofail(SCAN_HASH_WINDOW * sizeof(struct scan_hash_chunk));
+	for (l = 0; l < SCAN_HASH_WINDOW; ++l) {
+		chunk_map[l].scan = scan;
+		chunk_map[l].buffer = malloc_nofail_direct(state->block_size, &chunk_map[l].buffer_alloc);
+		chunk_map[l].running = 0;
+	}
+	chunk_next = 0;
+
+	j = scan->file_insert_list;
+	while (j != 0) {
+		struct scan_hash_chunk* chunk = &chunk_map[chunk_next];
+		unsigned selected;
+
+		chunk_next = (chunk_next + 1) % SCAN_HASH_WINDOW;
+
+		/* wait the oldest job to reuse its slot */
+		scan_hash_chunk_wait(chunk);
+
+		chunk->begin = j;
+		chunk->count = 0;
+		selected = 0;
+		while (j != 0 && selected < SCAN_HASH_CHUNK) {
+			if (scan_hash_is_selected(state, j->data))
+				++selected;
+			j = j->next;
+		}
+		chunk->end = j;
+
+		if (selected == 0)
+			continue;
+
+		chunk->running = 1;
+#if HAVE_PTHREAD
+		thread_pool_run(&chunk->job, 1, scan_hash_chunk_process, chunk);
+#else
+		scan_hash_chunk_process(chunk);
+#endif
+	}
+
+	for (l = 0; l < SCAN_HASH_WINDOW; ++l) {
+		scan_hash_chunk_wait(&chunk_map[l]);
+		free(chunk_map[l].buffer_alloc);
+	}
+
+	free(chunk_map);
+}
+
 static int state_diffscan(struct snapraid_state* state, int is_diff)
 {
 	tommy_node* i;
@@ -1435,9 +1652,17 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 	struct snapraid_scan total;
 	int no_difference;
 	char esc_buffer[ESC_MAX];
+	struct snapraid_export exp;
+	int is_export;
 
 	tommy_list_init(&scanlist);
 
+	is_export = is_diff && state->opt.export_format != EXPORT_NONE;
+	if (is_export) {
+		export_init(&exp, state->opt.export_format, stdout);
+		export_diff_header(&exp);
+	}
+
 	if (is_diff)
 		msg_progress("Comparing...\n");
 
@@ -1452,6 +1677,7 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 		scan = malloc_nofail(sizeof(struct snapraid_scan));
 		scan->state = state;
 		scan->disk = disk;
+		scan->exp = is_export ? &exp : 0;
 		scan->count_equal = 0;
 		scan->count_move = 0;
 		scan->count_copy = 0;
@@ -1459,12 +1685,19 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 		scan->count_change = 0;
 		scan->count_remove = 0;
 		scan->count_insert = 0;
+		scan->count_hash = 0;
 		tommy_list_init(&scan->file_insert_list);
 		tommy_list_init(&scan->link_insert_list);
 		tommy_list_init(&scan->dir_insert_list);
 
 		tommy_list_insert_tail(&scanlist, &scan->node, scan);
 
+		/* keep the stored state of the disks not selected */
+		if (disk->skip_scan) {
+			msg_verbose("Skipping disk %s...\n", disk->name);
+			continue;
+		}
+
 		if (!is_diff)
 			msg_progress("Scanning disk %s...\n", disk->name);
 
@@ -1493,7 +1726,7 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 				node = node->next;
 
 				/* remove from the inode set */
-				tommy_hashdyn_remove_existing(&disk->inodeset, &file->nodeset);
+				tommy_hashlin_remove_existing(&disk->inodeset, &file->nodeset);
 
 				/* clear the inode */
 				file->inode = 0;
@@ -1504,6 +1737,10 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 		}
 
 		scan_dir(scan, 0, is_diff, disk->dir, "");
+
+		/* hash the small new files, while still in cache */
+		if (!is_diff && state->opt.scan_hash != 0)
+			scan_hash(scan);
 	}
 
 	/* we split the search in two phases because to detect files */
@@ -1520,6 +1757,10 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 		uint64_t phy_last;
 		struct snapraid_file* phy_file_last;
 
+		/* nothing was scanned, so nothing is removed or inserted */
+		if (disk->skip_scan)
+			continue;
+
 		/* check for removed files */
 		node = disk->filelist;
 		while (node) {
@@ -1534,7 +1775,7 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 
 				log_tag("scan:remove:%s:%s\n", disk->name, esc_tag(file->sub, esc_buffer));
 				if (is_diff) {
-					printf("remove %s\n", fmt_term(disk, file->sub, esc_buffer));
+					scan_diff(scan, "remove", disk, file->sub, 0, 0);
 				}
 
 				scan_file_remove(scan, file);
@@ -1555,7 +1796,7 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 
 				log_tag("scan:remove:%s:%s\n", disk->name, esc_tag(slink->sub, esc_buffer));
 				if (is_diff) {
-					printf("remove %s\n", fmt_term(disk, slink->sub, esc_buffer));
+					scan_diff(scan, "remove", disk, slink->sub, 0, 0);
 				}
 
 				scan_link_remove(scan, slink);
@@ -1790,6 +2031,9 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 #endif
 	}
 
+	if (is_export)
+		export_done(&exp);
+
 	total.count_equal = 0;
 	total.count_move = 0;
 	total.count_copy = 0;
@@ -1797,6 +2041,7 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 	total.count_change = 0;
 	total.count_remove = 0;
 	total.count_insert = 0;
+	total.count_hash = 0;
 
 	for (i = scanlist; i != 0; i = i->next) {
 		struct snapraid_scan* scan = i->data;
@@ -1807,6 +2052,7 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 		total.count_change += scan->count_change;
 		total.count_remove += scan->count_remove;
 		total.count_insert += scan->count_insert;
+		total.count_hash += scan->count_hash;
 	}
 
 	if (is_diff) {
@@ -1823,6 +2069,8 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 	msg("%8u moved\n", total.count_move);
 	msg("%8u copied\n", total.count_copy);
 	msg("%8u restored\n", total.count_restore);
+	if (state->opt.scan_hash != 0)
+		msg("%8u hashed\n", total.count_hash);
 
 	log_tag("summary:equal:%u\n", total.count_equal);
 	log_tag("summary:added:%u\n", total.count_insert);
@@ -1870,11 +2118,50 @@ static int state_diffscan(struct snapraid_state* state, int is_diff)
 
 int state_diff(struct snapraid_state* state)
 {
-	return state_diffscan(state, 1);
+	int ret;
+
+	profile_begin("diff");
+	ret = state_diffscan(state, 1);
+	profile_end();
+
+	return ret;
 }
 
-void state_scan(struct snapraid_state* state)
+void state_scan(struct snapraid_state* state, tommy_list* filterlist_disk)
 {
+	tommy_node* i;
+	tommy_node* j;
+
+	/* ensure that the filters select only data disks */
+	for (i = tommy_list_head(filterlist_disk); i != 0; i = i->next) {
+		struct snapraid_filter* filter = i->data;
+
+		for (j = state->disklist; j != 0; j = j->next) {
+			struct snapraid_disk* disk = j->data;
+			if (fnmatch(filter->pattern, disk->name, FNM_CASEINSENSITIVE_FOR_WIN) == 0)
+				break;
+		}
+		if (j == 0) {
+			/* LCOV_EXCL_START */
+			log_fatal("Option -d, --filter-disk %s doesn't match any data disk.\n", filter->pattern);
+			log_fatal("With '%s' you can select only data disks.\n", state->command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	/* mark the disks to skip */
+	if (!tommy_list_empty(filterlist_disk)) {
+		for (i = state->disklist; i != 0; i = i->next) {
+			struct snapraid_disk* disk = i->data;
+
+			if (filter_path(filterlist_disk, 0, disk->name, 0) != 0)
+				disk->skip_scan = 1;
+		}
+	}
+
+	profile_begin("scan");
 	(void)state_diffscan(state, 0); /* ignore return value */
+	profile_end();
 }
 
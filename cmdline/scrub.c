@@ -45,8 +45,38 @@ struct snapraid_plan {
 	time_t timelimit; /**< Time limit. Valid only with SCRUB_AUTO. */
 	block_off_t lastlimit; /**< Number of blocks allowed with time exactly at ::timelimit. */
 	block_off_t countlast; /**< Counter of blocks with time exactly at ::timelimit. */
+	int risk; /**< If the block time is weighted by the risk of the disks. */
+	time_t now; /**< Present time, used to weight the block time. */
 };
 
+/**
+ * Get the time of the block used to select the oldest ones.
+ *
+ * With the risk weighting, the age of the block is multiplied
+ * by the highest risk of the disks using it, making the blocks
+ * of risky disks to look older, and to be scrubbed before.
+ */
+static time_t block_plan_time(struct snapraid_plan* plan, block_off_t i, snapraid_info info)
+{
+	struct snapraid_state* state = plan->state;
+	time_t blocktime = info_get_time(info);
+	double risk;
+	tommy_node* j;
+
+	if (!plan->risk || blocktime >= plan->now)
+		return blocktime;
+
+	risk = 1;
+	for (j = state->disklist; j != 0; j = j->next) {
+		struct snapraid_disk* disk = j->data;
+
+		if (disk->risk > risk && block_has_file(fs_par2block_find(disk, i)))
+			risk = disk->risk;
+	}
+
+	return plan->now - (time_t)((plan->now - blocktime) * risk);
+}
+
 /**
  * Check if we have to process the specified block index ::i.
  */
@@ -81,7 +111,7 @@ static int block_is_enabled(void* void_plan, block_off_t i)
 	}
 
 	/* if it's too new */
-	blocktime = info_get_time(info);
+	blocktime = block_plan_time(plan, i, info);
 	if (blocktime > plan->timelimit) {
 		/* skip it */
 		return 0;
@@ -113,6 +143,10 @@ static void scrub_data_reader(struct snapraid_worker* worker, struct snapraid_ta
 	int ret;
 	char esc_buffer[ESC_MAX];
 
+	/* simulate a slow first disk */
+	if (state->opt.io_slow != 0 && worker == &io->reader_map[0])
+		usleep(state->opt.io_slow * 1000);
+
 	/* if the disk position is not used */
 	if (!disk) {
 		/* use an empty block */
@@ -163,7 +197,7 @@ static void scrub_data_reader(struct snapraid_worker* worker, struct snapraid_ta
 		}
 	}
 
-	ret = handle_open(handle, task->file, state->file_mode, log_error, 0);
+	ret = handle_open(handle, task->file, handle->disk->file_mode, log_error, 0);
 	if (ret == -1) {
 		if (errno == EIO) {
 			/* LCOV_EXCL_START */
@@ -226,6 +260,12 @@ static void scrub_parity_reader(struct snapraid_worker* worker, struct snapraid_
 	unsigned char* buffer = task->buffer;
 	int ret;
 
+	/* skip the parity not verified in this cycle */
+	if (!info_has_parity(info_get(&state->infoarr, blockcur), blockcur, level, state->opt.parity_cycle)) {
+		task->state = TASK_STATE_EMPTY;
+		return;
+	}
+
 	/* read the parity */
 	ret = parity_read(parity_handle, blockcur, buffer, state->block_size, log_error);
 	if (ret == -1) {
@@ -244,6 +284,43 @@ static void scrub_parity_reader(struct snapraid_worker* worker, struct snapraid_
 	task->state = TASK_STATE_DONE;
 }
 
+/**
+ * Read again a data block abandoned by a hedged read.
+ *
+ * The handle of the disk is still in use by the slow reader,
+ * so the block is read with a private one.
+ */
+static void scrub_hedge_read(struct snapraid_io* io, struct snapraid_disk* disk, struct snapraid_task* task, block_off_t blockcur, unsigned char* buffer)
+{
+	struct snapraid_worker worker;
+	struct snapraid_handle handle;
+
+	handle.disk = disk;
+	handle.file = 0;
+	handle.f = -1;
+	handle.valid_size = 0;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.io = io;
+	worker.handle = &handle;
+
+	task->state = TASK_STATE_READY;
+	task->path[0] = 0;
+	task->disk = disk;
+	task->buffer = buffer;
+	task->position = blockcur;
+	task->block = 0;
+	task->file = 0;
+	task->file_pos = 0;
+	task->read_size = 0;
+	task->is_timestamp_different = 0;
+
+	scrub_data_reader(&worker, task);
+
+	/* the file is only read, and a close error is not relevant */
+	handle_close(&handle);
+}
+
 static int state_scrub_process(struct snapraid_state* state, struct snapraid_parity_handle* parity_handle, block_off_t blockstart, block_off_t blockmax, struct snapraid_plan* plan, time_t now)
 {
 	struct snapraid_io io;
@@ -267,6 +344,14 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 	unsigned l;
 	unsigned* waiting_map;
 	unsigned waiting_mac;
+	void** buffer_verify;
+	void** buffer_data;
+	void* buffer_hedge_alloc;
+	unsigned char* buffer_hedge;
+	unsigned* hedge_count;
+	int* zero_map;
+	void* zero_alloc;
+	void* zero;
 	char esc_buffer[ESC_MAX];
 
 	/* maps the disks to handles */
@@ -275,12 +360,33 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 	/* rehash buffers */
 	rehandle = malloc_nofail_align(diskmax * sizeof(struct snapraid_rehash), &rehandle_alloc);
 
+	/* vector of data and read parity to verify */
+	buffer_verify = malloc_nofail((diskmax + state->level) * sizeof(void*));
+
+	/* vector of data and computed parity, with the hedged read replaced */
+	buffer_data = malloc_nofail((diskmax + state->level) * sizeof(void*));
+
+	/* buffer for the data recovered in place of a hedged read */
+	buffer_hedge = malloc_nofail_align(state->block_size, &buffer_hedge_alloc);
+
+	/* number of hedged reads for each disk */
+	hedge_count = calloc_nofail(diskmax, sizeof(unsigned));
+	zero_map = malloc_nofail(diskmax * sizeof(int));
+
+	/* allocate and fill the zero buffer, used to recover with any parity level */
+	zero = malloc_nofail_align(state->block_size, &zero_alloc);
+	memset(zero, 0, state->block_size);
+	raid_zero(zero);
+
 	/* we need 1 * data + 2 * parity */
 	buffermax = diskmax + 2 * state->level;
 
 	/* initialize the io threads */
 	io_init(&io, state, state->opt.io_cache, buffermax, scrub_data_reader, handle, diskmax, scrub_parity_reader, 0, parity_handle, state->level);
 
+	/* don't wait for a slow data read if it can be recovered from parity */
+	io.hedge_wait = state->opt.hedge_wait;
+
 	/* possibly waiting disks */
 	waiting_mac = diskmax > RAID_PARITY_MAX ? diskmax : RAID_PARITY_MAX;
 	waiting_map = malloc_nofail(waiting_mac * sizeof(unsigned));
@@ -290,6 +396,7 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 	io_error = 0;
 
 	/* first count the number of blocks to process */
+	profile_begin("plan");
 	countmax = 0;
 	plan->countlast = 0;
 	for (blockcur = blockstart; blockcur < blockmax; ++blockcur) {
@@ -297,6 +404,7 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 			continue;
 		++countmax;
 	}
+	profile_end();
 
 	/* compute the autosave size for all disk, even if not read */
 	/* this makes sense because the speed should be almost the same */
@@ -312,6 +420,9 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 	countpos = 0;
 	plan->countlast = 0;
 
+	/* allocate all the info in advance, as the parity readers get it concurrently */
+	tommy_arrayblkof_grow(&state->infoarr, blockmax);
+
 	/* start all the worker threads */
 	io_start(&io, blockstart, blockmax, &block_is_enabled, plan);
 
@@ -324,6 +435,7 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 		int io_error_on_this_block;
 		int block_is_unsynced;
 		int rehash;
+		unsigned hedge;
 		void** buffer;
 
 		/* go to the next block */
@@ -353,6 +465,9 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 		/* if we have to use the old hash */
 		rehash = info_get_rehash(info);
 
+		/* no data read abandoned */
+		hedge = diskmax;
+
 		/* for each disk, process the block */
 		for (j = 0; j < diskmax; ++j) {
 			struct snapraid_task* task;
@@ -378,6 +493,16 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 			/* until now is disk */
 			state_usage_disk(state, handle, waiting_map, waiting_mac);
 
+			/* by default the block is not known to be zero */
+			zero_map[diskcur] = 0;
+
+			/* if the read is too slow, recover it later from the parity */
+			if (!task) {
+				rehandle[diskcur].block = 0;
+				hedge = diskcur;
+				continue;
+			}
+
 			/* get the task results */
 			disk = task->disk;
 			block = task->block;
@@ -389,8 +514,11 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 			rehandle[diskcur].block = 0;
 
 			/* if the disk position is not used */
-			if (!disk)
+			if (!disk) {
+				/* the reader used an empty block */
+				zero_map[diskcur] = 1;
 				continue;
+			}
 
 			/* if the block is unsynced, errors are expected */
 			if (block_has_invalid_parity(block)) {
@@ -401,8 +529,11 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 			}
 
 			/* if the block is not used */
-			if (!block_has_file(block))
+			if (!block_has_file(block)) {
+				/* the reader used an empty block */
+				zero_map[diskcur] = 1;
 				continue;
+			}
 
 			/* if the block is unsynced, errors are expected */
 			if (task->is_timestamp_different) {
@@ -454,15 +585,18 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 
 			countsize += read_size;
 
+			/* zero blocks have a precomputed hash, and they are skipped in the parity */
+			zero_map[diskcur] = memiszero(buffer[diskcur], read_size);
+
 			/* now compute the hash */
 			if (rehash) {
-				memhash(state->prevhash, state->prevhashseed, hash, buffer[diskcur], read_size);
+				memhash_zero(&state->zerohash, state->prevhash, state->prevhashseed, hash, buffer[diskcur], read_size, zero_map[diskcur]);
 
 				/* compute the new hash, and store it */
 				rehandle[diskcur].block = block;
-				memhash(state->hash, state->hashseed, rehandle[diskcur].hash, buffer[diskcur], read_size);
+				memhash_zero(&state->zerohash, state->hash, state->hashseed, rehandle[diskcur].hash, buffer[diskcur], read_size, zero_map[diskcur]);
 			} else {
-				memhash(state->hash, state->hashseed, hash, buffer[diskcur], read_size);
+				memhash_zero(&state->zerohash, state->hash, state->hashseed, hash, buffer[diskcur], read_size, zero_map[diskcur]);
 			}
 
 			/* until now is hash */
@@ -508,6 +642,12 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 			/* until now is parity */
 			state_usage_parity(state, waiting_map, waiting_mac);
 
+			/* if the parity is not verified in this cycle */
+			if (task->state == TASK_STATE_EMPTY) {
+				buffer_recov[levcur] = 0;
+				continue;
+			}
+
 			/* handle error conditions */
 			if (task->state == TASK_STATE_IOERROR) {
 				/* LCOV_EXCL_START */
@@ -555,16 +695,223 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 			}
 		}
 
+		/* setup the data and the computed parity */
+		for (j = 0; j < diskmax + state->level; ++j)
+			buffer_data[j] = buffer[j];
+
+		/* the buffer of a hedged read is still in use by its reader */
+		if (hedge != diskmax)
+			buffer_data[hedge] = buffer_hedge;
+
+		/* setup the data and the read parity */
+		for (j = 0; j < diskmax; ++j)
+			buffer_verify[j] = buffer_data[j];
+		for (l = 0; l < state->level; ++l) {
+			/* if the parity is missing, use the scratch buffer, its result is masked out */
+			if (buffer_recov[l])
+				buffer_verify[diskmax + l] = buffer_recov[l];
+			else
+				buffer_verify[diskmax + l] = buffer_data[diskmax + l];
+		}
+
+		/* if a data read was abandoned, recover it from the parity */
+		if (hedge != diskmax && !error_on_this_block && !silent_error_on_this_block && !io_error_on_this_block) {
+			struct snapraid_disk* disk = handle[hedge].disk;
+			struct snapraid_block* block = BLOCK_NULL;
+			int hedge_recovered;
+
+			if (disk)
+				block = fs_par2block_find(disk, blockcur);
+
+			if (block_has_invalid_parity(block)) {
+				/* the parity cannot be used to recover it */
+				block_is_unsynced = 1;
+			}
+
+			hedge_recovered = 0;
+			if (!block_has_file(block)) {
+				/* use an empty block */
+				memset(buffer_hedge, 0, state->block_size);
+				hedge_recovered = 1;
+			} else if (block_is_unsynced || !block_has_updated_hash(block)) {
+				/* without a synced hash we cannot verify the recovered data */
+				log_tag("hedge:%u:%s: Slow read not recoverable\n", blockcur, disk->name);
+			} else {
+				struct snapraid_file* file;
+				block_off_t file_pos;
+				unsigned char hash[HASH_MAX];
+				int read_size;
+				int id[1];
+				int ip[1];
+
+				file = fs_par2file_get(disk, blockcur, &file_pos);
+				read_size = file_block_size(file, file_pos, state->block_size);
+
+				/* use the first parity available */
+				for (l = 0; l < state->level; ++l)
+					if (buffer_recov[l])
+						break;
+
+				if (l == state->level) {
+					log_tag("hedge:%u:%s: Slow read not recoverable\n", blockcur, disk->name);
+				} else {
+					id[0] = hedge;
+					ip[0] = l;
+					raid_data(1, id, ip, diskmax, state->block_size, buffer_verify);
+
+					/* check the recovered data with the hash, exactly like a read one */
+					if (rehash) {
+						memhash(state->prevhash, state->prevhashseed, hash, buffer_hedge, read_size);
+
+						/* compute the new hash, and store it */
+						rehandle[hedge].block = block;
+						memhash(state->hash, state->hashseed, rehandle[hedge].hash, buffer_hedge, read_size);
+					} else {
+						memhash(state->hash, state->hashseed, hash, buffer_hedge, read_size);
+					}
+
+					if (memcmp(hash, block->hash, BLOCK_HASH_SIZE) != 0) {
+						/* the data or the parity is wrong, and a real read is required to know it */
+						log_tag("hedge:%u:%s:%s: Slow read recovered with a wrong hash at position %u\n", blockcur, disk->name, esc_tag(file->sub, esc_buffer), file_pos);
+						rehandle[hedge].block = 0;
+					} else {
+						log_tag("hedge:%u:%s:%s: Slow read recovered from %s at position %u\n", blockcur, disk->name, esc_tag(file->sub, esc_buffer), lev_config_name(l), file_pos);
+						countsize += read_size;
+
+						/* pad with 0 like a real read, as the hash doesn't cover the padding */
+						/* and the parity check has to blame the parity used to recover it */
+						memset(buffer_hedge + read_size, 0, state->block_size - read_size);
+						hedge_recovered = 1;
+					}
+				}
+			}
+
+			if (hedge_recovered) {
+				++hedge_count[hedge];
+			} else {
+				struct snapraid_task task;
+				unsigned char hash[HASH_MAX];
+				int file_is_unsynced;
+
+				/* read it again, waiting for the slow disk this time */
+				scrub_hedge_read(&io, disk, &task, blockcur, buffer_hedge);
+
+				file_is_unsynced = block_has_invalid_parity(task.block) || task.is_timestamp_different;
+
+				/* handle error conditions, like a normal read */
+				if (task.state == TASK_STATE_IOERROR) {
+					/* LCOV_EXCL_START */
+					++io_error;
+					goto bail;
+					/* LCOV_EXCL_STOP */
+				}
+				if (task.state == TASK_STATE_ERROR) {
+					/* LCOV_EXCL_START */
+					++error;
+					goto bail;
+					/* LCOV_EXCL_STOP */
+				}
+				if (task.state == TASK_STATE_ERROR_CONTINUE) {
+					++error;
+					error_on_this_block = 1;
+				} else if (task.state == TASK_STATE_IOERROR_CONTINUE) {
+					++io_error;
+					if (io_error >= state->opt.io_error_limit) {
+						/* LCOV_EXCL_START */
+						log_fatal("DANGER! Too many input/output read error in a data disk, it isn't possible to scrub.\n");
+						log_fatal("Ensure that disk '%s' is sane and that file '%s' can be accessed.\n", disk->dir, task.path);
+						log_fatal("Stopping at block %u\n", blockcur);
+						goto bail;
+						/* LCOV_EXCL_STOP */
+					}
+					io_error_on_this_block = 1;
+				} else if (task.state != TASK_STATE_DONE) {
+					/* LCOV_EXCL_START */
+					log_fatal("Internal inconsistency in task state\n");
+					os_abort();
+					/* LCOV_EXCL_STOP */
+				} else if (block_has_file(task.block)) {
+					countsize += task.read_size;
+
+					zero_map[hedge] = memiszero(buffer_hedge, task.read_size);
+
+					if (rehash) {
+						memhash_zero(&state->zerohash, state->prevhash, state->prevhashseed, hash, buffer_hedge, task.read_size, zero_map[hedge]);
+
+						/* compute the new hash, and store it */
+						rehandle[hedge].block = task.block;
+						memhash_zero(&state->zerohash, state->hash, state->hashseed, rehandle[hedge].hash, buffer_hedge, task.read_size, zero_map[hedge]);
+					} else {
+						memhash_zero(&state->zerohash, state->hash, state->hashseed, hash, buffer_hedge, task.read_size, zero_map[hedge]);
+					}
+
+					if (block_has_updated_hash(task.block) && memcmp(hash, task.block->hash, BLOCK_HASH_SIZE) != 0) {
+						unsigned diff = memdiff(hash, task.block->hash, BLOCK_HASH_SIZE);
+
+						log_tag("error:%u:%s:%s: Data error at position %u, diff bits %u/%u\n", blockcur, disk->name, esc_tag(task.file->sub, esc_buffer), task.file_pos, diff, BLOCK_HASH_SIZE*8);
+
+						/* it's a silent error only if we are dealing with synced files */
+						if (file_is_unsynced) {
+							++error;
+							error_on_this_block = 1;
+						} else {
+							log_error("Data error in file '%s' at position '%u', diff bits %u/%u\n", task.path, task.file_pos, diff, BLOCK_HASH_SIZE*8);
+							++silent_error;
+							silent_error_on_this_block = 1;
+						}
+					}
+				}
+
+				if (file_is_unsynced)
+					block_is_unsynced = 1;
+			}
+
+			/* until now is raid */
+			state_usage_raid(state);
+		}
+
 		/* if we have read all the data required and it's correct, proceed with the parity check */
 		if (!error_on_this_block && !silent_error_on_this_block && !io_error_on_this_block) {
+			int verify_mask;
+
+			if (state->opt.parity_cycle > 1) {
+				/* with only some parity read, compute all of it and compare the read one */
+				raid_gen_zero(diskmax, state->level, state->block_size, buffer_data, zero_map);
+
+				verify_mask = 0;
+				for (l = 0; l < state->level; ++l) {
+					if (buffer_recov[l] && memcmp(buffer_data[diskmax + l], buffer_recov[l], state->block_size) != 0)
+						verify_mask |= 1 << l;
+				}
+			} else {
+				int verify_level;
+				int present_mask;
+
+				/* the missing parity levels are not verified */
+				verify_level = 0;
+				present_mask = 0;
+				for (l = 0; l < state->level; ++l) {
+					if (buffer_recov[l]) {
+						verify_level = l + 1;
+						present_mask |= 1 << l;
+					}
+				}
 
-			/* compute the parity */
-			raid_gen(diskmax, state->level, state->block_size, buffer);
+				/* verify the parity without storing the computed one */
+				/* the missing levels below the last present one use the scratch buffer, and are masked out */
+				verify_mask = 0;
+				if (verify_level != 0)
+					verify_mask = raid_verify(diskmax, verify_level, state->block_size, buffer_verify) & present_mask;
+
+				/* compute the parity only to report the differences */
+				if (verify_mask != 0)
+					raid_gen_zero(diskmax, state->level, state->block_size, buffer_data, zero_map);
+			}
 
 			/* compare the parity */
 			for (l = 0; l < state->level; ++l) {
-				if (buffer_recov[l] && memcmp(buffer[diskmax + l], buffer_recov[l], state->block_size) != 0) {
-					unsigned diff = memdiff(buffer[diskmax + l], buffer_recov[l], state->block_size);
+				if (buffer_recov[l] && (verify_mask & (1 << l)) != 0) {
+					unsigned diff = memdiff(buffer_data[diskmax + l], buffer_recov[l], state->block_size);
 
 					log_tag("parity_error:%u:%s: Data error, diff bits %u/%u\n", blockcur, lev_config_name(l), diff, state->block_size*8);
 
@@ -600,9 +947,9 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 				}
 			}
 
-			/* update the time info of the block */
+			/* update the time info of the block, advancing the parity cycle */
 			/* and clear any other flag */
-			info_set(&state->infoarr, blockcur, info_make(now, 0, 0, 0));
+			info_set(&state->infoarr, blockcur, info_set_cycle(info_make(now, 0, 0, 0), info_next_cycle(info, state->opt.parity_cycle)));
 		}
 
 		/* mark the state as needing write */
@@ -631,7 +978,9 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 			state_progress_stop(state);
 
 			msg_progress("Autosaving...\n");
+			profile_begin("autosave");
 			state_write(state);
+			profile_end();
 
 			state_progress_restart(state);
 
@@ -644,6 +993,15 @@ static int state_scrub_process(struct snapraid_state* state, struct snapraid_par
 
 	state_usage_print(state);
 
+	/* report the disks with slow reads */
+	for (j = 0; j < diskmax; ++j) {
+		if (hedge_count[j] != 0 && handle[j].disk) {
+			handle[j].disk->io_retry += hedge_count[j];
+			msg_progress("%8u slow reads in disk '%s' recovered from parity\n", hedge_count[j], handle[j].disk->name);
+			log_tag("summary:hedge:%s:%u\n", handle[j].disk->name, hedge_count[j]);
+		}
+	}
+
 	if (error || silent_error || io_error) {
 		msg_status("\n");
 		msg_status("%8u file errors\n", error);
@@ -695,6 +1053,12 @@ bail:
 
 	free(handle);
 	free(rehandle_alloc);
+	free(buffer_verify);
+	free(buffer_data);
+	free(buffer_hedge_alloc);
+	free(hedge_count);
+	free(zero_map);
+	free(zero_alloc);
 	free(waiting_map);
 	io_done(&io);
 
@@ -752,11 +1116,31 @@ int state_scrub(struct snapraid_state* state, int plan, int olderthan)
 
 	blockmax = parity_allocated_size(state);
 
+	/* a cycle longer than the levels would leave positions without any parity verified */
+	if (state->opt.parity_cycle > state->level) {
+		log_fatal("WARNING! The parity cycle of %u scrubs is reduced to %u, the number of parity levels.\n", state->opt.parity_cycle, state->level);
+		state->opt.parity_cycle = state->level;
+	}
+	if (state->opt.parity_cycle > 1) {
+		msg_progress("Verifying the parity in a cycle of %u scrubs...\n", state->opt.parity_cycle);
+		log_tag("parity_cycle:%u\n", state->opt.parity_cycle);
+	}
+
 	/* preinitialize to avoid warnings */
 	countlimit = 0;
 	recentlimit = 0;
 
 	ps.state = state;
+	ps.risk = 0;
+	ps.now = now;
+	if (state->opt.risk) {
+		tommy_node* j;
+		for (j = state->disklist; j != 0; j = j->next) {
+			struct snapraid_disk* disk = j->data;
+			if (disk->risk > 1)
+				ps.risk = 1;
+		}
+	}
 	if (state->opt.force_scrub_even) {
 		ps.plan = SCRUB_EVEN;
 	} else if (plan == SCRUB_FULL) {
@@ -790,7 +1174,7 @@ int state_scrub(struct snapraid_state* state, int plan, int olderthan)
 	/* identify the time limit */
 	/* we sort all the block times, and we identify the time limit for which we reach the quota */
 	/* this allow to process first the oldest blocks */
-	timemap = malloc_nofail(blockmax * sizeof(time_t));
+	timemap = malloc_nofail_tag(blockmax * sizeof(time_t), MALLOC_MISC);
 
 	/* copy the info in the temp vector */
 	count = 0;
@@ -802,7 +1186,7 @@ int state_scrub(struct snapraid_state* state, int plan, int olderthan)
 		if (info == 0)
 			continue;
 
-		timemap[count++] = info_get_time(info);
+		timemap[count++] = block_plan_time(&ps, i, info);
 	}
 
 	if (!count) {
@@ -858,11 +1242,18 @@ int state_scrub(struct snapraid_state* state, int plan, int olderthan)
 	}
 
 	/* free the temp vector */
-	free(timemap);
+	free_tag(timemap, blockmax * sizeof(time_t), MALLOC_MISC);
+
+	/* only estimate, without reading anything */
+	if (state->opt.estimate) {
+		ps.countlast = 0;
+		state_estimate(state, "scrub", 0, blockmax, block_is_enabled, &ps);
+		return 0;
+	}
 
 	/* open the file for reading */
 	for (l = 0; l < state->level; ++l) {
-		ret = parity_open(&parity_handle[l], &state->parity[l], l, state->file_mode, state->block_size, state->opt.parity_limit_size);
+		ret = parity_open(&parity_handle[l], &state->parity[l], l, state->parity[l].file_mode, state->block_size, state->opt.parity_limit_size);
 		if (ret == -1) {
 			/* LCOV_EXCL_START */
 			log_fatal("WARNING! Without an accessible %s file, it isn't possible to scrub.\n", lev_name(l));
@@ -875,7 +1266,11 @@ int state_scrub(struct snapraid_state* state, int plan, int olderthan)
 
 	error = 0;
 
+	profile_begin("scrub");
+	state_perf_begin(state);
 	ret = state_scrub_process(state, parity_handle, 0, blockmax, &ps, now);
+	state_perf_end(state, "scrub");
+	profile_end();
 	if (ret == -1) {
 		++error;
 		/* continue, as we are already exiting */
@@ -28,21 +28,21 @@ static void search_file(struct snapraid_state* state, const char* path, data_off
 	struct snapraid_search_file* file;
 	tommy_uint32_t file_hash;
 
-	file = malloc_nofail(sizeof(struct snapraid_search_file));
-	file->path = strdup_nofail(path);
+	file = malloc_nofail_tag(sizeof(struct snapraid_search_file), MALLOC_IMPORT);
+	file->path = strdup_nofail_tag(path, MALLOC_IMPORT);
 	file->size = size;
 	file->mtime_sec = mtime_sec;
 	file->mtime_nsec = mtime_nsec;
 
 	file_hash = file_stamp_hash(file->size, file->mtime_sec, file->mtime_nsec);
 
-	tommy_hashdyn_insert(&state->searchset, &file->node, file, file_hash);
+	tommy_hashlin_insert(&state->searchset, &file->node, file, file_hash);
 }
 
 void search_file_free(struct snapraid_search_file* file)
 {
-	free(file->path);
-	free(file);
+	free_tag(file->path, strlen(file->path) + 1, MALLOC_IMPORT);
+	free_tag(file, sizeof(struct snapraid_search_file), MALLOC_IMPORT);
 }
 
 struct search_file_compare_arg {
@@ -140,7 +140,7 @@ int state_search_fetch(struct snapraid_state* state, int prevhash, struct snapra
 	file_hash = file_stamp_hash(arg.file->size, arg.file->mtime_sec, arg.file->mtime_nsec);
 
 	/* search in the hashtable, and also check if the data matches the hash */
-	file = tommy_hashdyn_search(&state->searchset, search_file_compare, &arg, file_hash);
+	file = tommy_hashlin_search(&state->searchset, search_file_compare, &arg, file_hash);
 	if (!file)
 		return -1;
 
@@ -270,6 +270,29 @@ void state_search(struct snapraid_state* state, const char* dir)
 void state_search_array(struct snapraid_state* state)
 {
 	tommy_node* i;
+	size_t needed;
+
+	/* estimate the memory needed, assuming to find all the files in the array */
+	needed = 0;
+	for (i = state->disklist; i != 0; i = i->next) {
+		struct snapraid_disk* disk = i->data;
+		tommy_node* j;
+
+		if (disk->skip_access)
+			continue;
+
+		for (j = tommy_list_head(&disk->filelist); j != 0; j = j->next) {
+			struct snapraid_file* file = j->data;
+			needed += sizeof(struct snapraid_search_file) + sizeof(void*) + strlen(disk->dir) + strlen(file->sub) + 1;
+		}
+	}
+
+	/* the search is only an optional help to recover, so skip it if it doesn't fit */
+	if (needed > malloc_limit_avail()) {
+		log_tag("memusage:search:skip:%" PRIu64 "\n", (uint64_t)needed);
+		log_fatal("WARNING! Not searching the array for copies of the files to fit the 'memorylimit'.\n");
+		return;
+	}
 
 	/* import from all the disks */
 	for (i = state->disklist; i != 0; i = i->next) {
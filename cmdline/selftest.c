@@ -303,6 +303,104 @@ static void test_crc32c(void)
 	}
 }
 
+#define ZERO_TEST_DISK 8 /* data disks used in the zero tests */
+#define ZERO_TEST_PARITY 3 /* parity used in the zero tests */
+#define ZERO_TEST_SIZE 256 /* block size used in the zero tests */
+
+static void test_zero(void)
+{
+	unsigned char seed[HASH_MAX];
+	struct snapraid_zerohash zh;
+	void* v_alloc;
+	void** v;
+	void* r_alloc;
+	void** r;
+	int zero_map[ZERO_TEST_DISK];
+	unsigned i;
+	int n;
+	int j;
+
+	v = malloc_nofail_vector_align(ZERO_TEST_DISK, ZERO_TEST_DISK + ZERO_TEST_PARITY, ZERO_TEST_SIZE, &v_alloc);
+	r = malloc_nofail_vector_align(ZERO_TEST_PARITY, ZERO_TEST_PARITY, ZERO_TEST_SIZE, &r_alloc);
+
+	for (i = 0; i < HASH_MAX; ++i)
+		seed[i] = i * 7;
+
+	/* zero check with the non zero byte at any position */
+	memset(v[0], 0, ZERO_TEST_SIZE);
+	for (i = 0; i < ZERO_TEST_SIZE; ++i) {
+		if (!memiszero(v[0], i + 1)) {
+			/* LCOV_EXCL_START */
+			log_fatal("Failed ZERO test\n");
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+		((unsigned char*)v[0])[i] = 1;
+		if (memiszero(v[0], i + 1) || memiszero(v[0], ZERO_TEST_SIZE)) {
+			/* LCOV_EXCL_START */
+			log_fatal("Failed ZERO test\n");
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+		((unsigned char*)v[0])[i] = 0;
+	}
+
+	/* cached hashes, with different sizes, kinds and seeds */
+	zerohash_init(&zh);
+	for (i = 1; i <= ZERO_TEST_SIZE * 2; ++i) {
+		unsigned size = i % ZERO_TEST_SIZE + 1;
+		unsigned kind = i % 3 == 0 ? HASH_MURMUR3 : HASH_SPOOKY2;
+		unsigned char digest[HASH_MAX];
+		unsigned char digest_cache[HASH_MAX];
+
+		seed[0] = i % 5;
+
+		memhash(kind, seed, digest, v[0], size);
+		memhash_zero(&zh, kind, seed, digest_cache, v[0], size, 1);
+		if (memcmp(digest, digest_cache, HASH_MAX) != 0) {
+			/* LCOV_EXCL_START */
+			log_fatal("Failed ZERO hash test\n");
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	/* parity with any number of trailing zero blocks */
+	for (n = 0; n <= ZERO_TEST_DISK; ++n) {
+		for (j = 0; j < ZERO_TEST_DISK; ++j) {
+			if (j < n) {
+				for (i = 0; i < ZERO_TEST_SIZE; ++i)
+					((unsigned char*)v[j])[i] = i * (j + 3) + n;
+				zero_map[j] = 0;
+			} else {
+				memset(v[j], 0, ZERO_TEST_SIZE);
+				zero_map[j] = 1;
+			}
+		}
+
+		raid_gen(ZERO_TEST_DISK, ZERO_TEST_PARITY, ZERO_TEST_SIZE, v);
+
+		for (j = 0; j < ZERO_TEST_PARITY; ++j) {
+			memcpy(r[j], v[ZERO_TEST_DISK + j], ZERO_TEST_SIZE);
+			memset(v[ZERO_TEST_DISK + j], 0x55, ZERO_TEST_SIZE);
+		}
+
+		raid_gen_zero(ZERO_TEST_DISK, ZERO_TEST_PARITY, ZERO_TEST_SIZE, v, zero_map);
+
+		for (j = 0; j < ZERO_TEST_PARITY; ++j) {
+			if (memcmp(r[j], v[ZERO_TEST_DISK + j], ZERO_TEST_SIZE) != 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("Failed ZERO parity test\n");
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+		}
+	}
+
+	free(r_alloc);
+	free(v_alloc);
+}
+
 /**
  * Size of tommy data structures.
  */
@@ -346,6 +444,7 @@ static void test_tommy(void)
 	tommy_arrayblkof arrayblkof;
 	tommy_list list;
 	tommy_hashdyn hashdyn;
+	tommy_hashlin hashlin;
 	tommy_tree tree;
 	tommy_node node[TOMMY_SIZE + 1];
 	unsigned i;
@@ -473,6 +572,73 @@ static void test_tommy(void)
 
 	tommy_hashdyn_done(&hashdyn);
 
+	tommy_hashlin_init(&hashlin);
+
+	for (i = 0; i < TOMMY_SIZE; ++i)
+		tommy_hashlin_insert(&hashlin, &node[i], &node[i], tommy_inthash_u32(i));
+
+	if (tommy_hashlin_count(&hashlin) != TOMMY_SIZE) {
+		/* LCOV_EXCL_START */
+		goto bail;
+		/* LCOV_EXCL_STOP */
+	}
+
+	if (tommy_hashlin_memory_usage(&hashlin) < TOMMY_SIZE * sizeof(tommy_node)) {
+		/* LCOV_EXCL_START */
+		goto bail;
+		/* LCOV_EXCL_STOP */
+	}
+
+	for (i = 0; i < TOMMY_SIZE; ++i) {
+		if (tommy_hashlin_search(&hashlin, tommy_test_search, &node[i], tommy_inthash_u32(i)) != &node[i]) {
+			/* LCOV_EXCL_START */
+			goto bail;
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	tommy_test_foreach_count = 0;
+	tommy_hashlin_foreach(&hashlin, tommy_test_foreach);
+	if (tommy_test_foreach_count != TOMMY_SIZE) {
+		/* LCOV_EXCL_START */
+		goto bail;
+		/* LCOV_EXCL_STOP */
+	}
+
+	tommy_test_foreach_count = 0;
+	tommy_hashlin_foreach_arg(&hashlin, tommy_test_foreach_arg, &tommy_test_foreach_count);
+	if (tommy_test_foreach_count != TOMMY_SIZE) {
+		/* LCOV_EXCL_START */
+		goto bail;
+		/* LCOV_EXCL_STOP */
+	}
+
+	for (i = 0; i < TOMMY_SIZE / 2; ++i)
+		tommy_hashlin_remove_existing(&hashlin, &node[i]);
+
+	for (i = 0; i < TOMMY_SIZE / 2; ++i) {
+		if (tommy_hashlin_remove(&hashlin, tommy_test_search, &node[i], tommy_inthash_u32(i)) != 0) {
+			/* LCOV_EXCL_START */
+			goto bail;
+			/* LCOV_EXCL_STOP */
+		}
+	}
+	for (i = TOMMY_SIZE / 2; i < TOMMY_SIZE; ++i) {
+		if (tommy_hashlin_remove(&hashlin, tommy_test_search, &node[i], tommy_inthash_u32(i)) == 0) {
+			/* LCOV_EXCL_START */
+			goto bail;
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	if (tommy_hashlin_count(&hashlin) != 0) {
+		/* LCOV_EXCL_START */
+		goto bail;
+		/* LCOV_EXCL_STOP */
+	}
+
+	tommy_hashlin_done(&hashlin);
+
 	tommy_tree_init(&tree, tommy_test_compare);
 
 	for (i = 0; i < TOMMY_SIZE; ++i)
@@ -578,6 +744,7 @@ void selftest(void)
 
 	test_hash();
 	test_crc32c();
+	test_zero();
 	test_tommy();
 	if (raid_selftest() != 0) {
 		/* LCOV_EXCL_START */
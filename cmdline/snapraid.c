@@ -21,6 +21,7 @@
 #include "support.h"
 #include "elem.h"
 #include "import.h"
+#include "export.h"
 #include "search.h"
 #include "state.h"
 #include "io.h"
@@ -38,7 +39,7 @@ void usage(void)
 {
 	version();
 
-	printf("Usage: " PACKAGE " status|diff|sync|scrub|list|dup|up|down|smart|pool|check|fix [options]\n");
+	printf("Usage: " PACKAGE " status|diff|sync|scrub|list|dup|up|down|smart|pool|check|fix|retire [options]\n");
 	printf("\n");
 	printf("Commands:\n");
 	printf("  status Print the status of the array\n");
@@ -53,6 +54,7 @@ void usage(void)
 	printf("  pool   Create or update the virtual view of the array\n");
 	printf("  check  Check the array\n");
 	printf("  fix    Fix the array\n");
+	printf("  retire Remove a data disk from the array\n");
 	printf("\n");
 	printf("Options:\n");
 	printf("  " SWITCH_GETOPT_LONG("-c, --conf FILE       ", "-c") "  Configuration file\n");
@@ -60,12 +62,23 @@ void usage(void)
 	printf("  " SWITCH_GETOPT_LONG("-d, --filter-disk NAME", "-f") "  Process only files in the specified disk\n");
 	printf("  " SWITCH_GETOPT_LONG("-m, --filter-missing  ", "-m") "  Process only missing/deleted files\n");
 	printf("  " SWITCH_GETOPT_LONG("-e, --filter-error    ", "-e") "  Process only files with errors\n");
+	printf("  " SWITCH_GETOPT_LONG("-r, --priority PATTERN", "-r") "  Process first files matching the pattern\n");
 	printf("  " SWITCH_GETOPT_LONG("-p, --plan PLAN       ", "-p") "  Define a scrub plan or percentage\n");
 	printf("  " SWITCH_GETOPT_LONG("-o, --older-than DAYS ", "-o") "  Process only the older part of the array\n");
 	printf("  " SWITCH_GETOPT_LONG("-i, --import DIR      ", "-i") "  Import deleted files\n");
 	printf("  " SWITCH_GETOPT_LONG("-l, --log FILE        ", "-l") "  Log file. Default none\n");
 	printf("  " SWITCH_GETOPT_LONG("-a, --audit-only      ", "-a") "  Check only file data and not parity\n");
+	printf("  " SWITCH_GETOPT_LONG("-Q, --quick           ", "-Q") "  Read only the parity needed to recover\n");
+	printf("  " SWITCH_GETOPT_LONG("-w, --hedge-wait MS   ", "-w") "  Recover from parity reads slower than MS\n");
+	printf("  " SWITCH_GETOPT_LONG("-k, --risk            ", "-k") "  Scrub first the disks at risk of failure\n");
+	printf("  " SWITCH_GETOPT_LONG("-y, --parity-cycle N  ", "-y") "  Verify the parity levels in a cycle of N scrubs\n");
+	printf("  " SWITCH_GETOPT_LONG("-j, --threads N       ", "-j") "  Max number of computing threads\n");
+	printf("  " SWITCH_GETOPT_LONG("-n, --estimate        ", "-n") "  Estimate the duration without processing\n");
+	printf("  " SWITCH_GETOPT_LONG("-x, --export FORMAT   ", "-x") "  Output in the json or tsv format\n");
+	printf("  " SWITCH_GETOPT_LONG("-g, --defrag N        ", "-g") "  Relocate up to N blocks of fragmented files\n");
+	printf("  " SWITCH_GETOPT_LONG("-z, --compact         ", "-z") "  Move the blocks at the end and shrink the parity\n");
 	printf("  " SWITCH_GETOPT_LONG("-h, --pre-hash        ", "-h") "  Pre-hash all the new data\n");
+	printf("  " SWITCH_GETOPT_LONG("-s, --scan-hash KIB   ", "-s") "  Hash new files up to KIB already in the scan\n");
 	printf("  " SWITCH_GETOPT_LONG("-Z, --force-zero      ", "-Z") "  Force syncing of files that get zero size\n");
 	printf("  " SWITCH_GETOPT_LONG("-E, --force-empty     ", "-E") "  Force syncing of disks that get empty\n");
 	printf("  " SWITCH_GETOPT_LONG("-U, --force-uuid      ", "-U") "  Force commands on disks with uuid changed\n");
@@ -73,6 +86,7 @@ void usage(void)
 	printf("  " SWITCH_GETOPT_LONG("-N, --force-nocopy    ", "-N") "  Force commands disabling the copy detection\n");
 	printf("  " SWITCH_GETOPT_LONG("-F, --force-full      ", "-F") "  Force a full parity computation in sync\n");
 	printf("  " SWITCH_GETOPT_LONG("-R, --force-realloc   ", "-R") "  Force a full parity reallocation in sync\n");
+	printf("  " SWITCH_GETOPT_LONG("-P, --force-new-parity", "-P") "  Force the computation of only the new parity in sync\n");
 	printf("  " SWITCH_GETOPT_LONG("-v, --verbose         ", "-v") "  Verbose\n");
 }
 
@@ -300,6 +314,8 @@ void config(char* conf, size_t conf_size, const char* argv0)
 #define OPT_TEST_SKIP_CONTENT_WRITE 302
 #define OPT_TEST_SKIP_SPACE_HOLDER 303
 #define OPT_TEST_FORMAT 304
+#define OPT_TEST_IO_SLOW 305
+#define OPT_PROFILE 306
 
 #if HAVE_GETOPT_LONG
 struct option long_options[] = {
@@ -308,6 +324,7 @@ struct option long_options[] = {
 	{ "filter-disk", 1, 0, 'd' },
 	{ "filter-missing", 0, 0, 'm' },
 	{ "filter-error", 0, 0, 'e' },
+	{ "priority", 1, 0, 'r' },
 	{ "percentage", 1, 0, 'p' }, /* legacy name for --plan */
 	{ "plan", 1, 0, 'p' },
 	{ "older-than", 1, 0, 'o' },
@@ -323,8 +340,19 @@ struct option long_options[] = {
 	{ "force-nocopy", 0, 0, 'N' },
 	{ "force-full", 0, 0, 'F' },
 	{ "force-realloc", 0, 0, 'R' },
+	{ "force-new-parity", 0, 0, 'P' },
 	{ "audit-only", 0, 0, 'a' },
+	{ "quick", 0, 0, 'Q' },
+	{ "hedge-wait", 1, 0, 'w' },
+	{ "risk", 0, 0, 'k' },
+	{ "parity-cycle", 1, 0, 'y' },
+	{ "threads", 1, 0, 'j' },
+	{ "estimate", 0, 0, 'n' },
+	{ "export", 1, 0, 'x' },
+	{ "defrag", 1, 0, 'g' },
+	{ "compact", 0, 0, 'z' },
 	{ "pre-hash", 0, 0, 'h' },
+	{ "scan-hash", 1, 0, 's' },
 	{ "speed-test", 0, 0, 'T' }, /* undocumented speed test command */
 	{ "gen-conf", 1, 0, 'C' },
 	{ "verbose", 0, 0, 'v' },
@@ -416,6 +444,9 @@ struct option long_options[] = {
 	/* Disable annoying warnings */
 	{ "no-warnings", 0, 0, OPT_NO_WARNINGS },
 
+	/* Write the phase profile */
+	{ "profile", 1, 0, OPT_PROFILE },
+
 	/* Fake UUID */
 	{ "test-fake-uuid", 0, 0, OPT_TEST_FAKE_UUID },
 
@@ -467,11 +498,14 @@ struct option long_options[] = {
 	/* Set the output format */
 	{ "test-fmt", 1, 0, OPT_TEST_FORMAT },
 
+	/* Delay the reads of the first data disk */
+	{ "test-io-slow", 1, 0, OPT_TEST_IO_SLOW },
+
 	{ 0, 0, 0, 0 }
 };
 #endif
 
-#define OPTIONS "c:f:d:mep:o:S:B:L:i:l:ZEUDNFRahTC:vqHVG"
+#define OPTIONS "c:f:d:mer:p:o:S:B:L:i:l:ZEUDNFRPaQw:ky:j:nx:g:zhs:TC:vqHVG"
 
 volatile int global_interrupt = 0;
 
@@ -523,6 +557,7 @@ void signal_init(void)
 #define OPERATION_SPINDOWN 15
 #define OPERATION_DEVICES 16
 #define OPERATION_SMART 17
+#define OPERATION_RETIRE 18
 
 int main(int argc, char* argv[])
 {
@@ -536,6 +571,7 @@ int main(int argc, char* argv[])
 	int ret;
 	tommy_list filterlist_file;
 	tommy_list filterlist_disk;
+	tommy_list filterlist_priority;
 	int filter_missing;
 	int filter_error;
 	int plan;
@@ -545,6 +581,7 @@ int main(int argc, char* argv[])
 	const char* import_timestamp;
 	const char* import_content;
 	const char* log_file;
+	const char* profile_file;
 	int lock;
 	const char* gen_conf;
 	const char* run;
@@ -565,6 +602,7 @@ int main(int argc, char* argv[])
 	blockstart = 0;
 	blockcount = 0;
 	tommy_list_init(&filterlist_file);
+	tommy_list_init(&filterlist_priority);
 	tommy_list_init(&filterlist_disk);
 	period = 1000;
 	filter_missing = 0;
@@ -574,6 +612,7 @@ int main(int argc, char* argv[])
 	import_timestamp = 0;
 	import_content = 0;
 	log_file = 0;
+	profile_file = 0;
 	lock = 0;
 	gen_conf = 0;
 	speedtest = 0;
@@ -612,6 +651,17 @@ int main(int argc, char* argv[])
 			}
 			tommy_list_insert_tail(&filterlist_disk, &filter->node, filter);
 		} break;
+		case 'r' : {
+			struct snapraid_filter* filter = filter_alloc_file(1, optarg);
+			if (!filter) {
+				/* LCOV_EXCL_START */
+				log_fatal("Invalid priority specification '%s'\n", optarg);
+				log_fatal("Filters using relative paths are not supported. Ensure to add an initial slash\n");
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+			tommy_list_insert_tail(&filterlist_priority, &filter->node, filter);
+		} break;
 		case 'm' :
 			filter_missing = 1;
 			opt.expected_missing = 1;
@@ -703,6 +753,9 @@ int main(int argc, char* argv[])
 			}
 			log_file = optarg;
 			break;
+		case OPT_PROFILE :
+			profile_file = optarg;
+			break;
 		case 'Z' :
 			opt.force_zero = 1;
 			break;
@@ -724,12 +777,82 @@ int main(int argc, char* argv[])
 		case 'R' :
 			opt.force_realloc = 1;
 			break;
+		case 'P' :
+			opt.force_new_parity = 1;
+			break;
 		case 'a' :
 			opt.auditonly = 1;
 			break;
+		case 'Q' :
+			opt.quick = 1;
+			break;
+		case 'w' :
+			opt.hedge_wait = strtoul(optarg, &e, 0);
+			if (!e || *e || opt.hedge_wait == 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("Invalid hedge wait '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+			break;
+		case 'k' :
+			opt.risk = 1;
+			break;
+		case 'n' :
+			opt.estimate = 1;
+			break;
+		case 'x' :
+			opt.export_format = export_format(optarg);
+			if (opt.export_format == EXPORT_NONE) {
+				/* LCOV_EXCL_START */
+				log_fatal("Invalid export format '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+			break;
+		case 'g' :
+			opt.defrag = strtoul(optarg, &e, 0);
+			if (!e || *e || opt.defrag == 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("Invalid number of defrag blocks '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+			break;
+		case 'z' :
+			opt.compact = 1;
+			break;
+		case 'y' :
+			opt.parity_cycle = strtoul(optarg, &e, 0);
+			if (!e || *e || opt.parity_cycle == 0 || opt.parity_cycle > LEV_MAX) {
+				/* LCOV_EXCL_START */
+				log_fatal("Invalid parity cycle '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+			break;
+		case 'j' :
+			opt.thread_max = strtoul(optarg, &e, 0);
+			if (!e || *e || opt.thread_max == 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("Invalid number of threads '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+			break;
 		case 'h' :
 			opt.prehash = 1;
 			break;
+		case 's' :
+			opt.scan_hash = strtoul(optarg, &e, 0);
+			if (!e || *e || opt.scan_hash == 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("Invalid scan hash size '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+			opt.scan_hash *= KIBI;
+			break;
 		case 'v' :
 			++msg_level;
 			break;
@@ -896,6 +1019,9 @@ int main(int argc, char* argv[])
 		case OPT_TEST_SKIP_SPACE_HOLDER :
 			opt.skip_space_holder = 1;
 			break;
+		case OPT_TEST_IO_SLOW :
+			opt.io_slow = atoi(optarg);
+			break;
 		case OPT_TEST_FORMAT :
 			if (strcmp(optarg, "file") == 0)
 				FMT_MODE = FMT_FILE;
@@ -921,6 +1047,9 @@ int main(int argc, char* argv[])
 	os_init(opt.force_scan_winfind);
 	raid_init();
 	crc32c_init();
+#if HAVE_PTHREAD
+	thread_pool_init(opt.thread_max);
+#endif
 
 	if (speedtest != 0) {
 		speed(period);
@@ -978,6 +1107,8 @@ int main(int argc, char* argv[])
 		operation = OPERATION_DEVICES;
 	} else if (strcmp(argv[optind], "smart") == 0) {
 		operation = OPERATION_SMART;
+	} else if (strcmp(argv[optind], "retire") == 0) {
+		operation = OPERATION_RETIRE;
 	} else {
 		/* LCOV_EXCL_START */
 		log_fatal("Unknown command '%s'\n", argv[optind]);
@@ -998,11 +1129,99 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	switch (operation) {
+	case OPERATION_SCRUB :
+		break;
+	default :
+		if (opt.hedge_wait) {
+			/* LCOV_EXCL_START */
+			log_fatal("You cannot use -w, --hedge-wait with the '%s' command\n", command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+
+		if (opt.risk) {
+			/* LCOV_EXCL_START */
+			log_fatal("You cannot use -k, --risk with the '%s' command\n", command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+
+		if (opt.parity_cycle) {
+			/* LCOV_EXCL_START */
+			log_fatal("You cannot use -y, --parity-cycle with the '%s' command\n", command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	switch (operation) {
+	case OPERATION_SYNC :
+	case OPERATION_SCRUB :
+		break;
+	default :
+		if (opt.estimate) {
+			/* LCOV_EXCL_START */
+			log_fatal("You cannot use -n, --estimate with the '%s' command\n", command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	switch (operation) {
+	case OPERATION_SYNC :
+		break;
+	default :
+		if (opt.defrag) {
+			/* LCOV_EXCL_START */
+			log_fatal("You cannot use -g, --defrag with the '%s' command\n", command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+
+		if (opt.compact) {
+			/* LCOV_EXCL_START */
+			log_fatal("You cannot use -z, --compact with the '%s' command\n", command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	switch (operation) {
+	case OPERATION_LIST :
+	case OPERATION_DIFF :
+		/* the standard output contains only the exported data */
+		if (opt.export_format != EXPORT_NONE)
+			msg_level = MSG_STATUS - 1;
+		break;
+	default :
+		if (opt.export_format != EXPORT_NONE) {
+			/* LCOV_EXCL_START */
+			log_fatal("You cannot use -x, --export with the '%s' command\n", command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
 	switch (operation) {
 	case OPERATION_FIX :
 	case OPERATION_CHECK :
 		break;
 	default :
+		if (!tommy_list_empty(&filterlist_priority)) {
+			/* LCOV_EXCL_START */
+			log_fatal("You cannot use -r, --priority with the '%s' command\n", command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+
+		if (opt.quick) {
+			/* LCOV_EXCL_START */
+			log_fatal("You cannot use -Q, --quick with the '%s' command\n", command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+
 		if (opt.force_device) {
 			/* LCOV_EXCL_START */
 			log_fatal("You cannot use -D, --force-device with the '%s' command\n", command);
@@ -1036,6 +1255,13 @@ int main(int argc, char* argv[])
 			/* LCOV_EXCL_STOP */
 		}
 
+		if (opt.scan_hash) {
+			/* LCOV_EXCL_START */
+			log_fatal("You cannot use -s, --scan-hash with the '%s' command\n", command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+
 		if (opt.force_full) {
 			/* LCOV_EXCL_START */
 			log_fatal("You cannot use -F, --force-full with the '%s' command\n", command);
@@ -1049,6 +1275,13 @@ int main(int argc, char* argv[])
 			exit(EXIT_FAILURE);
 			/* LCOV_EXCL_STOP */
 		}
+
+		if (opt.force_new_parity) {
+			/* LCOV_EXCL_START */
+			log_fatal("You cannot use -P, --force-new-parity with the '%s' command\n", command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
 	}
 
 	if (opt.force_full && opt.force_nocopy) {
@@ -1072,6 +1305,20 @@ int main(int argc, char* argv[])
 		/* LCOV_EXCL_STOP */
 	}
 
+	if (opt.force_new_parity && (opt.force_full || opt.force_realloc)) {
+		/* LCOV_EXCL_START */
+		log_fatal("You cannot use the -P, --force-new-parity and -F, --force-full or -R, --force-realloc options at the same time\n");
+		exit(EXIT_FAILURE);
+		/* LCOV_EXCL_STOP */
+	}
+
+	if (opt.force_new_parity && opt.compact) {
+		/* LCOV_EXCL_START */
+		log_fatal("You cannot use the -P, --force-new-parity and -z, --compact options at the same time\n");
+		exit(EXIT_FAILURE);
+		/* LCOV_EXCL_STOP */
+	}
+
 	if (opt.prehash && opt.force_nocopy) {
 		/* LCOV_EXCL_START */
 		log_fatal("You cannot use the -h, --pre-hash and -N, --force-nocopy options at the same time\n");
@@ -1084,6 +1331,15 @@ int main(int argc, char* argv[])
 	case OPERATION_FIX :
 	case OPERATION_DRY :
 		break;
+	case OPERATION_LIST :
+		/* list only filters by path and disk */
+		if (filter_missing != 0 || filter_error != 0) {
+			/* LCOV_EXCL_START */
+			log_fatal("You cannot use -m, --filter-missing or -e, --filter-error with the '%s' command\n", command);
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+		break;
 	default :
 		if (!tommy_list_empty(&filterlist_disk)) {
 			/* LCOV_EXCL_START */
@@ -1092,8 +1348,10 @@ int main(int argc, char* argv[])
 			/* LCOV_EXCL_STOP */
 		}
 		/* follow */
+	case OPERATION_SYNC :
 	case OPERATION_SPINUP :
 	case OPERATION_SPINDOWN :
+	case OPERATION_RETIRE :
 		if (!tommy_list_empty(&filterlist_file)) {
 			/* LCOV_EXCL_START */
 			log_fatal("You cannot use -f, --filter with the '%s' command\n", command);
@@ -1114,6 +1372,14 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	/* compact and defrag work on the whole array */
+	if (!tommy_list_empty(&filterlist_disk) && (opt.compact || opt.defrag)) {
+		/* LCOV_EXCL_START */
+		log_fatal("You cannot use -d, --filter-disk with -z, --compact or -g, --defrag\n");
+		exit(EXIT_FAILURE);
+		/* LCOV_EXCL_STOP */
+	}
+
 	/* errors must be always fixed on all disks */
 	/* because we don't keep the information on what disk is the error */
 	if (filter_error != 0 && !tommy_list_empty(&filterlist_disk)) {
@@ -1192,6 +1458,7 @@ int main(int argc, char* argv[])
 	case OPERATION_SYNC :
 	case OPERATION_SCRUB :
 	case OPERATION_DRY :
+		opt.direct_io = 1;
 		break;
 #endif
 	default:
@@ -1239,8 +1506,13 @@ int main(int argc, char* argv[])
 
 	state_init(&state);
 
+	/* start the profiling after the initial self test */
+	profile_init();
+
 	/* read the configuration file */
+	profile_begin("config");
 	state_config(&state, conf, command, &opt, &filterlist_disk);
+	profile_end();
 
 	/* set the raid mode */
 	raid_mode(state.raid_mode);
@@ -1305,7 +1577,16 @@ int main(int argc, char* argv[])
 
 		state_read(&state);
 
-		state_scan(&state);
+		/* if filtering, only the selected disks are scanned */
+		/* sync then processes only the blocks changed in them */
+		state_scan(&state, &filterlist_disk);
+
+		/* compact before defrag, to have more free space */
+		if (opt.compact)
+			state_compact(&state);
+
+		if (opt.defrag)
+			state_defrag(&state);
 
 		/* refresh the size info before the content write */
 		state_refresh(&state);
@@ -1333,13 +1614,15 @@ int main(int argc, char* argv[])
 		/* The worst case is the FAT file-system with a two seconds resolution for mtime. */
 		/* If you don't use FAT, the wait is not needed, because most file-systems have now */
 		/* at least microseconds resolution, but better to be safe. */
-		if (!opt.skip_self)
+		if (!opt.skip_self && !opt.estimate)
 			sleep(2);
 
 		ret = state_sync(&state, blockstart, blockcount);
 
 		/* save the new state if required */
-		if (!opt.kill_after_sync) {
+		if (opt.estimate) {
+			/* the estimate doesn't change anything */
+		} else if (!opt.kill_after_sync) {
 			if ((state.need_write || state.opt.force_content_write))
 				state_write(&state);
 		} else {
@@ -1381,11 +1664,35 @@ int main(int argc, char* argv[])
 
 		memory();
 
+		/* get the risk of failure of the disks */
+		if (state.opt.risk)
+			state_risk(&state);
+
 		/* intercept signals while operating */
 		signal_init();
 
 		ret = state_scrub(&state, plan, olderthan);
 
+		/* save the new state if required */
+		if (!state.opt.estimate && (state.need_write || state.opt.force_content_write))
+			state_write(&state);
+
+		/* abort if required */
+		if (ret != 0) {
+			/* LCOV_EXCL_START */
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+	} else if (operation == OPERATION_RETIRE) {
+		state_read(&state);
+
+		memory();
+
+		/* intercept signals while operating */
+		signal_init();
+
+		ret = state_retire(&state, &filterlist_disk);
+
 		/* save the new state if required */
 		if (state.need_write || state.opt.force_content_write)
 			state_write(&state);
@@ -1439,7 +1746,11 @@ int main(int argc, char* argv[])
 
 		state_dup(&state);
 	} else if (operation == OPERATION_LIST) {
-		state_read(&state);
+		/* load only the paths to list */
+		state_read_lookup(&state, &filterlist_file);
+
+		/* filter */
+		state_filter(&state, &filterlist_file, &filterlist_disk, filter_missing, filter_error);
 
 		state_list(&state);
 	} else if (operation == OPERATION_POOL) {
@@ -1447,7 +1758,11 @@ int main(int argc, char* argv[])
 
 		state_pool(&state);
 	} else {
-		state_read(&state);
+		/* in audit only mode, load only the paths to check */
+		if (state.opt.auditonly)
+			state_read_lookup(&state, &filterlist_file);
+		else
+			state_read(&state);
 
 		/* if we are also trying to recover */
 		if (!state.opt.auditonly) {
@@ -1465,6 +1780,7 @@ int main(int argc, char* argv[])
 		/* filter */
 		state_skip(&state);
 		state_filter(&state, &filterlist_file, &filterlist_disk, filter_missing, filter_error);
+		state_priority(&state, &filterlist_priority);
 
 		memory();
 
@@ -1485,6 +1801,17 @@ int main(int argc, char* argv[])
 		}
 	}
 
+#if HAVE_PTHREAD
+	/* terminate all the threads */
+	thread_pool_done();
+#endif
+
+	/* output the memory used by subsystem */
+	state_memory(&state, 0);
+
+	/* output the profile of all the phases */
+	profile_print(command, profile_file);
+
 	/* close log file */
 	log_close(log_file);
 
@@ -1501,6 +1828,7 @@ int main(int argc, char* argv[])
 
 	state_done(&state);
 	tommy_list_foreach(&filterlist_file, (tommy_foreach_func*)filter_free);
+	tommy_list_foreach(&filterlist_priority, (tommy_foreach_func*)filter_free);
 	tommy_list_foreach(&filterlist_disk, (tommy_foreach_func*)filter_free);
 
 	os_done();
@@ -81,7 +81,7 @@ void speed(int period)
 	struct timeval stop;
 	int64_t ds;
 	int64_t dt;
-	int i, j;
+	int i, j, l;
 	unsigned char digest[HASH_MAX];
 	unsigned char seed[HASH_MAX];
 	int id[RAID_PARITY_MAX];
@@ -940,6 +940,58 @@ void speed(int period)
 	printf("\n");
 	printf("\n");
 
+	/* verify table */
+	printf("RAID functions used for verifying with 'scrub':\n");
+	printf("%8s", "");
+	printf("%8s", "best");
+	printf("%8s", "int8");
+#ifdef CONFIG_X86
+	printf("%8s", "ssse3");
+#endif
+#ifdef CONFIG_X86_64
+	printf("%8s", "ssse3e");
+#endif
+	printf("\n");
+
+	for (l = 1; l <= RAID_PARITY_MAX; ++l) {
+		printf("%7s%d", "ver", l);
+		printf("%8s", raid_verify_tag());
+		fflush(stdout);
+
+		SPEED_START {
+			side_effect += raid_verify_int8(nd, l, size, v);
+		} SPEED_STOP
+
+		printf("%8" PRIu64, ds / dt);
+		fflush(stdout);
+
+#ifdef CONFIG_X86
+#ifdef CONFIG_SSSE3
+		if (raid_cpu_has_ssse3()) {
+			SPEED_START {
+				side_effect += raid_verify_ssse3(nd, l, size, v);
+			} SPEED_STOP
+
+			printf("%8" PRIu64, ds / dt);
+		}
+#endif
+#endif
+
+#ifdef CONFIG_X86_64
+#ifdef CONFIG_SSSE3
+		if (raid_cpu_has_ssse3()) {
+			SPEED_START {
+				side_effect += raid_verify_ssse3ext(nd, l, size, v);
+			} SPEED_STOP
+
+			printf("%8" PRIu64, ds / dt);
+		}
+#endif
+#endif
+		printf("\n");
+	}
+	printf("\n");
+
 	printf("If the 'best' expectations are wrong, please report it in the SnapRAID forum\n\n");
 
 	free(v_alloc);
@@ -145,6 +145,7 @@ void state_init(struct snapraid_state* state)
 	state->autosave = 0;
 	state->need_write = 0;
 	state->checked_read = 0;
+	state->partial_read = 0;
 	state->block_size = 256 * KIBI; /* default 256 KiB */
 	state->raid_mode = RAID_MODE_CAUCHY;
 	state->file_mode = ADVISE_DEFAULT;
@@ -160,8 +161,15 @@ void state_init(struct snapraid_state* state)
 		state->parity[l].total_blocks = 0;
 		state->parity[l].free_blocks = 0;
 		state->parity[l].skip_access = 0;
+		state->parity[l].is_new = 0;
+		state->parity[l].file_mode = ADVISE_DEFAULT;
 		state->parity[l].tick = 0;
 		state->parity[l].cached = 0;
+		state->parity[l].io_tick = 0;
+		state->parity[l].io_size = 0;
+		memset(state->parity[l].io_latency, 0, sizeof(state->parity[l].io_latency));
+		state->parity[l].io_error = 0;
+		state->parity[l].io_retry = 0;
 		state->parity[l].is_excluded_by_filter = 0;
 	}
 	state->tick_io = 0;
@@ -174,18 +182,20 @@ void state_init(struct snapraid_state* state)
 	state->pool[0] = 0;
 	state->pool_device = 0;
 	state->lockfile[0] = 0;
+	state->perffile[0] = 0;
 	state->level = 1; /* default is the lowest protection */
 	state->clear_past_hash = 0;
 	state->no_conf = 0;
+	zerohash_init(&state->zerohash);
 
 	tommy_list_init(&state->disklist);
 	tommy_list_init(&state->maplist);
 	tommy_list_init(&state->contentlist);
 	tommy_list_init(&state->filterlist);
 	tommy_list_init(&state->importlist);
-	tommy_hashdyn_init(&state->importset);
-	tommy_hashdyn_init(&state->previmportset);
-	tommy_hashdyn_init(&state->searchset);
+	tommy_hashlin_init(&state->importset);
+	tommy_hashlin_init(&state->previmportset);
+	tommy_hashlin_init(&state->searchset);
 	tommy_arrayblkof_init(&state->infoarr, sizeof(snapraid_info));
 }
 
@@ -196,10 +206,10 @@ void state_done(struct snapraid_state* state)
 	tommy_list_foreach(&state->contentlist, (tommy_foreach_func*)content_free);
 	tommy_list_foreach(&state->filterlist, (tommy_foreach_func*)filter_free);
 	tommy_list_foreach(&state->importlist, (tommy_foreach_func*)import_file_free);
-	tommy_hashdyn_foreach(&state->searchset, (tommy_foreach_func*)search_file_free);
-	tommy_hashdyn_done(&state->importset);
-	tommy_hashdyn_done(&state->previmportset);
-	tommy_hashdyn_done(&state->searchset);
+	tommy_hashlin_foreach(&state->searchset, (tommy_foreach_func*)search_file_free);
+	tommy_hashlin_done(&state->importset);
+	tommy_hashlin_done(&state->previmportset);
+	tommy_hashlin_done(&state->searchset);
 	tommy_arrayblkof_done(&state->infoarr);
 }
 
@@ -518,6 +528,111 @@ static int validate_smartctl(const char* custom)
 	return 0;
 }
 
+/**
+ * Minimum device queue depth to select the direct mode.
+ * With a shallow queue the missing read-ahead of the direct mode is not compensated
+ * by the concurrent requests.
+ */
+#define ADVISE_DIRECT_QUEUE_MIN 32
+
+/**
+ * Select the file access mode for a device from its characteristics.
+ *
+ * Rotational devices use the page cache, and they get their read-ahead from the
+ * sequential hint. The written data is flushed to keep the write-back cache small,
+ * with a window for parity, as it's written in large sequential chunks.
+ * Solid state devices don't benefit from the cache, so it's discarded.
+ * For parity, if the device has a deep queue and the block size is aligned,
+ * the direct mode is used to completely skip the cache.
+ */
+static int state_config_advise_auto(struct snapraid_state* state, uint64_t device, const char* path, int is_parity)
+{
+	int rotational;
+	unsigned queue_depth;
+	unsigned logical_block_size;
+
+	if (device == 0 || devattr(device, &rotational, &queue_depth, &logical_block_size) != 0)
+		return state->file_mode;
+
+	if (rotational)
+		return is_parity ? ADVISE_FLUSH_WINDOW : ADVISE_FLUSH;
+
+	if (is_parity
+		&& state->opt.direct_io
+		&& (queue_depth == 0 || queue_depth >= ADVISE_DIRECT_QUEUE_MIN)
+		&& logical_block_size != 0
+		&& state->block_size % logical_block_size == 0
+		&& advise_direct_probe(path) == 0)
+		return ADVISE_DIRECT;
+
+	return ADVISE_DISCARD_WINDOW;
+}
+
+/**
+ * Select the file access mode of all the disks and parities.
+ *
+ * The mode specified in the command line has precedence on everything,
+ * then the one specified in the configuration file with the 'advise' option,
+ * and finally the one automatically selected from the device.
+ */
+static void state_config_advise(struct snapraid_state* state)
+{
+	tommy_node* i;
+	unsigned l;
+
+	state->direct_mode = 0;
+
+	for (i = state->disklist; i != 0; i = i->next) {
+		struct snapraid_disk* disk = i->data;
+		const char* source;
+
+		if (state->opt.file_mode != ADVISE_DEFAULT) {
+			disk->file_mode = state->file_mode;
+			source = "option";
+		} else if (disk->file_mode != ADVISE_DEFAULT) {
+			source = "config";
+		} else {
+			disk->file_mode = state_config_advise_auto(state, disk->device, disk->dir, 0);
+			source = "auto";
+		}
+
+		/* we allow direct IO only on some commands */
+		if (disk->file_mode == ADVISE_DIRECT && !state->opt.direct_io)
+			disk->file_mode = ADVISE_SEQUENTIAL;
+
+		if (disk->file_mode == ADVISE_DIRECT)
+			state->direct_mode = 1;
+
+		log_tag("advise:%s:%s:%s\n", disk->name, advise_name(disk->file_mode), source);
+		msg_verbose("Disk '%s' uses the '%s' access mode (%s)\n", disk->name, advise_name(disk->file_mode), source);
+	}
+
+	for (l = 0; l < state->level; ++l) {
+		struct snapraid_parity* parity = &state->parity[l];
+		const char* source;
+
+		if (state->opt.file_mode != ADVISE_DEFAULT) {
+			parity->file_mode = state->file_mode;
+			source = "option";
+		} else if (parity->file_mode != ADVISE_DEFAULT) {
+			source = "config";
+		} else {
+			parity->file_mode = state_config_advise_auto(state, parity->split_map[0].device, parity->split_map[0].path, 1);
+			source = "auto";
+		}
+
+		/* we allow direct IO only on some commands */
+		if (parity->file_mode == ADVISE_DIRECT && !state->opt.direct_io)
+			parity->file_mode = ADVISE_SEQUENTIAL;
+
+		if (parity->file_mode == ADVISE_DIRECT)
+			state->direct_mode = 1;
+
+		log_tag("advise:%s:%s:%s\n", lev_config_name(l), advise_name(parity->file_mode), source);
+		msg_verbose("Parity '%s' uses the '%s' access mode (%s)\n", lev_config_name(l), advise_name(parity->file_mode), source);
+	}
+}
+
 void state_config(struct snapraid_state* state, const char* path, const char* command, struct snapraid_option* opt, tommy_list* filterlist_disk)
 {
 	STREAM* f;
@@ -868,10 +983,12 @@ void state_config(struct snapraid_state* state, const char* path, const char* co
 				}
 			}
 
-			/* set the lock file at the first accessible content file */
+			/* set the lock and performance files at the first accessible content file */
 			if (state->lockfile[0] == 0 && dev != 0) {
 				pathcpy(state->lockfile, sizeof(state->lockfile), buffer);
 				pathcat(state->lockfile, sizeof(state->lockfile), ".lock");
+				pathcpy(state->perffile, sizeof(state->perffile), buffer);
+				pathcat(state->perffile, sizeof(state->perffile), ".perf");
 			}
 
 			content = content_alloc(buffer, dev);
@@ -1058,6 +1175,67 @@ void state_config(struct snapraid_state* state, const char* path, const char* co
 
 				pathcpy(disk->smartctl, sizeof(disk->smartctl), custom);
 			}
+		} else if (strcmp(tag, "advise") == 0) {
+			char tmp[32];
+			int mode;
+
+			ret = sgettok(f, buffer, sizeof(buffer));
+			if (ret < 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("Invalid 'advise' name specification in '%s' at line %u\n", path, line);
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+
+			if (!*buffer) {
+				/* LCOV_EXCL_START */
+				log_fatal("Empty 'advise' name specification in '%s' at line %u\n", path, line);
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+
+			sgetspace(f);
+
+			ret = sgetlasttok(f, tmp, sizeof(tmp));
+			if (ret < 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("Invalid 'advise' mode specification in '%s' at line %u\n", path, line);
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+
+			mode = advise_mode(tmp);
+			if (mode < 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("Invalid 'advise' mode '%s' in '%s' at line %u\n", tmp, path, line);
+				log_fatal("Use one of: auto, none, sequential, flush, flush-window, discard, discard-window, direct\n");
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+
+			/* search for parity */
+			if (lev_config_scan(buffer, &level, 0) == 0) {
+				state->parity[level].file_mode = mode;
+			} else {
+				struct snapraid_disk* disk;
+
+				/* search the disk */
+				disk = 0;
+				for (i = state->disklist; i != 0; i = i->next) {
+					disk = i->data;
+					if (strcmp(disk->name, buffer) == 0)
+						break;
+				}
+				if (!i) {
+					/* LCOV_EXCL_START */
+					log_fatal("Missing disk advise '%s' at line %u\n", buffer, line);
+					log_fatal("The disk must be defined before its 'advise' option.\n");
+					exit(EXIT_FAILURE);
+					/* LCOV_EXCL_STOP */
+				}
+
+				disk->file_mode = mode;
+			}
 		} else if (strcmp(tag, "nohidden") == 0) {
 			state->filter_hidden = 1;
 		} else if (strcmp(tag, "exclude") == 0) {
@@ -1143,6 +1321,37 @@ void state_config(struct snapraid_state* state, const char* path, const char* co
 
 			/* convert to GB */
 			state->autosave *= GIGA;
+		} else if (strcmp(tag, "memorylimit") == 0) {
+			char* e;
+			uint64_t memorylimit;
+
+			ret = sgetlasttok(f, buffer, sizeof(buffer));
+			if (ret < 0) {
+				/* LCOV_EXCL_START */
+				log_fatal("Invalid 'memorylimit' specification in '%s' at line %u\n", path, line);
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+
+			if (!*buffer) {
+				/* LCOV_EXCL_START */
+				log_fatal("Empty 'memorylimit' specification in '%s' at line %u\n", path, line);
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+
+			memorylimit = strtoull(buffer, &e, 0);
+
+			/* no limit is set only omitting the option, and the multiply must not overflow */
+			if (!e || *e || buffer[0] == '-' || memorylimit == 0 || memorylimit > SIZE_MAX / MEBI) {
+				/* LCOV_EXCL_START */
+				log_fatal("Invalid 'memorylimit' specification in '%s' at line %u\n", path, line);
+				exit(EXIT_FAILURE);
+				/* LCOV_EXCL_STOP */
+			}
+
+			/* convert to MiB */
+			malloc_limit_set(memorylimit * MEBI);
 		} else if (tag[0] == 0) {
 			/* allow empty lines */
 		} else if (tag[0] == '#') {
@@ -1188,6 +1397,8 @@ void state_config(struct snapraid_state* state, const char* path, const char* co
 
 	state_config_check(state, path, filterlist_disk);
 
+	state_config_advise(state);
+
 	/* select the default hash */
 	if (state->opt.force_murmur3) {
 		state->besthash = HASH_MURMUR3;
@@ -1744,7 +1955,285 @@ static void decoding_error(const char* path, STREAM* f)
 	}
 }
 
-static void state_read_content(struct snapraid_state* state, const char* path, STREAM* f)
+/**
+ * Entry of the path index of the content file.
+ */
+struct content_index {
+	int type; /**< Record type. One of 'f', 'a', 's' or 'r'. */
+	uint32_t mapping; /**< Mapping index of the disk. */
+	char* sub; /**< Sub path of the record. */
+	int64_t offset; /**< Offset of the record in the content file. */
+};
+
+/**
+ * Compare the index entries by disk and path.
+ */
+static int content_index_compare(const void* void_a, const void* void_b)
+{
+	const struct content_index* a = void_a;
+	const struct content_index* b = void_b;
+
+	if (a->mapping < b->mapping)
+		return -1;
+	if (a->mapping > b->mapping)
+		return 1;
+
+	return strcmp(a->sub, b->sub);
+}
+
+/**
+ * Size of the locator of the path index, stored just before the final 'N' and CRC.
+ * It's the 'T' char, with the offset of the info and of the index.
+ */
+#define CONTENT_LOCATOR_SIZE (1 + 8 + 8)
+
+/**
+ * Load of a part of the content file, using its path index.
+ *
+ * When the first record of a disk is found, the selected records
+ * are loaded jumping directly to them, then the info record is loaded,
+ * and the remaining part of the file is skipped.
+ */
+struct content_lookup {
+	int active; /**< If a partial load is in progress. */
+	int info_loaded; /**< If the info record was loaded. */
+	int64_t* offset_map; /**< Offsets of the selected records, in increasing order. */
+	unsigned offset_mac; /**< Number of selected records. */
+	unsigned offset_next; /**< Next selected record to load. */
+	int64_t info_offset; /**< Offset of the info record. */
+};
+
+/**
+ * Check if the filters can be resolved with the path index.
+ *
+ * This happens if all of them are inclusions of a path starting from the disk root.
+ * As any matching file starts with the non wildcard prefix of one of the filters,
+ * loading all the paths with such prefixes, loads all the ones selected.
+ */
+static int content_lookup_is_possible(tommy_list* filterlist)
+{
+	tommy_node* i;
+
+	/* case insensitive matches cannot use the sorted index */
+	if (FNM_CASEINSENSITIVE_FOR_WIN != 0)
+		return 0;
+
+	if (filterlist == 0 || tommy_list_empty(filterlist))
+		return 0;
+
+	for (i = tommy_list_head(filterlist); i != 0; i = i->next) {
+		struct snapraid_filter* filter = i->data;
+
+		if (filter->direction < 0 || !filter->is_path)
+			return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * Find the first index entry not less than the specified disk and path.
+ */
+static unsigned content_lookup_bound(struct content_index* index_map, unsigned index_mac, uint32_t mapping, const char* sub)
+{
+	unsigned lo = 0;
+	unsigned hi = index_mac;
+
+	while (lo < hi) {
+		unsigned mid = lo + (hi - lo) / 2;
+
+		if (index_map[mid].mapping < mapping
+			|| (index_map[mid].mapping == mapping && strcmp(index_map[mid].sub, sub) < 0))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static int content_lookup_offset_compare(const void* void_a, const void* void_b)
+{
+	const int64_t* a = void_a;
+	const int64_t* b = void_b;
+
+	if (*a < *b)
+		return -1;
+	if (*a > *b)
+		return 1;
+	return 0;
+}
+
+/**
+ * Read the path index, and select the records to load.
+ */
+static void content_lookup_begin(struct content_lookup* lookup, tommy_list* filterlist, const char* path, STREAM* f)
+{
+	struct stat st;
+	struct content_index* index_map;
+	uint32_t index_mac;
+	uint64_t info_offset;
+	uint64_t index_offset;
+	unsigned char* selected;
+	unsigned k;
+	tommy_node* i;
+	int ret;
+
+	ret = fstat(shandle(f), &st);
+	if (ret != 0) {
+		/* LCOV_EXCL_START */
+		log_fatal("Error stating the content file '%s'. %s.\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+		/* LCOV_EXCL_STOP */
+	}
+
+	/* read the locator, just before the 'N' and the CRC */
+	if (st.st_size < CONTENT_LOCATOR_SIZE + 1 + 4
+		|| sseek(f, st.st_size - CONTENT_LOCATOR_SIZE - 1 - 4) != 0
+		|| sgetc(f) != 'T'
+		|| sgetble64(f, &info_offset) != 0
+		|| sgetble64(f, &index_offset) != 0
+		|| info_offset >= index_offset
+		|| index_offset >= (uint64_t)st.st_size
+	) {
+		/* LCOV_EXCL_START */
+		decoding_error(path, f);
+		log_fatal("Invalid path index locator!\n");
+		os_abort();
+		/* LCOV_EXCL_STOP */
+	}
+
+	/* read the index */
+	if (sseek(f, index_offset) != 0
+		|| sgetc(f) != 'X'
+		|| sgetb32(f, &index_mac) != 0
+	) {
+		/* LCOV_EXCL_START */
+		decoding_error(path, f);
+		log_fatal("Invalid path index!\n");
+		os_abort();
+		/* LCOV_EXCL_STOP */
+	}
+
+	index_map = malloc_nofail((index_mac + 1) * sizeof(struct content_index)); /* +1 to never allocate zero bytes */
+	for (k = 0; k < index_mac; ++k) {
+		char sub[PATH_MAX];
+		uint64_t v_offset;
+		int c;
+
+		c = sgetc(f);
+		if (c == EOF
+			|| sgetb32(f, &index_map[k].mapping) != 0
+			|| sgetbs(f, sub, sizeof(sub)) < 0
+			|| sgetb64(f, &v_offset) != 0
+			|| v_offset >= info_offset
+		) {
+			/* LCOV_EXCL_START */
+			decoding_error(path, f);
+			log_fatal("Invalid path index entry!\n");
+			os_abort();
+			/* LCOV_EXCL_STOP */
+		}
+
+		index_map[k].type = c;
+		index_map[k].sub = strdup_nofail(sub);
+		index_map[k].offset = v_offset;
+
+		/* the search requires the index sorted */
+		if (k > 0 && content_index_compare(&index_map[k - 1], &index_map[k]) > 0) {
+			/* LCOV_EXCL_START */
+			decoding_error(path, f);
+			log_fatal("Unsorted path index!\n");
+			os_abort();
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	/* select the records starting with the prefix of any filter, in any disk */
+	selected = calloc_nofail(index_mac + 1, 1);
+	for (i = tommy_list_head(filterlist); i != 0; i = i->next) {
+		struct snapraid_filter* filter = i->data;
+		char prefix[PATH_MAX];
+		size_t len;
+		uint32_t mapping;
+
+		/* skip initial slash, as always missing from the path */
+		len = strcspn(filter->pattern + 1, "*?[\\");
+		memcpy(prefix, filter->pattern + 1, len);
+		prefix[len] = 0;
+
+		mapping = 0;
+		while (1) {
+			k = content_lookup_bound(index_map, index_mac, mapping, prefix);
+			if (k == index_mac)
+				break;
+
+			/* if no match in this disk, search in the next one present */
+			if (index_map[k].mapping != mapping) {
+				mapping = index_map[k].mapping;
+				continue;
+			}
+
+			while (k < index_mac
+				&& index_map[k].mapping == mapping
+				&& strncmp(index_map[k].sub, prefix, len) == 0
+			) {
+				selected[k] = 1;
+				++k;
+			}
+
+			++mapping;
+		}
+	}
+
+	/* sort the offsets to read the file in order */
+	lookup->offset_map = malloc_nofail((index_mac + 1) * sizeof(int64_t));
+	lookup->offset_mac = 0;
+	for (k = 0; k < index_mac; ++k) {
+		if (selected[k])
+			lookup->offset_map[lookup->offset_mac++] = index_map[k].offset;
+		free(index_map[k].sub);
+	}
+	qsort(lookup->offset_map, lookup->offset_mac, sizeof(int64_t), content_lookup_offset_compare);
+
+	free(selected);
+	free(index_map);
+
+	lookup->active = 1;
+	lookup->info_loaded = 0;
+	lookup->offset_next = 0;
+	lookup->info_offset = info_offset;
+}
+
+/**
+ * Move to the next selected record.
+ * Return 0 if there are other records to load.
+ */
+static int content_lookup_next(struct content_lookup* lookup, const char* path, STREAM* f)
+{
+	int64_t offset;
+
+	if (lookup->offset_next < lookup->offset_mac) {
+		offset = lookup->offset_map[lookup->offset_next++];
+	} else if (!lookup->info_loaded) {
+		offset = lookup->info_offset;
+		lookup->info_loaded = 1;
+	} else {
+		/* all done, skip the remaining part of the file */
+		return -1;
+	}
+
+	if (sseek(f, offset) != 0) {
+		/* LCOV_EXCL_START */
+		log_fatal("Error seeking the content file '%s' at offset %" PRIi64 "\n", path, offset);
+		exit(EXIT_FAILURE);
+		/* LCOV_EXCL_STOP */
+	}
+
+	return 0;
+}
+
+static void state_read_content(struct snapraid_state* state, const char* path, STREAM* f, tommy_list* filterlist)
 {
 	block_off_t blockmax;
 	unsigned count_file;
@@ -1756,6 +2245,10 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 	int ret;
 	tommy_array disk_mapping;
 	uint32_t mapping_max;
+	int has_index;
+	int64_t info_offset;
+	int64_t index_offset;
+	struct content_lookup lookup;
 
 	blockmax = 0;
 	count_file = 0;
@@ -1764,6 +2257,10 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 	count_dir = 0;
 	crc_checked = 0;
 	mapping_max = 0;
+	info_offset = -1;
+	index_offset = -1;
+	lookup.active = 0;
+	lookup.offset_map = 0;
 	tommy_array_init(&disk_mapping);
 
 	ret = sread(f, buffer, 12);
@@ -1784,10 +2281,12 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 	 *  - SNAPCNT3/SnapRAID 11.0 Adds entry 'y' for hash size.
 	 *  - SNAPCNT3/SnapRAID 11.0 Adds entry 'Q' for multi parity file.
 	 *    The previous 'P' entry is now deprecated, but supported for importing.
+	 *  - SNAPCNT4/SnapRAID 12.0 Adds entries 'X' and 'T' for the path index.
 	 */
 	if (memcmp(buffer, "SNAPCNT1\n\3\0\0", 12) != 0
 		&& memcmp(buffer, "SNAPCNT2\n\3\0\0", 12) != 0
 		&& memcmp(buffer, "SNAPCNT3\n\3\0\0", 12) != 0
+		&& memcmp(buffer, "SNAPCNT4\n\3\0\0", 12) != 0
 	) {
 		/* LCOV_EXCL_START */
 		if (memcmp(buffer, "SNAPCNT", 7) != 0) {
@@ -1801,15 +2300,32 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 		/* LCOV_EXCL_STOP */
 	}
 
+	/* only the new format has the path index to load a part of the file */
+	has_index = memcmp(buffer, "SNAPCNT4\n\3\0\0", 12) == 0;
+	if (!has_index || !content_lookup_is_possible(filterlist))
+		filterlist = 0;
+
 	while (1) {
 		int c;
 
+		/* in a partial load, jump to the next selected record */
+		if (lookup.active && content_lookup_next(&lookup, path, f) != 0)
+			break;
+
 		/* read the command */
 		c = sgetc(f);
 		if (c == EOF) {
 			break;
 		}
 
+		/* at the first record of the disks, select the ones to load */
+		if (filterlist != 0 && !lookup.active
+			&& (c == 'f' || c == 'a' || c == 's' || c == 'r' || c == 'h' || c == 'i')
+		) {
+			content_lookup_begin(&lookup, filterlist, path, f);
+			continue;
+		}
+
 		if (c == 'f') {
 			/* file */
 			char sub[PATH_MAX];
@@ -1906,10 +2422,11 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 			file = file_alloc(state->block_size, sub, v_size, v_mtime_sec, v_mtime_nsec, v_inode, 0);
 
 			/* insert the file in the file containers */
-			tommy_hashdyn_insert(&disk->inodeset, &file->nodeset, file, file_inode_hash(file->inode));
-			tommy_hashdyn_insert(&disk->pathset, &file->pathset, file, file_path_hash(file->sub));
-			tommy_hashdyn_insert(&disk->stampset, &file->stampset, file, file_stamp_hash(file->size, file->mtime_sec, file->mtime_nsec));
+			tommy_hashlin_insert(&disk->inodeset, &file->nodeset, file, file_inode_hash(file->inode));
+			tommy_hashlin_insert(&disk->pathset, &file->pathset, file, file_path_hash(file->sub));
+			tommy_hashlin_insert(&disk->stampset, &file->stampset, file, file_stamp_hash(file->size, file->mtime_sec, file->mtime_nsec));
 			tommy_list_insert_tail(&disk->filelist, &file->nodelist, file);
+			fs_file_order_reset(disk);
 
 			/* read all the blocks */
 			v_idx = 0;
@@ -2043,6 +2560,8 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 			uint32_t v_pos;
 			uint32_t v_oldest;
 
+			info_offset = stell(f) - 1;
+
 			ret = sgetb32(f, &v_oldest);
 			if (ret < 0) {
 				/* LCOV_EXCL_START */
@@ -2109,6 +2628,9 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 					}
 
 					info = info_make(t + v_oldest, bad, rehash, justsynced);
+
+					/* step of the parity cycle */
+					info = info_set_cycle(info, flag >> 4);
 				} else {
 					info = 0;
 				}
@@ -2280,7 +2802,7 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 			slink = link_alloc(sub, linkto, FILE_IS_SYMLINK);
 
 			/* insert the link in the link containers */
-			tommy_hashdyn_insert(&disk->linkset, &slink->nodeset, slink, link_name_hash(slink->sub));
+			tommy_hashlin_insert(&disk->linkset, &slink->nodeset, slink, link_name_hash(slink->sub));
 			tommy_list_insert_tail(&disk->linklist, &slink->nodelist, slink);
 
 			/* stat */
@@ -2339,7 +2861,7 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 			slink = link_alloc(sub, linkto, FILE_IS_HARDLINK);
 
 			/* insert the link in the link containers */
-			tommy_hashdyn_insert(&disk->linkset, &slink->nodeset, slink, link_name_hash(slink->sub));
+			tommy_hashlin_insert(&disk->linkset, &slink->nodeset, slink, link_name_hash(slink->sub));
 			tommy_list_insert_tail(&disk->linklist, &slink->nodelist, slink);
 
 			/* stat */
@@ -2381,7 +2903,7 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 			dir = dir_alloc(sub);
 
 			/* insert the dir in the dir containers */
-			tommy_hashdyn_insert(&disk->dirset, &dir->nodeset, dir, dir_name_hash(dir->sub));
+			tommy_hashlin_insert(&disk->dirset, &dir->nodeset, dir, dir_name_hash(dir->sub));
 			tommy_list_insert_tail(&disk->dirlist, &dir->nodelist, dir);
 
 			/* stat */
@@ -2815,6 +3337,88 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 			}
 
 			crc_checked = 1;
+		} else if (c == 'X') {
+			/* path index, used only for partial loads */
+			uint32_t index_mac;
+			uint32_t k;
+
+			index_offset = stell(f) - 1;
+
+			ret = sgetb32(f, &index_mac);
+			if (ret < 0) {
+				/* LCOV_EXCL_START */
+				decoding_error(path, f);
+				os_abort();
+				/* LCOV_EXCL_STOP */
+			}
+
+			for (k = 0; k < index_mac; ++k) {
+				uint32_t v_mapping;
+				uint64_t v_offset;
+
+				c = sgetc(f);
+				if (c != 'f' && c != 'a' && c != 's' && c != 'r') {
+					/* LCOV_EXCL_START */
+					decoding_error(path, f);
+					log_fatal("Invalid path index type!\n");
+					os_abort();
+					/* LCOV_EXCL_STOP */
+				}
+
+				ret = sgetb32(f, &v_mapping);
+				if (ret < 0 || v_mapping >= mapping_max) {
+					/* LCOV_EXCL_START */
+					decoding_error(path, f);
+					log_fatal("Internal inconsistency in mapping index!\n");
+					os_abort();
+					/* LCOV_EXCL_STOP */
+				}
+
+				ret = sgetbs(f, buffer, sizeof(buffer));
+				if (ret < 0) {
+					/* LCOV_EXCL_START */
+					decoding_error(path, f);
+					os_abort();
+					/* LCOV_EXCL_STOP */
+				}
+
+				ret = sgetb64(f, &v_offset);
+				if (ret < 0 || (int64_t)v_offset >= info_offset) {
+					/* LCOV_EXCL_START */
+					decoding_error(path, f);
+					log_fatal("Internal inconsistency in path index offset!\n");
+					os_abort();
+					/* LCOV_EXCL_STOP */
+				}
+			}
+		} else if (c == 'T') {
+			/* position of the info and of the path index */
+			uint64_t v_info_offset;
+			uint64_t v_index_offset;
+
+			ret = sgetble64(f, &v_info_offset);
+			if (ret < 0) {
+				/* LCOV_EXCL_START */
+				decoding_error(path, f);
+				os_abort();
+				/* LCOV_EXCL_STOP */
+			}
+
+			ret = sgetble64(f, &v_index_offset);
+			if (ret < 0) {
+				/* LCOV_EXCL_START */
+				decoding_error(path, f);
+				os_abort();
+				/* LCOV_EXCL_STOP */
+			}
+
+			if ((int64_t)v_info_offset != info_offset || (int64_t)v_index_offset != index_offset) {
+				/* LCOV_EXCL_START */
+				decoding_error(path, f);
+				log_fatal("Internal inconsistency in path index locator!\n");
+				os_abort();
+				/* LCOV_EXCL_STOP */
+			}
 		} else {
 			/* LCOV_EXCL_START */
 			decoding_error(path, f);
@@ -2833,7 +3437,18 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 		/* LCOV_EXCL_STOP */
 	}
 
-	if (!crc_checked) {
+	/* in a partial load, the CRC and the parity size cannot be checked */
+	if (lookup.active) {
+		msg_verbose("%8u records loaded with the path index\n", lookup.offset_mac);
+		free(lookup.offset_map);
+
+		/* intentionally use log_fatal() instead of log_error() to give more visibility at the warning */
+		log_fatal("WARNING! The content file '%s' was loaded only in part, without verifying its CRC.\n", path);
+		log_fatal("If it's damaged, the reported files could be wrong. Run without path filters to verify it.\n");
+
+		/* the state cannot be written anymore */
+		state->partial_read = 1;
+	} else if (!crc_checked) {
 		/* LCOV_EXCL_START */
 		log_fatal("Finished reading '%s' without finding the CRC\n", path);
 		log_fatal("This content file is truncated or damaged! Use an alternate copy.\n");
@@ -2845,7 +3460,7 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 	state_fscheck(state, "after read");
 
 	/* check that the stored parity size matches the loaded state */
-	if (blockmax != parity_allocated_size(state)) {
+	if (!lookup.active && blockmax != parity_allocated_size(state)) {
 		/* LCOV_EXCL_START */
 		log_fatal("Internal inconsistency in parity size %u/%u in '%s' at offset %" PRIi64 "\n", blockmax, parity_allocated_size(state), path, stell(f));
 		if (state->opt.skip_content_check) {
@@ -2866,7 +3481,7 @@ static void state_read_content(struct snapraid_state* state, const char* path, S
 struct state_write_thread_context {
 	struct snapraid_state* state;
 #if HAVE_MT_WRITE
-	pthread_t thread;
+	struct thread_job job;
 #endif
 	/* input */
 	block_off_t blockmax;
@@ -2898,27 +3513,34 @@ static void* state_write_thread(void* arg)
 	block_off_t idx;
 	block_off_t begin;
 	unsigned l, s;
-	int version;
+	struct content_index* index_map;
+	unsigned index_max;
+	unsigned index_mac;
+	int64_t info_offset;
+	int64_t index_offset;
 
 	count_file = 0;
 	count_hardlink = 0;
 	count_symlink = 0;
 	count_dir = 0;
 
-	/* check what version to use */
-	version = 2;
-	for (l = 0; l < state->level; ++l) {
-		if (state->parity[l].split_mac > 1)
-			version = 3;
+	/* allocate the path index for all the files, links and dirs */
+	index_max = 0;
+	for (i = state->disklist; i != 0; i = i->next) {
+		struct snapraid_disk* disk = i->data;
+
+		if (disk->mapping_idx < 0)
+			continue;
+
+		index_max += tommy_list_count(&disk->filelist);
+		index_max += tommy_list_count(&disk->linklist);
+		index_max += tommy_list_count(&disk->dirlist);
 	}
-	if (BLOCK_HASH_SIZE != 16)
-		version = 3;
+	index_map = malloc_nofail((index_max + 1) * sizeof(struct content_index)); /* +1 to never allocate zero bytes */
+	index_mac = 0;
 
 	/* write header */
-	if (version == 3)
-		swrite("SNAPCNT3\n\3\0\0", 12, f);
-	else
-		swrite("SNAPCNT2\n\3\0\0", 12, f);
+	swrite("SNAPCNT4\n\3\0\0", 12, f);
 
 	/* write block size and block max */
 	sputc('z', f);
@@ -2927,15 +3549,13 @@ static void* state_write_thread(void* arg)
 	sputb32(blockmax, f);
 
 	/* hash size */
-	if (version == 3) {
-		sputc('y', f);
-		sputb32(BLOCK_HASH_SIZE, f);
-	}
+	sputc('y', f);
+	sputb32(BLOCK_HASH_SIZE, f);
 
 	if (serror(f)) {
 		/* LCOV_EXCL_START */
 		log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
-		return context;
+		goto bail;
 		/* LCOV_EXCL_STOP */
 	}
 
@@ -2947,14 +3567,14 @@ static void* state_write_thread(void* arg)
 	} else {
 		/* LCOV_EXCL_START */
 		log_fatal("Unexpected hash when writing the content file '%s'.\n", serrorfile(f));
-		return context;
+		goto bail;
 		/* LCOV_EXCL_STOP */
 	}
 	swrite(state->hashseed, HASH_MAX, f);
 	if (serror(f)) {
 		/* LCOV_EXCL_START */
 		log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
-		return context;
+		goto bail;
 		/* LCOV_EXCL_STOP */
 	}
 
@@ -2970,14 +3590,14 @@ static void* state_write_thread(void* arg)
 			} else {
 				/* LCOV_EXCL_START */
 				log_fatal("Unexpected prevhash when writing the content file '%s'.\n", serrorfile(f));
-				return context;
+				goto bail;
 				/* LCOV_EXCL_STOP */
 			}
 			swrite(state->prevhashseed, HASH_MAX, f);
 			if (serror(f)) {
 				/* LCOV_EXCL_START */
 				log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
-				return context;
+				goto bail;
 				/* LCOV_EXCL_STOP */
 			}
 		}
@@ -2993,7 +3613,7 @@ static void* state_write_thread(void* arg)
 		if (!disk) {
 			/* LCOV_EXCL_START */
 			log_fatal("Internal inconsistency for unmapped disk '%s'\n", map->name);
-			return context;
+			goto bail;
 			/* LCOV_EXCL_STOP */
 		}
 
@@ -3008,7 +3628,7 @@ static void* state_write_thread(void* arg)
 			if (serror(f)) {
 				/* LCOV_EXCL_START */
 				log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
-				return context;
+				goto bail;
 				/* LCOV_EXCL_STOP */
 			}
 		}
@@ -3016,28 +3636,20 @@ static void* state_write_thread(void* arg)
 
 	/* for each parity */
 	for (l = 0; l < state->level; ++l) {
-		if (version == 3) {
-			sputc('Q', f);
-			sputb32(l, f);
-			sputb32(state->parity[l].total_blocks, f);
-			sputb32(state->parity[l].free_blocks, f);
-			sputb32(state->parity[l].split_mac, f);
-			for (s = 0; s < state->parity[l].split_mac; ++s) {
-				sputbs(state->parity[l].split_map[s].path, f);
-				sputbs(state->parity[l].split_map[s].uuid, f);
-				sputb64(state->parity[l].split_map[s].size, f);
-			}
-		} else {
-			sputc('P', f);
-			sputb32(l, f);
-			sputb32(state->parity[l].total_blocks, f);
-			sputb32(state->parity[l].free_blocks, f);
-			sputbs(state->parity[l].split_map[0].uuid, f);
+		sputc('Q', f);
+		sputb32(l, f);
+		sputb32(state->parity[l].total_blocks, f);
+		sputb32(state->parity[l].free_blocks, f);
+		sputb32(state->parity[l].split_mac, f);
+		for (s = 0; s < state->parity[l].split_mac; ++s) {
+			sputbs(state->parity[l].split_map[s].path, f);
+			sputbs(state->parity[l].split_map[s].uuid, f);
+			sputb64(state->parity[l].split_map[s].size, f);
 		}
 		if (serror(f)) {
 			/* LCOV_EXCL_START */
 			log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
-			return context;
+			goto bail;
 			/* LCOV_EXCL_STOP */
 		}
 	}
@@ -3064,6 +3676,12 @@ static void* state_write_thread(void* arg)
 			mtime_nsec = file->mtime_nsec;
 			inode = file->inode;
 
+			index_map[index_mac].type = 'f';
+			index_map[index_mac].mapping = disk->mapping_idx;
+			index_map[index_mac].sub = file->sub;
+			index_map[index_mac].offset = stell(f);
+			++index_mac;
+
 			sputc('f', f);
 			sputb32(disk->mapping_idx, f);
 			sputb64(size, f);
@@ -3078,7 +3696,7 @@ static void* state_write_thread(void* arg)
 			if (serror(f)) {
 				/* LCOV_EXCL_START */
 				log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
-				return context;
+				goto bail;
 				/* LCOV_EXCL_STOP */
 			}
 
@@ -3114,7 +3732,7 @@ static void* state_write_thread(void* arg)
 				default :
 					/* LCOV_EXCL_START */
 					log_fatal("Internal inconsistency in state for block %u state %u\n", v_pos, v_state);
-					return context;
+					goto bail;
 					/* LCOV_EXCL_STOP */
 				}
 
@@ -3133,7 +3751,7 @@ static void* state_write_thread(void* arg)
 				if (serror(f)) {
 					/* LCOV_EXCL_START */
 					log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
-					return context;
+					goto bail;
 					/* LCOV_EXCL_STOP */
 				}
 
@@ -3148,24 +3766,32 @@ static void* state_write_thread(void* arg)
 		for (j = disk->linklist; j != 0; j = j->next) {
 			struct snapraid_link* slink = j->data;
 
+			index_map[index_mac].mapping = disk->mapping_idx;
+			index_map[index_mac].sub = slink->sub;
+			index_map[index_mac].offset = stell(f);
+
 			switch (link_flag_get(slink, FILE_IS_LINK_MASK)) {
 			case FILE_IS_HARDLINK :
 				sputc('a', f);
+				index_map[index_mac].type = 'a';
 				++count_hardlink;
 				break;
 			case FILE_IS_SYMLINK :
 				sputc('s', f);
+				index_map[index_mac].type = 's';
 				++count_symlink;
 				break;
 			}
 
+			++index_mac;
+
 			sputb32(disk->mapping_idx, f);
 			sputbs(slink->sub, f);
 			sputbs(slink->linkto, f);
 			if (serror(f)) {
 				/* LCOV_EXCL_START */
 				log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
-				return context;
+				goto bail;
 				/* LCOV_EXCL_STOP */
 			}
 		}
@@ -3174,13 +3800,19 @@ static void* state_write_thread(void* arg)
 		for (j = disk->dirlist; j != 0; j = j->next) {
 			struct snapraid_dir* dir = j->data;
 
+			index_map[index_mac].type = 'r';
+			index_map[index_mac].mapping = disk->mapping_idx;
+			index_map[index_mac].sub = dir->sub;
+			index_map[index_mac].offset = stell(f);
+			++index_mac;
+
 			sputc('r', f);
 			sputb32(disk->mapping_idx, f);
 			sputbs(dir->sub, f);
 			if (serror(f)) {
 				/* LCOV_EXCL_START */
 				log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
-				return context;
+				goto bail;
 				/* LCOV_EXCL_STOP */
 			}
 
@@ -3193,7 +3825,7 @@ static void* state_write_thread(void* arg)
 		if (serror(f)) {
 			/* LCOV_EXCL_START */
 			log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
-			return context;
+			goto bail;
 			/* LCOV_EXCL_STOP */
 		}
 		begin = 0;
@@ -3237,13 +3869,14 @@ static void* state_write_thread(void* arg)
 			if (serror(f)) {
 				/* LCOV_EXCL_START */
 				log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
-				return context;
+				goto bail;
 				/* LCOV_EXCL_STOP */
 			}
 		}
 	}
 
 	/* write the info for each block */
+	info_offset = stell(f);
 	sputc('i', f);
 	sputb32(info_oldest, f);
 	begin = 0;
@@ -3275,6 +3908,7 @@ static void* state_write_thread(void* arg)
 				flag |= 4;
 			if (info_get_justsynced(info))
 				flag |= 8;
+			flag |= info_get_cycle(info) << 4;
 			sputb32(flag, f);
 
 			t = info_get_time(info) - info_oldest;
@@ -3287,7 +3921,7 @@ static void* state_write_thread(void* arg)
 		if (serror(f)) {
 			/* LCOV_EXCL_START */
 			log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
-			return context;
+			goto bail;
 			/* LCOV_EXCL_STOP */
 		}
 
@@ -3295,6 +3929,33 @@ static void* state_write_thread(void* arg)
 		begin = end;
 	}
 
+	/* write the path index, sorted by disk and path */
+	qsort(index_map, index_mac, sizeof(struct content_index), content_index_compare);
+
+	index_offset = stell(f);
+	sputc('X', f);
+	sputb32(index_mac, f);
+	for (idx = 0; idx < index_mac; ++idx) {
+		sputc(index_map[idx].type, f);
+		sputb32(index_map[idx].mapping, f);
+		sputbs(index_map[idx].sub, f);
+		sputb64(index_map[idx].offset, f);
+		if (serror(f)) {
+			/* LCOV_EXCL_START */
+			log_fatal("Error writing the content file '%s'. %s.\n", serrorfile(f), strerror(errno));
+			goto bail;
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	free(index_map);
+
+	/* write the position of the info and of the index, with a fixed size */
+	/* to allow to find them from the end of the file */
+	sputc('T', f);
+	sputble64(info_offset, f);
+	sputble64(index_offset, f);
+
 	sputc('N', f);
 
 	/* flush data written to the disk */
@@ -3335,6 +3996,12 @@ static void* state_write_thread(void* arg)
 	context->count_dir = count_dir;
 
 	return 0;
+
+bail:
+	/* LCOV_EXCL_START */
+	free(index_map);
+	return context;
+	/* LCOV_EXCL_STOP */
 }
 
 static void state_write_content(struct snapraid_state* state, uint32_t* out_crc)
@@ -3452,7 +4119,7 @@ static void state_write_content(struct snapraid_state* state, uint32_t* out_crc)
 		context->info_has_rehash = info_has_rehash;
 		context->f = f;
 
-		thread_create(&context->thread, 0, state_write_thread, context);
+		thread_pool_run(&context->job, 1, state_write_thread, context);
 
 		i = i->next;
 	}
@@ -3471,7 +4138,7 @@ static void state_write_content(struct snapraid_state* state, uint32_t* out_crc)
 		struct state_write_thread_context* context = content->context;
 		void* retval;
 
-		thread_join(context->thread, &retval);
+		thread_pool_join(&context->job, &retval);
 
 		if (retval) {
 			/* LCOV_EXCL_START */
@@ -3632,7 +4299,10 @@ static void state_write_content(struct snapraid_state* state, uint32_t* out_crc)
 	*out_crc = crc;
 }
 
-void state_read(struct snapraid_state* state)
+/**
+ * Read the state, loading only the paths selected by the filters if possible.
+ */
+static void state_read_filter(struct snapraid_state* state, tommy_list* filterlist)
 {
 	STREAM* f;
 	char path[PATH_MAX];
@@ -3641,6 +4311,8 @@ void state_read(struct snapraid_state* state)
 	int ret;
 	int c;
 
+	profile_begin("read");
+
 	/* iterate over all the available content files and load the first one present */
 	f = 0;
 	node = tommy_list_head(&state->contentlist);
@@ -3686,6 +4358,7 @@ void state_read(struct snapraid_state* state)
 
 		/* create the initial mapping */
 		state_map(state);
+		profile_end();
 		return;
 	}
 
@@ -3750,7 +4423,7 @@ void state_read(struct snapraid_state* state)
 
 	/* guess the file type from the first char */
 	if (c == 'S') {
-		state_read_content(state, path, f);
+		state_read_content(state, path, f, filterlist);
 	} else {
 		/* LCOV_EXCL_START */
 		log_fatal("From SnapRAID v9.0 the text content file is not supported anymore.\n");
@@ -3778,13 +4451,25 @@ void state_read(struct snapraid_state* state)
 
 	/* mark that we read the content file, and it passed all the checks */
 	state->checked_read = 1;
+
+	profile_end();
+}
+
+void state_read(struct snapraid_state* state)
+{
+	state_read_filter(state, 0);
+}
+
+void state_read_lookup(struct snapraid_state* state, tommy_list* filterlist_file)
+{
+	state_read_filter(state, filterlist_file);
 }
 
 struct state_verify_thread_context {
 	struct snapraid_state* state;
 	struct snapraid_content* content;
 #if HAVE_MT_VERIFY
-	pthread_t thread;
+	struct thread_job job;
 #else
 	void* retval;
 #endif
@@ -3870,7 +4555,7 @@ static void state_verify_content(struct snapraid_state* state, uint32_t crc)
 		context->f = f;
 
 #if HAVE_MT_VERIFY
-		thread_create(&context->thread, 0, state_verify_thread, context);
+		thread_pool_run(&context->job, 1, state_verify_thread, context);
 #else
 		context->retval = state_verify_thread(context);
 #endif
@@ -3887,7 +4572,7 @@ static void state_verify_content(struct snapraid_state* state, uint32_t crc)
 		void* retval;
 
 #if HAVE_MT_VERIFY
-		thread_join(context->thread, &retval);
+		thread_pool_join(&context->job, &retval);
 #else
 		retval = context->retval;
 #endif
@@ -3945,14 +4630,31 @@ void state_write(struct snapraid_state* state)
 {
 	uint32_t crc;
 
+	if (state->partial_read) {
+		/* LCOV_EXCL_START */
+		log_fatal("Internal inconsistency writing a partially loaded state\n");
+		os_abort();
+		/* LCOV_EXCL_STOP */
+	}
+
+	profile_begin("content");
+
 	/* write all the content files */
+	profile_begin("write");
 	state_write_content(state, &crc);
+	profile_end();
 
 	/* verify the just written files */
+	profile_begin("verify");
 	state_verify_content(state, crc);
+	profile_end();
 
 	/* rename the new files, over the old ones */
+	profile_begin("rename");
 	state_rename_content(state);
+	profile_end();
+
+	profile_end();
 
 	state->need_write = 0; /* no write needed anymore */
 	state->checked_read = 0; /* what we wrote is not checked in read */
@@ -4018,14 +4720,18 @@ void state_filter(struct snapraid_state* state, tommy_list* filterlist_file, tom
 	for (i = state->disklist; i != 0; i = i->next) {
 		tommy_node* j;
 		struct snapraid_disk* disk = i->data;
+		struct snapraid_file** file_map;
+		unsigned file_count;
+		unsigned k;
 
 		/* if we filter for presence, we have to access the disk, so better to print something */
 		if (filter_missing)
 			msg_progress("Scanning disk %s...\n", disk->name);
 
-		/* for each file */
-		for (j = tommy_list_head(&disk->filelist); j != 0; j = j->next) {
-			struct snapraid_file* file = j->data;
+		/* for each file, in directory order */
+		file_map = fs_file_order(disk, &file_count);
+		for (k = 0; k < file_count; ++k) {
+			struct snapraid_file* file = file_map[k];
 
 			if (filter_path(filterlist_disk, 0, disk->name, file->sub) != 0
 				|| filter_path(filterlist_file, 0, disk->name, file->sub) != 0
@@ -4082,6 +4788,38 @@ void state_filter(struct snapraid_state* state, tommy_list* filterlist_file, tom
 	}
 }
 
+void state_priority(struct snapraid_state* state, tommy_list* filterlist_priority)
+{
+	tommy_node* i;
+
+	/* if no priority, nothing to do */
+	if (tommy_list_empty(filterlist_priority))
+		return;
+
+	for (i = tommy_list_head(filterlist_priority); i != 0; i = i->next) {
+		struct snapraid_filter* filter = i->data;
+		msg_verbose("\tpriority %s%s\n", filter->pattern, filter->is_dir ? "/" : "");
+	}
+
+	/* for each disk */
+	for (i = state->disklist; i != 0; i = i->next) {
+		tommy_node* j;
+		struct snapraid_disk* disk = i->data;
+
+		/* for each file */
+		for (j = tommy_list_head(&disk->filelist); j != 0; j = j->next) {
+			struct snapraid_file* file = j->data;
+
+			/* excluded files are not processed at all */
+			if (file_flag_has(file, FILE_IS_EXCLUDED))
+				continue;
+
+			if (filter_path(filterlist_priority, 0, disk->name, file->sub) == 0)
+				file_flag_set(file, FILE_IS_PRIORITY);
+		}
+	}
+}
+
 int state_progress_begin(struct snapraid_state* state, block_off_t blockstart, block_off_t blockmax, block_off_t countmax)
 {
 	time_t now;
@@ -4588,10 +5326,38 @@ void state_usage_print(struct snapraid_state* state)
 	state_progress_graph(state, 0, state->progress_ptr, PROGRESS_MAX);
 }
 
+void state_memory(struct snapraid_state* state, int print)
+{
+	int tag;
+
+	(void)state;
+
+	for (tag = 0; tag < MALLOC_MAX; ++tag)
+		log_tag("memusage:%s:%" PRIu64 "\n", malloc_tag_name(tag), (uint64_t)malloc_counter_tag_get(tag));
+	log_tag("memusage:limit:%" PRIu64 "\n", (uint64_t)malloc_limit_get());
+
+	if (!print)
+		return;
+
+	printf("\n");
+	printf("Memory usage in MiB:\n");
+	printf("\n");
+	for (tag = 0; tag < MALLOC_MAX; ++tag)
+		printf("%8.1f %s\n", (double)malloc_counter_tag_get(tag) / MEBI, malloc_tag_name(tag));
+	printf(" --------------\n");
+	printf("%8.1f total", (double)malloc_counter_get() / MEBI);
+	if (malloc_limit_get() != 0)
+		printf(" of a limit of %u", (unsigned)(malloc_limit_get() / MEBI));
+	printf("\n");
+	printf("\n");
+}
+
 void state_fscheck(struct snapraid_state* state, const char* ope)
 {
 	tommy_node* i;
 
+	profile_begin("fscheck");
+
 	/* check the file-system on all disks */
 	for (i = state->disklist; i != 0; i = i->next) {
 		struct snapraid_disk* disk = i->data;
@@ -4603,6 +5369,8 @@ void state_fscheck(struct snapraid_state* state, const char* ope)
 			/* LCOV_EXCL_STOP */
 		}
 	}
+
+	profile_end();
 }
 
 void generate_configuration(const char* path)
@@ -4686,4 +5454,3 @@ void generate_configuration(const char* path)
 
 	state_done(&state);
 }
-
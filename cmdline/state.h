@@ -73,9 +73,19 @@ extern volatile int global_interrupt;
 struct snapraid_option {
 	int gui; /**< Gui output. */
 	int auditonly; /**< In check, checks only the hash and not the parity. */
+	int quick; /**< In check and fix, reads only the parity needed to recover. */
+	unsigned thread_max; /**< Max number of computing threads running at the same time. 0 for no limit. */
+	unsigned hedge_wait; /**< In scrub, milliseconds to wait a data read before recovering it from parity. 0 to always wait. */
+	int risk; /**< In scrub, weight the age of the blocks with the risk of failure of the disks. */
+	unsigned parity_cycle; /**< In scrub, number of scrubs to verify all the parity levels in rotation. 0 or 1 to verify all of them at every scrub. */
+	int estimate; /**< In sync and scrub, only estimates the duration without processing. */
+	int export_format; /**< In list and diff, output format for other programs. One of EXPORT_*. */
+	block_off_t defrag; /**< In sync, max number of blocks of fragmented files to relocate. 0 to disable. */
+	int compact; /**< In sync, moves the blocks at the end of the parity in the free positions, and shrinks it. */
 	int badonly; /**< In fix, fixes only the blocks marked as bad. */
 	int syncedonly; /**< In fix, fixes only files that are synced. */
 	int prehash; /**< Enables the prehash mode for sync. */
+	data_off_t scan_hash; /**< In sync, max size of the new files hashed already in the scan. 0 to disable. */
 	unsigned io_error_limit; /**< Max number of input/output errors before aborting. */
 	int force_zero; /**< Forced dangerous operations of syncing files now with zero size. */
 	int force_empty; /**< Forced dangerous operations of syncing disks now empty. */
@@ -84,6 +94,7 @@ struct snapraid_option {
 	int force_nocopy; /**< Force dangerous operations of syncing files without using copy detection. */
 	int force_full; /**< Force a full parity update. */
 	int force_realloc; /**< Force a full reallocation and parity update. */
+	int force_new_parity; /**< Force the computation of only the new parity levels. */
 	int expect_unrecoverable; /**< Expect presence of unrecoverable error in checking or fixing. */
 	int expect_recoverable; /**< Expect presence of recoverable error in checking. */
 	int skip_device; /**< Skip devices matching checks. */
@@ -91,6 +102,7 @@ struct snapraid_option {
 	int skip_fallocate; /**< Skip the use of fallocate(). */
 	int skip_space_holder; /**< Skip the use of spaceholder file. */
 	int file_mode; /**< File mode. Mask of ADVISE_* flags. */
+	int direct_io; /**< If the command allows the ADVISE_DIRECT mode. */
 	int skip_lock; /**< Skip the lock file protection. */
 	int skip_self; /**< Skip the self-test. */
 	int skip_content_check; /**< Relax some content file checks. */
@@ -115,6 +127,7 @@ struct snapraid_option {
 	int match_first_uuid; /**< Force the matching of the first UUID. */
 	int force_parity_update; /**< Force parity update even if data is not changed. */
 	unsigned io_cache; /**< Number of IO buffers to use. 0 for default. */
+	unsigned io_slow; /**< Delay in milliseconds of the reads of the first data disk. */
 	int auto_conf; /**< Allow to run without configuration file. */
 	int force_stats; /**< Force stats print during process. */
 	uint64_t parity_limit_size; /**< Test limit for parity files. */
@@ -126,9 +139,11 @@ struct snapraid_state {
 	uint64_t autosave; /**< Autosave after the specified amount of data. 0 to disable. */
 	int need_write; /**< If the state is changed. */
 	int checked_read; /**< If the state was read and checked. */
+	int partial_read; /**< If the state was read only in part, using the path index. It cannot be written. */
 	uint32_t block_size; /**< Block size in bytes. */
 	unsigned raid_mode; /**< Raid mode to use. RAID_MODE_DEFAULT or RAID_MODE_ALTERNATE. */
-	int file_mode; /**< File access mode. Combination of ADVISE_* flags. */
+	int file_mode; /**< Default file access mode. One of ADVISE_*. Each disk and parity has its own. */
+	int direct_mode; /**< If at least one disk or parity uses the ADVISE_DIRECT mode. */
 	struct snapraid_parity parity[LEV_MAX]; /**< Parity vector. */
 	char share[PATH_MAX]; /**< Path of the share tree. If !=0 pool links are created in a different way. */
 	char pool[PATH_MAX]; /**< Path of the pool tree. */
@@ -136,19 +151,21 @@ struct snapraid_state {
 	unsigned char hashseed[HASH_MAX]; /**< Hash seed. Just after a uint64 to provide a minimal alignment. */
 	unsigned char prevhashseed[HASH_MAX]; /**< Previous hash seed. In case of rehash. */
 	char lockfile[PATH_MAX]; /**< Path of the lock file to use. */
+	char perffile[PATH_MAX]; /**< Path of the performance history file to use. */
 	unsigned level; /**< Number of parity levels. 1 for PAR1, 2 for PAR2. */
 	unsigned hash; /**< Hash kind used. */
 	unsigned prevhash; /**< Previous hash kind used.  In case of rehash. */
 	unsigned besthash; /**< Best hash suggested. */
+	struct snapraid_zerohash zerohash; /**< Cache of the hashes of zero blocks. */
 	const char* command; /**< Command running. */
 	tommy_list contentlist; /**< List of content files. */
 	tommy_list disklist; /**< List of all the disks. */
 	tommy_list maplist; /**< List of all the disk mappings. */
 	tommy_list filterlist; /**< List of inclusion/exclusion. */
 	tommy_list importlist; /**< List of import file. */
-	tommy_hashdyn importset; /**< Hashtable by hash of all the import blocks. */
-	tommy_hashdyn previmportset; /**< Hashtable by prevhash of all the import blocks. Valid only if we are in a rehash state. */
-	tommy_hashdyn searchset; /**< Hashtable by timestamp of all the search files. */
+	tommy_hashlin importset; /**< Hashtable by hash of all the import blocks. */
+	tommy_hashlin previmportset; /**< Hashtable by prevhash of all the import blocks. Valid only if we are in a rehash state. */
+	tommy_hashlin searchset; /**< Hashtable by timestamp of all the search files. */
 	tommy_arrayblkof infoarr; /**< Block information array. */
 
 	/**
@@ -169,6 +186,12 @@ struct snapraid_state {
 	 */
 	uint64_t tick_last;
 
+	/**
+	 * Start of the run measured for the performance history.
+	 */
+	uint64_t perf_tick;
+	uint64_t perf_ms;
+
 	int clear_past_hash; /**< Clear all the hash from CHG and DELETED blocks when reading the state from an incomplete sync. */
 
 	time_t progress_whole_start; /**< Initial start of the whole process. */
@@ -210,6 +233,14 @@ void state_config(struct snapraid_state* state, const char* path, const char* co
  */
 void state_read(struct snapraid_state* state);
 
+/**
+ * Read the state, loading only the files, links and dirs selected by the filters.
+ * The path index of the content file is used to read only the selected records.
+ * If the filters cannot be resolved with the index, the whole state is read.
+ * A state read only in part cannot be written.
+ */
+void state_read_lookup(struct snapraid_state* state, tommy_list* filterlist_file);
+
 /**
  * Write the new state.
  */
@@ -221,9 +252,11 @@ void state_write(struct snapraid_state* state);
 int state_diff(struct snapraid_state* state);
 
 /**
- * Scan all the disks to update the state.
+ * Scan the disks to update the state.
+ * If the disk filter is not empty, only the selected data disks are scanned,
+ * and the stored state of the others is trusted as it is.
  */
-void state_scan(struct snapraid_state* state);
+void state_scan(struct snapraid_state* state, tommy_list* filterlist_disk);
 
 /**
  * Set the nanosecond timestamp of all files that have a zero value.
@@ -235,6 +268,32 @@ void state_touch(struct snapraid_state* state);
  */
 void state_device(struct snapraid_state* state, int operation, tommy_list* filterlist_disk);
 
+/**
+ * Relocate the most fragmented files in contiguous free parity positions.
+ * The parity of the affected positions is then updated by the sync.
+ */
+void state_defrag(struct snapraid_state* state);
+
+/**
+ * Move the blocks at the end of the parity in the free positions before.
+ * The blocks of the last position are kept, to keep the parity size
+ * until the moved blocks are synced.
+ */
+void state_compact(struct snapraid_state* state);
+
+/**
+ * Move also the blocks of the last position after the sync of the others.
+ * Return the number of blocks moved, that need a new sync.
+ */
+block_off_t state_compact_finish(struct snapraid_state* state);
+
+/**
+ * Compute the risk of failure of the data disks, to weight the scrub.
+ * It uses the Annual Failure Rate estimated from SMART, and the
+ * presence of bad blocks.
+ */
+void state_risk(struct snapraid_state* state);
+
 /**
  * Sync the parity data.
  */
@@ -270,6 +329,12 @@ void state_rehash(struct snapraid_state* state);
  */
 int state_scrub(struct snapraid_state* state, int plan, int olderthan);
 
+/**
+ * Retire a data disk, removing its data from the parity.
+ * The disk to retire is the only one selected by the disk filter.
+ */
+int state_retire(struct snapraid_state* state, tommy_list* filterlist_disk);
+
 /**
  * Print the status.
  */
@@ -309,6 +374,12 @@ void state_skip(struct snapraid_state* state);
  */
 void state_filter(struct snapraid_state* state, tommy_list* filterlist_file, tommy_list* filterlist_disk, int filter_missing, int filter_error);
 
+/**
+ * Mark the files to process before the others.
+ * Only the files not excluded by filters and matching the priority list are marked.
+ */
+void state_priority(struct snapraid_state* state, tommy_list* filterlist_priority);
+
 /**
  * Begin the progress visualization.
  */
@@ -362,6 +433,34 @@ void state_usage_parity(struct snapraid_state* state, unsigned* waiting_map, uns
  */
 void state_usage_print(struct snapraid_state* state);
 
+/**
+ * Report the memory used by subsystem.
+ * It's always written in the log, and if print is set, also on the screen.
+ */
+void state_memory(struct snapraid_state* state, int print);
+
+/**
+ * Start the measure of the run for the performance history.
+ */
+void state_perf_begin(struct snapraid_state* state);
+
+/**
+ * End the measure of the run, and append it to the performance history.
+ */
+void state_perf_end(struct snapraid_state* state, const char* command);
+
+/**
+ * Estimate the duration of the command from the performance history.
+ * The work is computed from the positions enabled by the plan.
+ */
+void state_estimate(struct snapraid_state* state, const char* command, block_off_t blockstart, block_off_t blockmax, int (*block_is_enabled)(void*, block_off_t), void* arg);
+
+/**
+ * Report the disks slower than their usual performance in the latest runs,
+ * and the ones with IO errors or slow reads.
+ */
+void state_perf_slow(struct snapraid_state* state);
+
 /**
  * Check the file-system on all disks.
  * On error it aborts.
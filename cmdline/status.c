@@ -283,7 +283,7 @@ int state_status(struct snapraid_state* state)
 	log_flush();
 
 	/* copy the info a temp vector, and count bad/rehash/unsynced blocks */
-	timemap = malloc_nofail(blockmax * sizeof(time_t));
+	timemap = malloc_nofail_tag(blockmax * sizeof(time_t), MALLOC_MISC);
 	bad = 0;
 	bad_first = 0;
 	bad_last = 0;
@@ -358,7 +358,7 @@ int state_status(struct snapraid_state* state)
 
 	if (!count) {
 		log_fatal("The array is empty.\n");
-		free(timemap);
+		free_tag(timemap, blockmax * sizeof(time_t), MALLOC_MISC);
 		return 0;
 	}
 
@@ -523,8 +523,12 @@ int state_status(struct snapraid_state* state)
 		printf("No error detected.\n");
 	}
 
+	state_perf_slow(state);
+
 	/* free the temp vector */
-	free(timemap);
+	free_tag(timemap, blockmax * sizeof(time_t), MALLOC_MISC);
+
+	state_memory(state, 1);
 
 	return 0;
 }
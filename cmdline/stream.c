@@ -328,6 +328,36 @@ int64_t stell(STREAM* s)
 	return s->offset_uncached + (s->pos - s->buffer);
 }
 
+int sseek(STREAM* s, int64_t offset)
+{
+	if (s->state != STREAM_STATE_READ && s->state != STREAM_STATE_EOF) {
+		/* LCOV_EXCL_START */
+		return EOF;
+		/* LCOV_EXCL_STOP */
+	}
+
+	/* if the position is already in the buffer, just move in it */
+	if (s->state == STREAM_STATE_READ && offset >= s->offset_uncached && offset < s->offset) {
+		s->pos = s->buffer + (offset - s->offset_uncached);
+		return 0;
+	}
+
+	if (lseek(s->handle[0].f, offset, SEEK_SET) != offset) {
+		/* LCOV_EXCL_START */
+		s->state = STREAM_STATE_ERROR;
+		return EOF;
+		/* LCOV_EXCL_STOP */
+	}
+
+	s->pos = s->buffer;
+	s->end = s->buffer;
+	s->state = STREAM_STATE_READ;
+	s->offset = offset;
+	s->offset_uncached = offset;
+
+	return 0;
+}
+
 uint32_t scrc(STREAM*s)
 {
 	return crc32c(s->crc_uncached, s->buffer, s->pos - s->buffer);
@@ -611,6 +641,24 @@ int sgetble32(STREAM* f, uint32_t* value)
 	return 0;
 }
 
+int sgetble64(STREAM* f, uint64_t* value)
+{
+	unsigned char buf[8];
+	unsigned i;
+
+	if (sread(f, buf, 8) != 0) {
+		/* LCOV_EXCL_START */
+		return -1;
+		/* LCOV_EXCL_STOP */
+	}
+
+	*value = 0;
+	for (i = 0; i < 8; ++i)
+		*value |= (uint64_t)buf[i] << (i * 8);
+
+	return 0;
+}
+
 int sgetbs(STREAM* f, char* str, int size)
 {
 	uint32_t len;
@@ -723,6 +771,17 @@ int sputble32(uint32_t value, STREAM* s)
 	return swrite(buf, 4, s);
 }
 
+int sputble64(uint64_t value, STREAM* s)
+{
+	unsigned char buf[8];
+	unsigned i;
+
+	for (i = 0; i < 8; ++i)
+		buf[i] = (value >> (i * 8)) & 0xFF;
+
+	return swrite(buf, 8, s);
+}
+
 int sputbs(const char* str, STREAM* f)
 {
 	size_t len = strlen(str);
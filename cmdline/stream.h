@@ -146,6 +146,13 @@ int sflush(STREAM* s);
  */
 int64_t stell(STREAM* s);
 
+/**
+ * Move the file pointer of a read stream. Like fseek() with SEEK_SET.
+ * After a seek the CRC of the processed data is not meaningful anymore.
+ * \return 0 on success, or EOF on error.
+ */
+int sseek(STREAM* s, int64_t offset);
+
 /**
  * Get the CRC of the processed data.
  */
@@ -332,6 +339,12 @@ int sgetb64(STREAM* f, uint64_t* value);
  */
 int sgetble32(STREAM* f, uint32_t* value);
 
+/**
+ * Read a binary 64 bit number in little endian format.
+ * Return <0 if there isn't enough to read.
+ */
+int sgetble64(STREAM* f, uint64_t* value);
+
 /**
  * Read a binary string.
  * Return -1 on error or if the buffer is too small, or the number of chars read.
@@ -406,6 +419,12 @@ int sputb64(uint64_t value, STREAM* s);
  */
 int sputble32(uint32_t value, STREAM* s);
 
+/**
+ * Write a binary 64 bit number in little endian format.
+ * Return 0 on success or -1 on error.
+ */
+int sputble64(uint64_t value, STREAM* s);
+
 /**
  * Write a binary string.
  * Return 0 on success or -1 on error.
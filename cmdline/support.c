@@ -973,6 +973,58 @@ int advise_flags(struct advise_struct* advise)
 	return flags;
 }
 
+/**
+ * Names of the advise modes, indexed by mode.
+ */
+static const char* ADVISE_NAME[] = {
+	"auto",
+	"none",
+	"sequential",
+	"flush",
+	"flush-window",
+	"discard",
+	"discard-window",
+	"direct"
+};
+
+int advise_mode(const char* name)
+{
+	int mode;
+
+	for (mode = ADVISE_DEFAULT; mode <= ADVISE_DIRECT; ++mode)
+		if (strcmp(ADVISE_NAME[mode], name) == 0)
+			return mode;
+
+	return -1;
+}
+
+const char* advise_name(int mode)
+{
+	if (mode < ADVISE_DEFAULT || mode > ADVISE_DIRECT)
+		return "unknown";
+
+	return ADVISE_NAME[mode];
+}
+
+int advise_direct_probe(const char* path)
+{
+#if HAVE_DIRECT_IO
+	int f;
+
+	/* some file-systems, like FUSE ones, refuse the direct mode */
+	f = open(path, O_RDONLY | O_BINARY | O_DIRECT);
+	if (f == -1)
+		return -1;
+
+	close(f);
+
+	return 0;
+#else
+	(void)path;
+	return -1;
+#endif
+}
+
 int advise_open(struct advise_struct* advise, int f)
 {
 	(void)advise;
@@ -1252,9 +1304,41 @@ int advise_read(struct advise_struct* advise, int f, data_off_t offset, data_off
 /* memory */
 
 /**
- * Total amount of memory allocated.
+ * Amount of memory allocated by subsystem.
+ */
+static size_t mcounter[MALLOC_MAX];
+
+/**
+ * Memory limit. 0 for no limit.
  */
-static size_t mcounter;
+static size_t mlimit;
+
+static const char* mname[MALLOC_MAX] = {
+	"misc",
+	"file",
+	"path",
+	"block",
+	"extent",
+	"import",
+	"buffer",
+	"hash",
+	"info",
+};
+
+/**
+ * Return the total amount of memory allocated.
+ * Call with lock_memory().
+ */
+static size_t malloc_counter_total(void)
+{
+	size_t total = 0;
+	int i;
+
+	for (i = 0; i < MALLOC_MAX; ++i)
+		total += mcounter[i];
+
+	return total;
+}
 
 size_t malloc_counter_get(void)
 {
@@ -1262,20 +1346,73 @@ size_t malloc_counter_get(void)
 
 	lock_memory();
 
-	ret = mcounter;
+	ret = malloc_counter_total();
+
+	unlock_memory();
+
+	return ret;
+}
+
+size_t malloc_counter_tag_get(int tag)
+{
+	size_t ret;
+
+	lock_memory();
+
+	ret = mcounter[tag];
+
+	unlock_memory();
+
+	return ret;
+}
+
+const char* malloc_tag_name(int tag)
+{
+	return mname[tag];
+}
+
+void malloc_limit_set(size_t limit)
+{
+	lock_memory();
+
+	mlimit = limit;
+
+	unlock_memory();
+}
+
+size_t malloc_limit_get(void)
+{
+	size_t ret;
+
+	lock_memory();
+
+	ret = mlimit;
 
 	unlock_memory();
 
 	return ret;
 }
 
-void malloc_counter_inc(size_t inc)
+size_t malloc_limit_avail(void)
 {
+	size_t total;
+	size_t ret;
+
 	lock_memory();
 
-	mcounter += inc;
+	if (!mlimit) {
+		ret = SIZE_MAX;
+	} else {
+		total = malloc_counter_total();
+		if (total < mlimit)
+			ret = mlimit - total;
+		else
+			ret = 0;
+	}
 
 	unlock_memory();
+
+	return ret;
 }
 
 /* LCOV_EXCL_START */
@@ -1308,6 +1445,59 @@ static ssize_t malloc_printn(int f, size_t value)
 }
 /* LCOV_EXCL_STOP */
 
+/* LCOV_EXCL_START */
+static void malloc_limit_fail(size_t size, int tag, size_t total, size_t limit)
+{
+	/* don't use printf for consistency with malloc_fail() */
+	int f = 2; /* stderr */
+
+	malloc_print(f, "Memory limit exceeded!\n");
+	malloc_print(f, "Allocating ");
+	malloc_printn(f, size);
+	malloc_print(f, " bytes for ");
+	malloc_print(f, mname[tag]);
+	malloc_print(f, ".\n");
+	malloc_print(f, "Already allocated ");
+	malloc_printn(f, total);
+	malloc_print(f, " bytes over a limit of ");
+	malloc_printn(f, limit / (1024 * 1024));
+	malloc_print(f, " MiB.\n");
+	malloc_print(f, "Increase the 'memorylimit' option in the configuration file,\n");
+	malloc_print(f, "or reduce the memory used with a bigger 'blocksize' or a smaller 'hashsize'.\n");
+}
+/* LCOV_EXCL_STOP */
+
+void malloc_counter_inc(size_t inc, int tag)
+{
+	size_t total;
+	size_t limit;
+
+	lock_memory();
+
+	total = malloc_counter_total();
+	limit = mlimit;
+
+	mcounter[tag] += inc;
+
+	unlock_memory();
+
+	if (limit != 0 && total + inc > limit) {
+		/* LCOV_EXCL_START */
+		malloc_limit_fail(inc, tag, total, limit);
+		exit(EXIT_FAILURE);
+		/* LCOV_EXCL_STOP */
+	}
+}
+
+void malloc_counter_dec(size_t dec, int tag)
+{
+	lock_memory();
+
+	mcounter[tag] -= dec;
+
+	unlock_memory();
+}
+
 /* LCOV_EXCL_START */
 void malloc_fail(size_t size)
 {
@@ -1328,9 +1518,19 @@ void malloc_fail(size_t size)
 }
 /* LCOV_EXCL_STOP */
 
+void* malloc_nofail_tag(size_t size, int tag)
+{
+	/* account before allocating, to stop before exceeding the limit */
+	malloc_counter_inc(size, tag);
+
+	return malloc_nofail(size);
+}
+
 void* malloc_nofail(size_t size)
 {
-	void* ptr = malloc(size);
+	void* ptr;
+
+	ptr = malloc(size);
 
 	if (!ptr) {
 		/* LCOV_EXCL_START */
@@ -1349,11 +1549,16 @@ void* malloc_nofail(size_t size)
 	memset(ptr, 0xA5, size);
 #endif
 
-	malloc_counter_inc(size);
-
 	return ptr;
 }
 
+void* calloc_nofail_tag(size_t count, size_t size, int tag)
+{
+	malloc_counter_inc(count * size, tag);
+
+	return calloc_nofail(count, size);
+}
+
 void* calloc_nofail(size_t count, size_t size)
 {
 	void* ptr;
@@ -1372,11 +1577,16 @@ void* calloc_nofail(size_t count, size_t size)
 
 	memset(ptr, 0, size);
 
-	malloc_counter_inc(size);
-
 	return ptr;
 }
 
+char* strdup_nofail_tag(const char* str, int tag)
+{
+	malloc_counter_inc(strlen(str) + 1, tag);
+
+	return strdup_nofail(str);
+}
+
 char* strdup_nofail(const char* str)
 {
 	size_t size;
@@ -1395,11 +1605,68 @@ char* strdup_nofail(const char* str)
 
 	memcpy(ptr, str, size);
 
-	malloc_counter_inc(size);
+	return ptr;
+}
+
+void free_tag(void* ptr, size_t size, int tag)
+{
+	if (!ptr)
+		return;
+
+	malloc_counter_dec(size, tag);
+
+	free(ptr);
+}
+
+/**
+ * Header stored before the memory allocated with malloc_nofail_sized().
+ * The union keeps the returned memory aligned like the one of malloc().
+ */
+union malloc_header {
+	struct {
+		size_t size;
+		int tag;
+	} info;
+	double align[2];
+};
+
+void* malloc_nofail_sized(size_t size, int tag)
+{
+	union malloc_header* header;
+
+	header = malloc_nofail_tag(sizeof(union malloc_header) + size, tag);
+
+	header->info.size = size;
+	header->info.tag = tag;
+
+	return header + 1;
+}
+
+void* calloc_nofail_sized(size_t count, size_t size, int tag)
+{
+	void* ptr;
+
+	size *= count;
+
+	ptr = malloc_nofail_sized(size, tag);
+
+	memset(ptr, 0, size);
 
 	return ptr;
 }
 
+void free_sized(void* ptr)
+{
+	union malloc_header* header;
+
+	if (!ptr)
+		return;
+
+	header = (union malloc_header*)ptr - 1;
+
+	free_tag(header, sizeof(union malloc_header) + header->info.size, header->info.tag);
+}
+
 /****************************************************************************/
 /* smartctl */
 
@@ -1535,6 +1802,197 @@ int smartctl_flush(FILE* f, const char* file, const char* name)
 	return 0;
 }
 
+/****************************************************************************/
+/* profile */
+
+#define PROFILE_MAX 64 /**< Max number of different phases. */
+#define PROFILE_DEPTH 8 /**< Max nesting of phases. */
+
+/**
+ * Resource usage at a given time.
+ */
+struct profile_stat {
+	uint64_t wall_ms;
+	uint64_t cpu_ms;
+	uint64_t read_bytes;
+	uint64_t write_bytes;
+	uint64_t peak_rss;
+};
+
+/**
+ * Accumulated resource usage of a phase.
+ */
+struct profile_phase {
+	char name[64]; /**< Full path of the phase. */
+	unsigned count; /**< Number of times the phase was run. */
+	struct profile_stat stat; /**< Accumulated usage, with peak_rss as max. */
+};
+
+static struct profile_phase profile_map[PROFILE_MAX];
+static unsigned profile_max;
+static struct profile_stat profile_start;
+static unsigned profile_stack[PROFILE_DEPTH]; /**< Index of the phase in the map, or PROFILE_MAX if discarded. */
+static struct profile_stat profile_stack_start[PROFILE_DEPTH];
+static unsigned profile_depth;
+
+static void profile_get(struct profile_stat* stat)
+{
+	stat->wall_ms = tick_ms();
+	if (procstat(&stat->cpu_ms, &stat->read_bytes, &stat->write_bytes, &stat->peak_rss) != 0) {
+		stat->cpu_ms = 0;
+		stat->read_bytes = 0;
+		stat->write_bytes = 0;
+		stat->peak_rss = 0;
+	}
+}
+
+static void profile_diff(struct profile_stat* result, const struct profile_stat* begin, const struct profile_stat* end)
+{
+	result->wall_ms = end->wall_ms - begin->wall_ms;
+	result->cpu_ms = end->cpu_ms - begin->cpu_ms;
+	result->read_bytes = end->read_bytes - begin->read_bytes;
+	result->write_bytes = end->write_bytes - begin->write_bytes;
+	result->peak_rss = end->peak_rss;
+}
+
+void profile_init(void)
+{
+	profile_max = 0;
+	profile_depth = 0;
+	profile_get(&profile_start);
+}
+
+void profile_begin(const char* name)
+{
+	char path[64];
+	unsigned i;
+
+	if (profile_depth == PROFILE_DEPTH) {
+		/* LCOV_EXCL_START */
+		log_fatal("Internal inconsistency: Too many nested profile phases\n");
+		os_abort();
+		/* LCOV_EXCL_STOP */
+	}
+
+	if (profile_depth != 0 && profile_stack[profile_depth - 1] == PROFILE_MAX) {
+		/* if the parent is discarded, discard also the child */
+		i = PROFILE_MAX;
+		goto push;
+	}
+
+	/* build the full path of the phase */
+	if (profile_depth != 0)
+		pathprint(path, sizeof(path), "%s/%s", profile_map[profile_stack[profile_depth - 1]].name, name);
+	else
+		pathcpy(path, sizeof(path), name);
+
+	/* search for an existing phase */
+	for (i = 0; i < profile_max; ++i)
+		if (strcmp(profile_map[i].name, path) == 0)
+			break;
+
+	/* insert a new one if possible, otherwise discard it */
+	if (i == profile_max && profile_max < PROFILE_MAX) {
+		pathcpy(profile_map[i].name, sizeof(profile_map[i].name), path);
+		profile_map[i].count = 0;
+		memset(&profile_map[i].stat, 0, sizeof(profile_map[i].stat));
+		++profile_max;
+	}
+
+push:
+	profile_stack[profile_depth] = i;
+	profile_get(&profile_stack_start[profile_depth]);
+	++profile_depth;
+}
+
+void profile_end(void)
+{
+	struct profile_stat stop;
+	struct profile_stat diff;
+	struct profile_phase* phase;
+
+	if (profile_depth == 0) {
+		/* LCOV_EXCL_START */
+		log_fatal("Internal inconsistency: Unbalanced profile phases\n");
+		os_abort();
+		/* LCOV_EXCL_STOP */
+	}
+
+	--profile_depth;
+
+	if (profile_stack[profile_depth] == PROFILE_MAX)
+		return;
+
+	profile_get(&stop);
+	profile_diff(&diff, &profile_stack_start[profile_depth], &stop);
+
+	phase = &profile_map[profile_stack[profile_depth]];
+	++phase->count;
+	phase->stat.wall_ms += diff.wall_ms;
+	phase->stat.cpu_ms += diff.cpu_ms;
+	phase->stat.read_bytes += diff.read_bytes;
+	phase->stat.write_bytes += diff.write_bytes;
+	if (phase->stat.peak_rss < diff.peak_rss)
+		phase->stat.peak_rss = diff.peak_rss;
+}
+
+static void profile_json(FILE* f, const char* name, unsigned count, const struct profile_stat* stat)
+{
+	fprintf(f, "{ \"name\": \"%s\", \"count\": %u, \"wall_ms\": %" PRIu64 ", \"cpu_ms\": %" PRIu64 ", \"read_bytes\": %" PRIu64 ", \"write_bytes\": %" PRIu64 ", \"peak_rss\": %" PRIu64 " }",
+		name, count, stat->wall_ms, stat->cpu_ms, stat->read_bytes, stat->write_bytes, stat->peak_rss);
+}
+
+void profile_print(const char* command, const char* path)
+{
+	struct profile_stat stop;
+	struct profile_stat total;
+	unsigned i;
+	FILE* f;
+
+	profile_get(&stop);
+	profile_diff(&total, &profile_start, &stop);
+
+	for (i = 0; i < profile_max; ++i) {
+		struct profile_phase* phase = &profile_map[i];
+		log_tag("profile:%s:%u:%" PRIu64 ":%" PRIu64 ":%" PRIu64 ":%" PRIu64 ":%" PRIu64 "\n", phase->name, phase->count,
+			phase->stat.wall_ms, phase->stat.cpu_ms, phase->stat.read_bytes, phase->stat.write_bytes, phase->stat.peak_rss);
+	}
+	log_tag("profile:total:1:%" PRIu64 ":%" PRIu64 ":%" PRIu64 ":%" PRIu64 ":%" PRIu64 "\n",
+		total.wall_ms, total.cpu_ms, total.read_bytes, total.write_bytes, total.peak_rss);
+
+	if (!path || !path[0])
+		return;
+
+	f = fopen(path, "wt");
+	if (!f) {
+		/* LCOV_EXCL_START */
+		log_fatal("Error creating the profile file '%s'. %s.\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+		/* LCOV_EXCL_STOP */
+	}
+
+	fprintf(f, "{\n");
+	fprintf(f, "  \"command\": \"%s\",\n", command);
+	fprintf(f, "  \"total\": ");
+	profile_json(f, "total", 1, &total);
+	fprintf(f, ",\n");
+	fprintf(f, "  \"phases\": [\n");
+	for (i = 0; i < profile_max; ++i) {
+		fprintf(f, "    ");
+		profile_json(f, profile_map[i].name, profile_map[i].count, &profile_map[i].stat);
+		fprintf(f, "%s\n", i + 1 < profile_max ? "," : "");
+	}
+	fprintf(f, "  ]\n");
+	fprintf(f, "}\n");
+
+	if (ferror(f) || fclose(f) != 0) {
+		/* LCOV_EXCL_START */
+		log_fatal("Error writing the profile file '%s'. %s.\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+		/* LCOV_EXCL_STOP */
+	}
+}
+
 /****************************************************************************/
 /* thread */
 
@@ -1629,6 +2087,34 @@ void thread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex)
 	}
 }
 
+int thread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, uint64_t ms)
+{
+	struct timeval tv;
+	struct timespec ts;
+	int ret;
+
+	/* the timeout is an absolute time of the realtime clock */
+	gettimeofday(&tv, 0);
+	ts.tv_sec = tv.tv_sec + ms / 1000;
+	ts.tv_nsec = tv.tv_usec * 1000 + (ms % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec += 1;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	ret = pthread_cond_timedwait(cond, mutex, &ts);
+	if (ret == ETIMEDOUT)
+		return 1;
+	if (ret != 0) {
+		/* LCOV_EXCL_START */
+		log_fatal("Failed call to pthread_cond_timedwait().\n");
+		os_abort();
+		/* LCOV_EXCL_STOP */
+	}
+
+	return 0;
+}
+
 /**
  * Implementation note about conditional variables.
  *
@@ -1712,5 +2198,194 @@ void thread_join(pthread_t thread, void** retval)
 	}
 }
 
+/**
+ * Thread of the shared pool.
+ */
+struct thread_pool_entry {
+	pthread_t thread;
+	struct thread_pool_entry* next;
+};
+
+static pthread_mutex_t pool_mutex;
+static pthread_cond_t pool_work; /**< Signaled when a job may be started. */
+static pthread_cond_t pool_finish; /**< Signaled when a job is completed. */
+static struct thread_pool_entry* pool_thread_list; /**< All the threads of the pool. */
+static struct thread_job* pool_head; /**< Queue of pending jobs. */
+static struct thread_job* pool_tail;
+static unsigned pool_count; /**< Number of threads in the pool. */
+static unsigned pool_idle; /**< Number of threads without a job. */
+static unsigned pool_pending; /**< Number of jobs not yet started. */
+static unsigned pool_cpu_running; /**< Number of computing bound jobs running. */
+static unsigned pool_cpu_max; /**< Max number of computing bound jobs running. */
+static int pool_quit;
+
+/**
+ * Extract the first job that can be started.
+ * Call with pool_mutex locked.
+ */
+static struct thread_job* thread_pool_pick(void)
+{
+	struct thread_job* prev = 0;
+	struct thread_job* job = pool_head;
+
+	while (job) {
+		if (!job->cpu || pool_cpu_max == 0 || pool_cpu_running < pool_cpu_max) {
+			if (prev)
+				prev->next = job->next;
+			else
+				pool_head = job->next;
+			if (pool_tail == job)
+				pool_tail = prev;
+			job->next = 0;
+			return job;
+		}
+
+		prev = job;
+		job = job->next;
+	}
+
+	return 0;
+}
+
+static void* thread_pool_thread(void* arg)
+{
+	(void)arg;
+
+	thread_mutex_lock(&pool_mutex);
+
+	while (1) {
+		struct thread_job* job = thread_pool_pick();
+
+		if (job) {
+			void* retval;
+
+			--pool_pending;
+			--pool_idle;
+			if (job->cpu)
+				++pool_cpu_running;
+
+			thread_mutex_unlock(&pool_mutex);
+
+			retval = job->func(job->arg);
+
+			thread_mutex_lock(&pool_mutex);
+
+			job->retval = retval;
+			job->done = 1;
+			++pool_idle;
+			if (job->cpu) {
+				--pool_cpu_running;
+
+				/* a queued computing job may now start */
+				thread_cond_broadcast(&pool_work);
+			}
+
+			thread_cond_broadcast(&pool_finish);
+			continue;
+		}
+
+		if (pool_quit)
+			break;
+
+		thread_cond_wait(&pool_work, &pool_mutex);
+	}
+
+	thread_mutex_unlock(&pool_mutex);
+
+	return 0;
+}
+
+void thread_pool_init(unsigned cpu_max)
+{
+	thread_mutex_init(&pool_mutex, 0);
+	thread_cond_init(&pool_work, 0);
+	thread_cond_init(&pool_finish, 0);
+
+	pool_thread_list = 0;
+	pool_count = 0;
+	pool_head = 0;
+	pool_tail = 0;
+	pool_idle = 0;
+	pool_pending = 0;
+	pool_cpu_running = 0;
+	pool_cpu_max = cpu_max;
+	pool_quit = 0;
+}
+
+void thread_pool_done(void)
+{
+	thread_mutex_lock(&pool_mutex);
+
+	pool_quit = 1;
+
+	thread_cond_broadcast(&pool_work);
+
+	thread_mutex_unlock(&pool_mutex);
+
+	while (pool_thread_list) {
+		struct thread_pool_entry* entry = pool_thread_list;
+		void* retval;
+
+		pool_thread_list = entry->next;
+
+		thread_join(entry->thread, &retval);
+
+		free(entry);
+	}
+
+	log_tag("thread:pool:%u\n", pool_count);
+
+	thread_mutex_destroy(&pool_mutex);
+	thread_cond_destroy(&pool_work);
+	thread_cond_destroy(&pool_finish);
+}
+
+void thread_pool_run(struct thread_job* job, int cpu, void *(* func)(void *), void* arg)
+{
+	job->func = func;
+	job->arg = arg;
+	job->retval = 0;
+	job->cpu = cpu;
+	job->done = 0;
+	job->next = 0;
+
+	thread_mutex_lock(&pool_mutex);
+
+	/* enqueue */
+	if (pool_tail)
+		pool_tail->next = job;
+	else
+		pool_head = job;
+	pool_tail = job;
+	++pool_pending;
+
+	/* ensure to have a thread for each pending job */
+	if (pool_idle < pool_pending) {
+		struct thread_pool_entry* entry;
+
+		entry = malloc_nofail(sizeof(struct thread_pool_entry));
+		entry->next = pool_thread_list;
+		pool_thread_list = entry;
+		++pool_count;
+		++pool_idle;
+
+		thread_create(&entry->thread, 0, thread_pool_thread, 0);
+	}
+
+	thread_cond_broadcast_and_unlock(&pool_work, &pool_mutex);
+}
+
+void thread_pool_join(struct thread_job* job, void** retval)
+{
+	thread_mutex_lock(&pool_mutex);
+
+	while (!job->done)
+		thread_cond_wait(&pool_finish, &pool_mutex);
+
+	thread_mutex_unlock(&pool_mutex);
+
+	*retval = job->retval;
+}
+
 #endif
 
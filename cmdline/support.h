@@ -357,31 +357,131 @@ int advise_open(struct advise_struct* advise, int f);
 int advise_write(struct advise_struct* advise, int f, data_off_t offset, data_off_t size);
 int advise_read(struct advise_struct* advise, int f, data_off_t offset, data_off_t size);
 
+/**
+ * Get the advise mode from its name, like "flush-window".
+ * Return ADVISE_DEFAULT for "auto", and -1 if the name is unknown.
+ */
+int advise_mode(const char* name);
+
+/**
+ * Get the name of the advise mode.
+ */
+const char* advise_name(int mode);
+
+/**
+ * Check if the existing file can be opened in direct mode.
+ * Return 0 on success.
+ */
+int advise_direct_probe(const char* path);
+
 /****************************************************************************/
 /* memory */
 
+/**
+ * Subsystems used to account the allocated memory.
+ */
+#define MALLOC_MISC 0 /**< Everything else allocated with a tag. */
+#define MALLOC_FILE 1 /**< File, link and dir objects. */
+#define MALLOC_PATH 2 /**< Paths and names. */
+#define MALLOC_BLOCK 3 /**< Blocks with their hashes. */
+#define MALLOC_EXTENT 4 /**< Extents mapping files to parity. */
+#define MALLOC_IMPORT 5 /**< Import and search sets. */
+#define MALLOC_BUFFER 6 /**< IO and stream buffers. */
+#define MALLOC_HASH 7 /**< Hash tables of the tommy library. */
+#define MALLOC_INFO 8 /**< Block information array. */
+#define MALLOC_MAX 9
+
 /**
  * Return the size of the allocated memory.
+ *
+ * Only the allocations with a tag are accounted, as they are the only ones
+ * released with free_tag() or free_sized(). This includes all the memory used
+ * to keep the state of the array. The others are the few small allocations
+ * released with a plain free(), and accounting them would make the counter
+ * grow forever.
  */
 size_t malloc_counter_get(void);
 
+/**
+ * Return the size of the allocated memory of the specified subsystem.
+ */
+size_t malloc_counter_tag_get(int tag);
+
+/**
+ * Return the name of the specified subsystem.
+ */
+const char* malloc_tag_name(int tag);
+
+/**
+ * Account an allocation done outside the malloc_nofail() family.
+ * If the memory limit is exceeded, it aborts.
+ */
+void malloc_counter_inc(size_t inc, int tag);
+
+/**
+ * Account the release of memory accounted with malloc_counter_inc().
+ */
+void malloc_counter_dec(size_t dec, int tag);
+
+/**
+ * Set the memory limit in bytes. 0 for no limit.
+ * Any allocation exceeding the limit aborts with a clear message.
+ */
+void malloc_limit_set(size_t limit);
+
+/**
+ * Return the memory limit in bytes, 0 for no limit.
+ */
+size_t malloc_limit_get(void);
+
+/**
+ * Return the memory still available before reaching the limit.
+ * If no limit is set, it returns SIZE_MAX.
+ */
+size_t malloc_limit_avail(void);
+
 /**
  * Safe malloc.
  * If no memory is available, it aborts.
+ * The _tag() version accounts the memory in the specified subsystem,
+ * and it must be released with free_tag().
  */
 void* malloc_nofail(size_t size);
+void* malloc_nofail_tag(size_t size, int tag);
 
 /**
  * Safe cmalloc.
  * If no memory is available, it aborts.
  */
 void* calloc_nofail(size_t count, size_t size);
+void* calloc_nofail_tag(size_t count, size_t size, int tag);
 
 /**
  * Safe strdup.
  * If no memory is available, it aborts.
  */
 char* strdup_nofail(const char* str);
+char* strdup_nofail_tag(const char* str, int tag);
+
+/**
+ * Free memory allocated with the malloc_nofail() family, releasing it
+ * from the specified subsystem.
+ * The size is the one used for the allocation, or for strings, their length plus one.
+ */
+void free_tag(void* ptr, size_t size, int tag);
+
+/**
+ * Safe malloc for containers releasing the memory without knowing its size.
+ * The size and the tag are stored before the returned memory,
+ * and it must be released with free_sized().
+ */
+void* malloc_nofail_sized(size_t size, int tag);
+void* calloc_nofail_sized(size_t count, size_t size, int tag);
+
+/**
+ * Free memory allocated with malloc_nofail_sized() or calloc_nofail_sized().
+ */
+void free_sized(void* ptr);
 
 /**
  * Helper for printing an error about a failed allocation.
@@ -402,6 +502,33 @@ int smartctl_attribute(FILE* f, const char* file, const char* name, uint64_t* sm
  */
 int smartctl_flush(FILE* f, const char* file, const char* name);
 
+/****************************************************************************/
+/* profile */
+
+/**
+ * Start the profiling, taking the reference for the total.
+ */
+void profile_init(void);
+
+/**
+ * Begin a phase.
+ * Phases can be nested, and are accumulated by their full path,
+ * like "sync/autosave/write".
+ * Only the main thread has to call these functions.
+ */
+void profile_begin(const char* name);
+
+/**
+ * End the last phase begun.
+ */
+void profile_end(void);
+
+/**
+ * Output the collected phases as log tags, and if a path is
+ * specified, also as a JSON file.
+ */
+void profile_print(const char* command, const char* path);
+
 /****************************************************************************/
 /* thread */
 
@@ -431,6 +558,50 @@ void thread_cond_signal_and_unlock(pthread_cond_t* cond, pthread_mutex_t* mutex)
 void thread_cond_broadcast_and_unlock(pthread_cond_t* cond, pthread_mutex_t* mutex);
 void thread_create(pthread_t* thread, pthread_attr_t* attr, void *(* func)(void *), void *arg);
 void thread_join(pthread_t thread, void** retval);
+
+/**
+ * Wait on a condition for at most the specified milliseconds.
+ * Return 0 if signaled, 1 on timeout.
+ */
+int thread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, uint64_t ms);
+
+/**
+ * Job run by the shared thread pool.
+ */
+struct thread_job {
+	void* (*func)(void*); /**< Function to run. */
+	void* arg; /**< Argument of the function. */
+	void* retval; /**< Return value of the function. */
+	int cpu; /**< If the job is computing bound, and then limited by the thread cap. */
+	int done; /**< If the job is completed. */
+	struct thread_job* next; /**< Next job in the pending queue. */
+};
+
+/**
+ * Initialize the shared thread pool.
+ * The threads are created on demand and kept alive for later jobs.
+ * \param cpu_max Max number of computing bound jobs running at the same time. 0 for no limit.
+ */
+void thread_pool_init(unsigned cpu_max);
+
+/**
+ * Terminate all the threads of the pool.
+ * All the jobs must be already joined.
+ */
+void thread_pool_done(void);
+
+/**
+ * Run a job in the shared thread pool.
+ * Jobs not computing bound, like the IO workers, may depend on each other,
+ * and they always get their own thread.
+ * Computing bound jobs are instead queued when the thread cap is reached.
+ */
+void thread_pool_run(struct thread_job* job, int cpu, void *(* func)(void *), void* arg);
+
+/**
+ * Wait for the completion of a job.
+ */
+void thread_pool_join(struct thread_job* job, void** retval);
 #endif
 
 #endif
@@ -58,6 +58,7 @@ static int state_hash_process(struct snapraid_state* state, block_off_t blocksta
 	io_error = 0;
 
 	/* first count the number of blocks to process */
+	profile_begin("plan");
 	countmax = 0;
 	for (j = 0; j < diskmax; ++j) {
 		struct snapraid_disk* disk = handle[j].disk;
@@ -82,6 +83,7 @@ static int state_hash_process(struct snapraid_state* state, block_off_t blocksta
 			++countmax;
 		}
 	}
+	profile_end();
 
 	/* drop until now */
 	state_usage_waste(state);
@@ -157,7 +159,7 @@ static int state_hash_process(struct snapraid_state* state, block_off_t blocksta
 				}
 			}
 
-			ret = handle_open(&handle[j], file, state->file_mode, log_error, 0);
+			ret = handle_open(&handle[j], file, handle[j].disk->file_mode, log_error, 0);
 			if (ret == -1) {
 				if (errno == EIO) {
 					/* LCOV_EXCL_START */
@@ -534,7 +536,7 @@ static void sync_data_reader(struct snapraid_worker* worker, struct snapraid_tas
 		}
 	}
 
-	ret = handle_open(handle, task->file, state->file_mode, log_error, 0);
+	ret = handle_open(handle, task->file, handle->disk->file_mode, log_error, 0);
 	if (ret == -1) {
 		if (errno == EIO) {
 			/* LCOV_EXCL_START */
@@ -636,6 +638,12 @@ static void sync_parity_writer(struct snapraid_worker* worker, struct snapraid_t
 	unsigned char* buffer = task->buffer;
 	int ret;
 
+	/* when adding new parities, the old ones are already valid and not written */
+	if (state->opt.force_new_parity && !state->parity[level].is_new) {
+		task->state = TASK_STATE_DONE;
+		return;
+	}
+
 	/* write parity */
 	ret = parity_write(parity_handle, blockcur, buffer, state->block_size);
 	if (ret == -1) {
@@ -687,6 +695,9 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 	time_t now;
 	struct failed_struct* failed;
 	int* failed_map;
+	int* zero_map;
+	int parity_map[LEV_MAX];
+	unsigned parity_mac;
 	unsigned l;
 	unsigned* waiting_map;
 	unsigned waiting_mac;
@@ -721,25 +732,36 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 
 	failed = malloc_nofail(diskmax * sizeof(struct failed_struct));
 	failed_map = malloc_nofail(diskmax * sizeof(unsigned));
+	zero_map = malloc_nofail(diskmax * sizeof(int));
 
 	/* possibly waiting disks */
 	waiting_mac = diskmax > RAID_PARITY_MAX ? diskmax : RAID_PARITY_MAX;
 	waiting_map = malloc_nofail(waiting_mac * sizeof(unsigned));
 
+	/* parities usable to recover silent errors */
+	/* the new ones are not yet computed, and cannot be used */
+	parity_mac = 0;
+	for (l = 0; l < state->level; ++l) {
+		if (!state->parity[l].is_new)
+			parity_map[parity_mac++] = l;
+	}
+
 	error = 0;
 	silent_error = 0;
 	io_error = 0;
 
 	/* first count the number of blocks to process */
+	profile_begin("plan");
 	countmax = 0;
 	plan.handle_max = diskmax;
 	plan.handle_map = handle;
-	plan.force_full = state->opt.force_full;
+	plan.force_full = state->opt.force_full || state->opt.force_new_parity;
 	for (blockcur = blockstart; blockcur < blockmax; ++blockcur) {
 		if (!block_is_enabled(&plan, blockcur))
 			continue;
 		++countmax;
 	}
+	profile_end();
 
 	/* compute the autosave size for all disk, even if not read */
 	/* this makes sense because the speed should be almost the same */
@@ -807,7 +829,7 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 		/* Note that CHG/DELETED blocks already present in the content file loaded */
 		/* have the hash cleared (::clear_past_hash flag), and then they won't never match the hash. */
 		/* We are treating only CHG blocks created at runtime. */
-		parity_needs_to_be_updated = state->opt.force_full || state->opt.force_parity_update;
+		parity_needs_to_be_updated = state->opt.force_full || state->opt.force_parity_update || state->opt.force_new_parity;
 
 		/* if the parity is going to be updated */
 		parity_going_to_be_updated = 0;
@@ -847,9 +869,15 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 			/* by default no rehash in case of "continue" */
 			rehandle[diskcur].block = 0;
 
+			/* by default the block is not known to be zero */
+			zero_map[diskcur] = 0;
+
 			/* if the disk position is not used */
-			if (!disk)
+			if (!disk) {
+				/* the reader used an empty block */
+				zero_map[diskcur] = 1;
 				continue;
+			}
 
 			/* get the state of the block */
 			block_state = block_state_get(block);
@@ -879,8 +907,11 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 			}
 
 			/* if the block is not used */
-			if (!block_has_file(block))
+			if (!block_has_file(block)) {
+				/* the reader used an empty block */
+				zero_map[diskcur] = 1;
 				continue;
+			}
 
 			/* handle error conditions */
 			if (task->state == TASK_STATE_IOERROR) {
@@ -924,15 +955,18 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 
 			countsize += read_size;
 
+			/* zero blocks have a precomputed hash, and they are skipped in the parity */
+			zero_map[diskcur] = memiszero(buffer[diskcur], read_size);
+
 			/* now compute the hash */
 			if (rehash) {
-				memhash(state->prevhash, state->prevhashseed, hash, buffer[diskcur], read_size);
+				memhash_zero(&state->zerohash, state->prevhash, state->prevhashseed, hash, buffer[diskcur], read_size, zero_map[diskcur]);
 
 				/* compute the new hash, and store it */
 				rehandle[diskcur].block = block;
-				memhash(state->hash, state->hashseed, rehandle[diskcur].hash, buffer[diskcur], read_size);
+				memhash_zero(&state->zerohash, state->hash, state->hashseed, rehandle[diskcur].hash, buffer[diskcur], read_size, zero_map[diskcur]);
 			} else {
-				memhash(state->hash, state->hashseed, hash, buffer[diskcur], read_size);
+				memhash_zero(&state->zerohash, state->hash, state->hashseed, hash, buffer[diskcur], read_size, zero_map[diskcur]);
 			}
 
 			/* until now is hash */
@@ -1023,6 +1057,10 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 			/* but RAID requires the indexes to be sorted */
 			qsort(failed, failed_count, sizeof(failed[0]), failed_compare_by_index);
 
+			/* the recovering may change the content of the failed blocks */
+			for (j = 0; j < failed_count; ++j)
+				zero_map[failed[j].index] = 0;
+
 			/* setup the blocks to recover */
 			failed_mac = 0;
 			for (j = 0; j < failed_count; ++j) {
@@ -1046,7 +1084,7 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 					memset(block_buffer, 0, state->block_size);
 				} else {
 					/* if we have too many failures, we cannot recover */
-					if (failed_mac >= state->level)
+					if (failed_mac >= parity_mac)
 						break;
 
 					/* otherwise it has to be recovered */
@@ -1062,7 +1100,9 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 				/* read the parity */
 				/* we are sure that parity exists because */
 				/* we have at least one BLK block */
-				for (l = 0; l < state->level; ++l) {
+				for (j = 0; j < parity_mac; ++j) {
+					l = parity_map[j];
+
 					ret = parity_read(&parity_handle[l], blockcur, buffer[diskmax + l], state->block_size, log_error);
 					if (ret == -1) {
 						/* LCOV_EXCL_START */
@@ -1101,7 +1141,7 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 					/* note that this is a simple fix algorithm, that doesn't take into */
 					/* account the case of a wrong parity */
 					/* only 'fix' supports the most advanced fixing */
-					raid_rec(failed_mac, failed_map, diskmax, state->level, state->block_size, buffer);
+					raid_data(failed_mac, failed_map, parity_map, diskmax, state->block_size, buffer);
 
 					/* until now is raid */
 					state_usage_raid(state);
@@ -1157,7 +1197,15 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 			/* update the parity only if really needed */
 			if (parity_needs_to_be_updated) {
 				/* compute the parity */
-				raid_gen(diskmax, state->level, state->block_size, buffer);
+				if (state->opt.force_new_parity) {
+					/* only the new ones, as the others are already valid */
+					for (l = 0; l < state->level; ++l) {
+						if (state->parity[l].is_new)
+							raid_genl(l, diskmax, state->block_size, buffer);
+					}
+				} else {
+					raid_gen_zero(diskmax, state->level, state->block_size, buffer, zero_map);
+				}
 
 				/* until now is raid */
 				state_usage_raid(state);
@@ -1196,7 +1244,18 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 			/* wrote the parity at this time */
 			/* we also update the info block only if no silent error was found */
 			/* because has no sense to refresh the time for data that we know bad */
-			if (parity_needs_to_be_updated
+			/* when adding new parities, the old ones are not rewritten, and we only */
+			/* store the new hash, keeping all the other info */
+			if (state->opt.force_new_parity) {
+				if (rehash && !silent_error_on_this_block) {
+					for (j = 0; j < diskmax; ++j) {
+						if (rehandle[j].block)
+							memcpy(rehandle[j].block->hash, rehandle[j].hash, BLOCK_HASH_SIZE);
+					}
+
+					info_set(&state->infoarr, blockcur, info_set_cycle(info_make(info_get_time(info), info_get_bad(info), 0, info_get_justsynced(info)), info_get_cycle(info)));
+				}
+			} else if (parity_needs_to_be_updated
 				&& !silent_error_on_this_block
 			) {
 				/* if rehash is needed */
@@ -1289,11 +1348,14 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 		}
 
 		/* autosave */
-		if ((state->autosave != 0
+		/* not when adding new parities, because the content file must not */
+		/* report them as valid until they are completely computed */
+		if (!state->opt.force_new_parity
+			&& ((state->autosave != 0
 			&& autosavedone >= autosavelimit /* if we have reached the limit */
 			&& autosavemissing >= autosavelimit) /* if we have at least a full step to do */
 		        /* or if we have a forced autosave at the specified block */
-			|| (state->opt.force_autosave_at != 0 && state->opt.force_autosave_at == blockcur)
+			|| (state->opt.force_autosave_at != 0 && state->opt.force_autosave_at == blockcur))
 		) {
 			autosavedone = 0; /* restart the counter */
 
@@ -1321,7 +1383,9 @@ static int state_sync_process(struct snapraid_state* state, struct snapraid_pari
 			}
 
 			/* now we can safely write the content file */
+			profile_begin("autosave");
 			state_write(state);
+			profile_end();
 
 			state_progress_restart(state);
 
@@ -1407,6 +1471,7 @@ bail:
 	free(rehandle_alloc);
 	free(failed);
 	free(failed_map);
+	free(zero_map);
 	free(waiting_map);
 	io_done(&io);
 
@@ -1420,11 +1485,65 @@ bail:
 	return 0;
 }
 
+/**
+ * Complete the compaction started before the sync.
+ *
+ * The blocks kept at the end of the parity are moved, and synced,
+ * and only then the parity files are shrunk.
+ */
+static int state_sync_compact(struct snapraid_state* state, struct snapraid_parity_handle* parity_handle)
+{
+	block_off_t blockmax;
+	data_off_t size;
+	unsigned l;
+	int ret;
+
+	if (state_compact_finish(state) == 0)
+		return 0;
+
+	blockmax = parity_allocated_size(state);
+	size = blockmax * (data_off_t)state->block_size;
+
+	msg_progress("Compacting...\n");
+
+	/* save the new position of the moved blocks before updating the parity */
+	if (!state->opt.skip_content_write) {
+		state_write(state);
+	} else {
+		log_fatal("WARNING! Skipped state write for --test-skip-content-write option.\n");
+	}
+
+	ret = state_sync_process(state, parity_handle, 0, blockmax);
+	if (ret == -1 || global_interrupt)
+		return ret;
+
+	msg_progress("Resizing...\n");
+
+	for (l = 0; l < state->level; ++l) {
+		ret = parity_chsize(&parity_handle[l], &state->parity[l], 0, size, state->block_size, state->opt.skip_fallocate, state->opt.skip_space_holder);
+		if (ret == -1) {
+			/* LCOV_EXCL_START */
+			log_fatal("WARNING! Failed to shrink the %s file.\n", lev_name(l));
+			return -1;
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	/* state changed */
+	state->need_write = 1;
+
+	/* after resizing parity files, refresh again the free info */
+	state_refresh(state);
+
+	return 0;
+}
+
 int state_sync(struct snapraid_state* state, block_off_t blockstart, block_off_t blockcount)
 {
 	block_off_t blockmax;
 	block_off_t used_paritymax;
 	block_off_t file_paritymax;
+	int is_file_paritymax_set;
 	data_off_t size;
 	int ret;
 	struct snapraid_parity_handle parity_handle[LEV_MAX];
@@ -1442,6 +1561,7 @@ int state_sync(struct snapraid_state* state, block_off_t blockstart, block_off_t
 
 	/* effective size of the parity files */
 	file_paritymax = 0;
+	is_file_paritymax_set = 0;
 
 	if (blockstart > blockmax) {
 		/* LCOV_EXCL_START */
@@ -1455,12 +1575,70 @@ int state_sync(struct snapraid_state* state, block_off_t blockstart, block_off_t
 		blockmax = blockstart + blockcount;
 	}
 
+	/* only estimate, without touching the parity */
+	if (state->opt.estimate) {
+		struct snapraid_plan plan;
+		struct snapraid_handle* handle;
+		unsigned diskmax;
+
+		handle = handle_mapping(state, &diskmax);
+
+		plan.handle_max = diskmax;
+		plan.handle_map = handle;
+		plan.force_full = state->opt.force_full || state->opt.force_new_parity;
+
+		state_estimate(state, "sync", blockstart, blockmax, block_is_enabled, &plan);
+
+		free(handle);
+		return 0;
+	}
+
+	if (state->opt.force_new_parity) {
+		unsigned new_count = 0;
+
+		/* the new parities are the ones without a size stored in the content file */
+		/* this remains true until a sync completes them, and the content file is written */
+		for (l = 0; l < state->level; ++l) {
+			state->parity[l].is_new = state->parity[l].split_map[0].size == PARITY_SIZE_INVALID;
+			if (state->parity[l].is_new)
+				++new_count;
+		}
+
+		if (new_count == 0) {
+			/* LCOV_EXCL_START */
+			log_fatal("No new parity to compute. All the parity files are already in use.\n");
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+
+		if (new_count == state->level) {
+			/* LCOV_EXCL_START */
+			log_fatal("No existing parity to keep. You can compute all of them using 'snapraid --force-full sync'.\n");
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+
+		/* the new parity is computed from the data as it's now, */
+		/* and this must be the same data used by the existing parity */
+		if (parity_is_invalid(state)) {
+			/* LCOV_EXCL_START */
+			log_fatal("The array is not synced. Run a 'snapraid sync' without the new parity before adding it.\n");
+			exit(EXIT_FAILURE);
+			/* LCOV_EXCL_STOP */
+		}
+
+		for (l = 0; l < state->level; ++l) {
+			if (state->parity[l].is_new)
+				msg_progress("Adding %s...\n", lev_name(l));
+		}
+	}
+
 	for (l = 0; l < state->level; ++l) {
 		data_off_t out_size;
 		block_off_t parityblocks;
 
 		/* create the file and open for writing */
-		ret = parity_create(&parity_handle[l], &state->parity[l], l, state->file_mode, state->block_size, state->opt.parity_limit_size);
+		ret = parity_create(&parity_handle[l], &state->parity[l], l, state->parity[l].file_mode, state->block_size, state->opt.parity_limit_size);
 		if (ret == -1) {
 			/* LCOV_EXCL_START */
 			log_fatal("WARNING! Without an accessible %s file, it isn't possible to sync.\n", lev_name(l));
@@ -1472,14 +1650,20 @@ int state_sync(struct snapraid_state* state, block_off_t blockstart, block_off_t
 		parity_size(&parity_handle[l], &out_size);
 		parityblocks = out_size / state->block_size;
 
+		/* a new parity is expected to be smaller */
+		if (state->parity[l].is_new)
+			continue;
+
 		/* if the file is too small */
 		if (parityblocks < used_paritymax) {
 			log_fatal("WARNING! The %s parity has data only %u blocks instead of %u.\n", lev_name(l), parityblocks, used_paritymax);
 		}
 
 		/* keep the smallest parity number of blocks */
-		if (l == 0 || file_paritymax > parityblocks)
+		if (!is_file_paritymax_set || file_paritymax > parityblocks) {
 			file_paritymax = parityblocks;
+			is_file_paritymax_set = 1;
+		}
 	}
 
 	/* if we do a full parity realloc or computation, having a wrong parity size is expected */
@@ -1495,7 +1679,8 @@ int state_sync(struct snapraid_state* state, block_off_t blockstart, block_off_t
 			} else {
 				log_fatal("It's possible that the parity disks are not mounted.\n");
 				log_fatal("If instead you are adding a new parity level, you can 'sync' using\n");
-				log_fatal("'snapraid --force-full sync' to force a full rebuild of the parity.\n");
+				log_fatal("'snapraid --force-new-parity sync' to compute only the new parity,\n");
+				log_fatal("or 'snapraid --force-full sync' to force a full rebuild of the parity.\n");
 			}
 			exit(EXIT_FAILURE);
 			/* LCOV_EXCL_STOP */
@@ -1507,7 +1692,9 @@ int state_sync(struct snapraid_state* state, block_off_t blockstart, block_off_t
 	if (state->opt.prehash) {
 		msg_progress("Hashing...\n");
 
+		profile_begin("hash");
 		ret = state_hash_process(state, blockstart, blockmax, &skip_sync);
+		profile_end();
 		if (ret == -1) {
 			/* LCOV_EXCL_START */
 			++unrecoverable_error;
@@ -1564,7 +1751,9 @@ int state_sync(struct snapraid_state* state, block_off_t blockstart, block_off_t
 		 * Instead, saving the new content file in advance, keeps track of all the parity
 		 * that may be modified.
 		 */
-		if (!state->opt.skip_content_write) {
+		if (state->opt.force_new_parity) {
+			/* the new parity is not yet valid, and it cannot be saved in the content file */
+		} else if (!state->opt.skip_content_write) {
 			if (state->need_write)
 				state_write(state);
 		} else {
@@ -1575,7 +1764,11 @@ int state_sync(struct snapraid_state* state, block_off_t blockstart, block_off_t
 
 		/* skip degenerated cases of empty parity, or skipping all */
 		if (blockstart < blockmax) {
+			profile_begin("sync");
+			state_perf_begin(state);
 			ret = state_sync_process(state, parity_handle, blockstart, blockmax);
+			state_perf_end(state, "sync");
+			profile_end();
 			if (ret == -1) {
 				/* LCOV_EXCL_START */
 				++unrecoverable_error;
@@ -1585,6 +1778,40 @@ int state_sync(struct snapraid_state* state, block_off_t blockstart, block_off_t
 		} else {
 			msg_status("Nothing to do\n");
 		}
+
+		/* complete the compaction only after a full sync of the moved blocks */
+		if (state->opt.compact && blockstart == 0 && blockcount == 0 && unrecoverable_error == 0 && !global_interrupt) {
+			ret = state_sync_compact(state, parity_handle);
+			if (ret == -1) {
+				/* LCOV_EXCL_START */
+				++unrecoverable_error;
+				/* continue, as we are already exiting */
+				/* LCOV_EXCL_STOP */
+			}
+		}
+
+		/* if the new parity was not completely computed, truncate it */
+		/* to not allow a later sync to use it, and keep it as new in the content file */
+		if (state->opt.force_new_parity && (unrecoverable_error != 0 || global_interrupt)) {
+			for (l = 0; l < state->level; ++l) {
+				unsigned s;
+
+				if (!state->parity[l].is_new)
+					continue;
+
+				ret = parity_chsize(&parity_handle[l], &state->parity[l], 0, 0, state->block_size, state->opt.skip_fallocate, state->opt.skip_space_holder);
+				if (ret == -1) {
+					/* LCOV_EXCL_START */
+					log_fatal("WARNING! Failed to truncate the incomplete %s file.\n", lev_name(l));
+					++unrecoverable_error;
+					/* continue, as we are already exiting */
+					/* LCOV_EXCL_STOP */
+				}
+
+				for (s = 0; s < state->parity[l].split_mac; ++s)
+					state->parity[l].split_map[s].size = PARITY_SIZE_INVALID;
+			}
+		}
 	}
 
 	for (l = 0; l < state->level; ++l) {
@@ -32,11 +32,14 @@ void state_touch(struct snapraid_state* state)
 	/* for all disks */
 	for (i = state->disklist; i != 0; i = i->next) {
 		struct snapraid_disk* disk = i->data;
-		tommy_node* j;
-
-		/* for all files */
-		for (j = disk->filelist; j != 0; j = j->next) {
-			struct snapraid_file* file = j->data;
+		struct snapraid_file** file_map;
+		unsigned file_count;
+		unsigned j;
+
+		/* for all files, in directory order */
+		file_map = fs_file_order(disk, &file_count);
+		for (j = 0; j < file_count; ++j) {
+			struct snapraid_file* file = file_map[j];
 
 			/* if the file has a zero nanosecond timestamp */
 			/* note that symbolic links are not in the file list */
@@ -550,6 +550,102 @@ int devuuid(uint64_t device, char* uuid, size_t uuid_size)
 	return -1;
 }
 
+/**
+ * Read a number from a sysfs attribute of the block device.
+ * Partitions don't have the queue attributes, and they are read from the whole disk.
+ * Return !=0 on error.
+ */
+#if HAVE_LINUX_DEVICE
+static int devattr_read(uint64_t device, const char* attr, unsigned* value)
+{
+	char path[PATH_MAX];
+	char buf[64];
+	char* e;
+	int f;
+	int len;
+
+	pathprint(path, sizeof(path), "/sys/dev/block/%u:%u/%s", major(device), minor(device), attr);
+
+	f = open(path, O_RDONLY);
+	if (f == -1) {
+		/* try with the parent disk */
+		pathprint(path, sizeof(path), "/sys/dev/block/%u:%u/../%s", major(device), minor(device), attr);
+
+		f = open(path, O_RDONLY);
+		if (f == -1)
+			return -1;
+	}
+
+	len = read(f, buf, sizeof(buf) - 1);
+
+	close(f);
+
+	if (len <= 0) {
+		/* LCOV_EXCL_START */
+		return -1;
+		/* LCOV_EXCL_STOP */
+	}
+
+	buf[len] = 0;
+
+	*value = strtoul(buf, &e, 10);
+	if (e == buf || (*e != 0 && !isspace(*e))) {
+		/* LCOV_EXCL_START */
+		return -1;
+		/* LCOV_EXCL_STOP */
+	}
+
+	return 0;
+}
+#endif
+
+int devattr(uint64_t device, int* rotational, unsigned* queue_depth, unsigned* logical_block_size)
+{
+#if HAVE_LINUX_DEVICE
+	unsigned value;
+
+	/* if the major is the null device */
+	if (major(device) == 0) {
+		/* obtain the real device */
+		if (devdereference(device, &device) != 0) {
+			/* LCOV_EXCL_START */
+			return -1;
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	if (devattr_read(device, "queue/rotational", &value) != 0) {
+		log_tag("attr:%u:%u: rotational not found\n", major(device), minor(device));
+		return -1;
+	}
+	*rotational = value != 0;
+
+	/* the depth of the device queue, and not the one of the scheduler in queue/nr_requests */
+	/* SCSI and SATA devices report it in device/queue_depth, others like NVMe */
+	/* only as the tag depth of the blk-mq hardware queue */
+	if (devattr_read(device, "device/queue_depth", &value) != 0
+		&& devattr_read(device, "mq/0/nr_tags", &value) != 0)
+		value = 0;
+	*queue_depth = value;
+
+	if (devattr_read(device, "queue/logical_block_size", &value) != 0)
+		value = 0;
+	*logical_block_size = value;
+
+	log_tag("attr:%u:%u: rotational %d, queue %u, block %u\n", major(device), minor(device), *rotational, *queue_depth, *logical_block_size);
+
+	return 0;
+#else
+	log_tag("attr:%u:%u: not supported\n", major(device), minor(device));
+
+	/* not supported */
+	(void)rotational;
+	(void)queue_depth;
+	(void)logical_block_size;
+	return -1;
+#endif
+}
+
 int filephy(const char* path, uint64_t size, uint64_t* physical)
 {
 #if HAVE_LINUX_FIEMAP_H
@@ -790,6 +886,71 @@ uint64_t tick_ms(void)
 	return tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
 }
 
+int procstat(uint64_t* cpu_ms, uint64_t* read_bytes, uint64_t* write_bytes, uint64_t* peak_rss)
+{
+#if HAVE_GETRUSAGE
+	struct rusage ru;
+#endif
+#if HAVE_LINUX_DEVICE
+	FILE* f;
+	char line[128];
+#endif
+	int has_io;
+
+	*cpu_ms = 0;
+	*read_bytes = 0;
+	*write_bytes = 0;
+	*peak_rss = 0;
+
+	has_io = 0;
+
+#if HAVE_LINUX_DEVICE
+	/* in Linux get the bytes read and written, including the cached ones */
+	f = fopen("/proc/self/io", "r");
+	if (f) {
+		while (fgets(line, sizeof(line), f) != 0) {
+			unsigned long long value;
+
+			if (sscanf(line, "rchar: %llu", &value) == 1) {
+				*read_bytes = value;
+				has_io = 1;
+			} else if (sscanf(line, "wchar: %llu", &value) == 1) {
+				*write_bytes = value;
+				has_io = 1;
+			}
+		}
+		fclose(f);
+	}
+#endif
+
+#if HAVE_GETRUSAGE
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return -1;
+
+	*cpu_ms = ru.ru_utime.tv_sec * 1000ULL + ru.ru_utime.tv_usec / 1000
+		+ ru.ru_stime.tv_sec * 1000ULL + ru.ru_stime.tv_usec / 1000;
+
+#ifdef __APPLE__
+	/* in Mac OS X it's in bytes */
+	*peak_rss = ru.ru_maxrss;
+#else
+	/* in Linux and BSD it's in KiB */
+	*peak_rss = ru.ru_maxrss * 1024ULL;
+#endif
+
+	/* fallback to the block counters, that count only the real disk accesses */
+	if (!has_io) {
+		*read_bytes = ru.ru_inblock * 512ULL;
+		*write_bytes = ru.ru_oublock * 512ULL;
+	}
+
+	return 0;
+#else
+	(void)has_io;
+	return -1;
+#endif
+}
+
 int randomize(void* ptr, size_t size)
 {
 	int f;
@@ -1306,23 +1467,30 @@ static int device_thread(tommy_list* list, void* (*func)(void* arg))
 	tommy_node* i;
 
 #if HAVE_PTHREAD
+	struct thread_job* job;
+	unsigned j;
+
+	job = malloc_nofail(tommy_list_count(list) * sizeof(struct thread_job));
+
 	/* start all threads */
+	j = 0;
 	for (i = tommy_list_head(list); i != 0; i = i->next) {
 		devinfo_t* devinfo = i->data;
 
-		thread_create(&devinfo->thread, 0, func, devinfo);
+		thread_pool_run(&job[j++], 0, func, devinfo);
 	}
 
 	/* join all threads */
-	for (i = tommy_list_head(list); i != 0; i = i->next) {
-		devinfo_t* devinfo = i->data;
+	for (j = 0; j < tommy_list_count(list); ++j) {
 		void* retval;
 
-		thread_join(devinfo->thread, &retval);
+		thread_pool_join(&job[j], &retval);
 
 		if (retval != 0)
 			++fail;
 	}
+
+	free(job);
 #else
 	for (i = tommy_list_head(list); i != 0; i = i->next) {
 		devinfo_t* devinfo = i->data;
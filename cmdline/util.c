@@ -594,6 +594,86 @@ unsigned memdiff(const unsigned char* data1, const unsigned char* data2, size_t
 	return count;
 }
 
+int memiszero(const void* src, size_t size)
+{
+	const unsigned char* ptr = src;
+	size_t i;
+
+	/* check 64 bytes at time, with an early exit at the first non zero */
+	/* the loop is simple enough to be vectorized by the compiler */
+	for (i = 0; i + 64 <= size; i += 64) {
+		uint64_t v[8];
+		memcpy(v, ptr + i, 64);
+		if ((v[0] | v[1] | v[2] | v[3] | v[4] | v[5] | v[6] | v[7]) != 0)
+			return 0;
+	}
+
+	for (; i < size; ++i) {
+		if (ptr[i] != 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+void zerohash_init(struct snapraid_zerohash* zh)
+{
+	unsigned i;
+
+	/* a zero size marks the entry as empty */
+	for (i = 0; i < ZEROHASH_MAX; ++i) {
+		zh->size[i] = 0;
+		zh->used[i] = 0;
+	}
+
+	zh->time = 0;
+}
+
+void memhash_zero(struct snapraid_zerohash* zh, unsigned kind, const unsigned char* seed, void* digest, const void* src, size_t size, int is_zero)
+{
+	unsigned i;
+	unsigned lru;
+
+	if (!is_zero) {
+		memhash(kind, seed, digest, src, size);
+		return;
+	}
+
+	/* search the entry, and the least recently used one to replace */
+	lru = 0;
+	for (i = 0; i < ZEROHASH_MAX; ++i) {
+		if (zh->size[i] == size
+			&& zh->kind[i] == kind
+			&& memcmp(zh->seed[i], seed, HASH_MAX) == 0
+		)
+			break;
+
+		if (zh->used[i] < zh->used[lru])
+			lru = i;
+	}
+
+	if (i == ZEROHASH_MAX) {
+		i = lru;
+
+		/* the block is zero, so hashing it gives the zero hash of this size */
+		memhash(kind, seed, zh->digest[i], src, size);
+		zh->size[i] = size;
+		zh->kind[i] = kind;
+		memcpy(zh->seed[i], seed, HASH_MAX);
+	}
+
+	/* on wrap around restart the times, as all of them are in the past */
+	if (++zh->time == 0) {
+		unsigned j;
+		for (j = 0; j < ZEROHASH_MAX; ++j)
+			zh->used[j] = 0;
+		zh->time = 1;
+	}
+	zh->used[i] = zh->time;
+
+	memcpy(digest, zh->digest[i], HASH_MAX);
+}
+
 /****************************************************************************/
 /* lock */
 
@@ -195,6 +195,47 @@ void crc32c_init(void);
  */
 void memhash(unsigned kind, const unsigned char* seed, void* digest, const void* src, size_t size);
 
+/**
+ * Check if a memory block is all zero.
+ * Return 1 if all zero, 0 otherwise.
+ */
+int memiszero(const void* src, size_t size);
+
+/**
+ * Number of entries in the zero hash cache.
+ */
+#define ZEROHASH_MAX 8
+
+/**
+ * Cache of the hashes of zero blocks.
+ *
+ * Every combination of hash kind, seed and size has a different hash,
+ * and it includes the short tail blocks at the end of the files.
+ * The entries are searched by all of them, and the least recently used
+ * one is replaced, to keep both the hashes used in a rehash.
+ * It's not thread safe.
+ */
+struct snapraid_zerohash {
+	size_t size[ZEROHASH_MAX]; /**< Size of the block. 0 if the entry is empty. */
+	unsigned kind[ZEROHASH_MAX]; /**< Hash kind. */
+	unsigned char seed[ZEROHASH_MAX][HASH_MAX]; /**< Hash seed. */
+	unsigned char digest[ZEROHASH_MAX][HASH_MAX]; /**< Hash of the zero block. */
+	unsigned used[ZEROHASH_MAX]; /**< Time of the last use. 0 if the entry is empty. */
+	unsigned time; /**< Current time, incremented at every use. */
+};
+
+/**
+ * Initialize the zero hash cache.
+ */
+void zerohash_init(struct snapraid_zerohash* zh);
+
+/**
+ * Compute the HASH of a memory block, like memhash().
+ * If the block is all zero, the hash is taken from the cache.
+ * \param is_zero If the block is all zero, as returned by memiszero().
+ */
+void memhash_zero(struct snapraid_zerohash* zh, unsigned kind, const unsigned char* seed, void* digest, const void* src, size_t size, int is_zero);
+
 /**
  * Return the hash name.
  */
@@ -371,6 +371,96 @@ void raid_gen6_int8(int nd, size_t size, void **vv)
 	}
 }
 
+/*
+ * GENL (single parity at the specified level) 8bit C implementation
+ *
+ * The disks are processed one after the other, using for each one the
+ * row of the multiplication table of its coefficient.
+ * This keeps in the cache only one table row at time.
+ */
+void raid_genl_int8(int l, int nd, size_t size, void **vv)
+{
+	uint8_t **v = (uint8_t **)vv;
+	const uint8_t *m;
+	uint8_t *p;
+	uint8_t *d0;
+	int d;
+	size_t i;
+
+	p = v[nd + l];
+
+	/* first disk with all coefficients at 1 */
+	d0 = v[0];
+	for (i = 0; i < size; i += 1)
+		v_8(p[i]) = v_8(d0[i]);
+
+	/* other disks */
+	for (d = 1; d < nd; ++d) {
+		m = gfmul[gfgen[l][d]];
+		d0 = v[d];
+
+		for (i = 0; i < size; i += 1)
+			v_8(p[i]) ^= m[v_8(d0[i])];
+	}
+}
+
+/*
+ * SUB (removal of a data block from the parity) 8bit C implementation
+ */
+void raid_sub_int8(int di, int np, size_t size, void **vv)
+{
+	uint8_t **v = (uint8_t **)vv;
+	const uint8_t *m;
+	uint8_t *p;
+	uint8_t *d0;
+	int l;
+	size_t i;
+
+	d0 = v[0];
+
+	for (l = 0; l < np; ++l) {
+		m = gfmul[gfgen[l][di]];
+		p = v[1 + l];
+
+		for (i = 0; i < size; i += 1)
+			v_8(p[i]) ^= m[v_8(d0[i])];
+	}
+}
+
+/*
+ * VERIFY (parity check without storing it) 8bit C implementation
+ */
+int raid_verify_int8(int nd, int np, size_t size, void **vv)
+{
+	uint8_t **v = (uint8_t **)vv;
+	uint8_t s[RAID_PARITY_MAX];
+	uint8_t p;
+	int d, l;
+	int mask;
+	size_t i;
+
+	for (l = 0; l < np; ++l)
+		s[l] = 0;
+
+	for (i = 0; i < size; i += 1) {
+		for (l = 0; l < np; ++l) {
+			p = v_8(v[nd + l][i]);
+			for (d = 0; d < nd; ++d)
+				p ^= gfmul[v_8(v[d][i])][gfgen[l][d]];
+
+			/* accumulate the syndrome */
+			s[l] |= p;
+		}
+	}
+
+	mask = 0;
+	for (l = 0; l < np; ++l)
+		if (s[l] != 0)
+			mask |= 1 << l;
+
+	return mask;
+}
+
 /*
  * Recover failure of one data block at index id[0] using parity at index
  * ip[0] for any RAID level.
@@ -161,6 +161,13 @@ void raid_gen6_int8(int nd, size_t size, void **vv);
 void raid_gen6_ssse3(int nd, size_t size, void **vv);
 void raid_gen6_ssse3ext(int nd, size_t size, void **vv);
 void raid_gen6_avx2ext(int nd, size_t size, void **vv);
+void raid_genl_int8(int l, int nd, size_t size, void **vv);
+void raid_genl_ssse3(int l, int nd, size_t size, void **vv);
+void raid_sub_int8(int di, int np, size_t size, void **vv);
+void raid_sub_ssse3(int di, int np, size_t size, void **vv);
+int raid_verify_int8(int nd, int np, size_t size, void **vv);
+int raid_verify_ssse3(int nd, int np, size_t size, void **vv);
+int raid_verify_ssse3ext(int nd, int np, size_t size, void **vv);
 void raid_rec1_int8(int nr, int *id, int *ip, int nd, size_t size, void **vv);
 void raid_rec2_int8(int nr, int *id, int *ip, int nd, size_t size, void **vv);
 void raid_recX_int8(int nr, int *id, int *ip, int nd, size_t size, void **vv);
@@ -183,6 +190,9 @@ const char *raid_gen3_tag(void);
 const char *raid_gen4_tag(void);
 const char *raid_gen5_tag(void);
 const char *raid_gen6_tag(void);
+const char *raid_genl_tag(void);
+const char *raid_sub_tag(void);
+const char *raid_verify_tag(void);
 const char *raid_rec1_tag(void);
 const char *raid_rec2_tag(void);
 const char *raid_recX_tag(void);
@@ -192,6 +202,9 @@ const char *raid_recX_tag(void);
  */
 extern void (*raid_gen3_ptr)(int nd, size_t size, void **vv);
 extern void (*raid_genz_ptr)(int nd, size_t size, void **vv);
+extern void (*raid_genl_ptr)(int l, int nd, size_t size, void **vv);
+extern void (*raid_sub_ptr)(int di, int np, size_t size, void **vv);
+extern int (*raid_verify_ptr)(int nd, int np, size_t size, void **vv);
 extern void (*raid_gen_ptr[RAID_PARITY_MAX])(
 	int nd, size_t size, void **vv);
 extern void (*raid_rec_ptr[RAID_PARITY_MAX])(
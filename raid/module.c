@@ -25,6 +25,9 @@ void raid_init(void)
 	raid_gen_ptr[3] = raid_gen4_int8;
 	raid_gen_ptr[4] = raid_gen5_int8;
 	raid_gen_ptr[5] = raid_gen6_int8;
+	raid_genl_ptr = raid_genl_int8;
+	raid_sub_ptr = raid_sub_int8;
+	raid_verify_ptr = raid_verify_int8;
 
 	if (sizeof(void *) == 4) {
 		raid_gen_ptr[0] = raid_gen1_int32;
@@ -81,6 +84,16 @@ void raid_init(void)
 		raid_gen_ptr[3] = raid_gen4_ssse3;
 		raid_gen_ptr[4] = raid_gen5_ssse3;
 		raid_gen_ptr[5] = raid_gen6_ssse3;
+#endif
+		raid_genl_ptr = raid_genl_ssse3;
+		raid_sub_ptr = raid_sub_ssse3;
+#ifdef CONFIG_X86_64
+		if (raid_cpu_has_slowextendedreg())
+			raid_verify_ptr = raid_verify_ssse3;
+		else
+			raid_verify_ptr = raid_verify_ssse3ext;
+#else
+		raid_verify_ptr = raid_verify_ssse3;
 #endif
 		raid_rec_ptr[0] = raid_rec1_ssse3;
 		raid_rec_ptr[1] = raid_rec2_ssse3;
@@ -160,6 +173,7 @@ static int raid_test_par(int nd, int np, size_t size, void **v, void **ref)
 {
 	int i;
 	void *t[TEST_COUNT + RAID_PARITY_MAX];
+	void *s[1 + RAID_PARITY_MAX];
 
 	/* setup data */
 	for (i = 0; i < nd; ++i)
@@ -180,6 +194,58 @@ static int raid_test_par(int nd, int np, size_t size, void **v, void **ref)
 		}
 	}
 
+	/* verify the parity */
+	if (raid_verify(nd, np, size, ref) != 0) {
+		/* LCOV_EXCL_START */
+		return -1;
+		/* LCOV_EXCL_STOP */
+	}
+
+	/* compute again each parity separately */
+	for (i = 0; i < np; ++i) {
+		memset(t[nd + i], 0, size);
+
+		raid_genl(i, nd, size, t);
+
+		if (memcmp(t[nd + i], ref[nd + i], size) != 0) {
+			/* LCOV_EXCL_START */
+			return -1;
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	/* remove the last data block from the parity */
+	s[0] = ref[nd - 1];
+	for (i = 0; i < np; ++i)
+		s[1 + i] = t[nd + i];
+
+	raid_sub(nd - 1, np, size, s);
+
+	/* compare with the parity computed without the last data block */
+	for (i = 0; i < np; ++i) {
+		t[nd - 1 + i] = v[0];
+
+		raid_genl(i, nd - 1, size, t);
+
+		if (memcmp(v[0], s[1 + i], size) != 0) {
+			/* LCOV_EXCL_START */
+			return -1;
+			/* LCOV_EXCL_STOP */
+		}
+	}
+
+	/* verify the parity without the last data block, all must fail */
+	for (i = 0; i < nd; ++i)
+		t[i] = ref[i];
+	for (i = 0; i < np; ++i)
+		t[nd + i] = s[1 + i];
+
+	if (raid_verify(nd, np, size, t) != (1 << np) - 1) {
+		/* LCOV_EXCL_START */
+		return -1;
+		/* LCOV_EXCL_STOP */
+	}
+
 	return 0;
 }
 
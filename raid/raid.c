@@ -232,6 +232,104 @@ void raid_gen(int nd, int np, size_t size, void **v)
 	raid_gen_ptr[np - 1](nd, size, v);
 }
 
+void raid_gen_zero(int nd, int np, size_t size, void **v, const int *zero_map)
+{
+	void *map[RAID_DATA_MAX + RAID_PARITY_MAX];
+	int n;
+	int i;
+
+	/* exclude the trailing zero blocks */
+	n = nd;
+	while (n > 0 && zero_map[n - 1])
+		--n;
+
+	if (n == nd) {
+		raid_gen(nd, np, size, v);
+		return;
+	}
+
+	if (n == 0) {
+		for (i = 0; i < np; ++i)
+			memset(v[nd + i], 0, size);
+		return;
+	}
+
+	/* the parity blocks follow the data ones */
+	for (i = 0; i < n; ++i)
+		map[i] = v[i];
+	for (i = 0; i < np; ++i)
+		map[n + i] = v[nd + i];
+
+	raid_gen(n, np, size, map);
+}
+
+/*
+ * Forwarder for single parity computation.
+ *
+ * It computes only the parity at the specified level, using
+ * the coefficients of the current mode.
+ */
+void (*raid_genl_ptr)(int l, int nd, size_t size, void **vv);
+
+void raid_genl(int l, int nd, size_t size, void **v)
+{
+	/* enforce limit on size */
+	BUG_ON(size % 64 != 0);
+
+	/* enforce limit on parity level */
+	BUG_ON(l < 0);
+	BUG_ON(l >= RAID_PARITY_MAX);
+
+	/* the Vandermonde mode supports only up to three parities */
+	BUG_ON(raid_gfgen == gfvandermonde && l >= 3);
+
+	raid_genl_ptr(l, nd, size, v);
+}
+
+/*
+ * Forwarder for the removal of a data block from the parity.
+ */
+void (*raid_sub_ptr)(int di, int np, size_t size, void **vv);
+
+void raid_sub(int di, int np, size_t size, void **v)
+{
+	/* enforce limit on size */
+	BUG_ON(size % 64 != 0);
+
+	/* enforce limit on data index */
+	BUG_ON(di < 0);
+	BUG_ON(di >= RAID_DATA_MAX);
+
+	/* enforce limit on number of failures */
+	BUG_ON(np < 1);
+	BUG_ON(np > RAID_PARITY_MAX);
+
+	/* the Vandermonde mode supports only up to three parities */
+	BUG_ON(raid_gfgen == gfvandermonde && np > 3);
+
+	raid_sub_ptr(di, np, size, v);
+}
+
+/*
+ * Forwarder for the parity verification.
+ */
+int (*raid_verify_ptr)(int nd, int np, size_t size, void **vv);
+
+int raid_verify(int nd, int np, size_t size, void **v)
+{
+	/* enforce limit on size */
+	BUG_ON(size % 64 != 0);
+
+	/* enforce limit on number of failures */
+	BUG_ON(np < 1);
+	BUG_ON(np > RAID_PARITY_MAX);
+
+	/* the Vandermonde mode supports only up to three parities */
+	BUG_ON(raid_gfgen == gfvandermonde && np > 3);
+
+	return raid_verify_ptr(nd, np, size, v);
+}
+
 /**
  * Inverts the square matrix M of size nxn into V.
  *
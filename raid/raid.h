@@ -103,6 +103,93 @@ void raid_zero(void *zero);
  */
 void raid_gen(int nd, int np, size_t size, void **v);
 
+/**
+ * Computes parity blocks skipping the data blocks filled with zero.
+ *
+ * This function obtains the same result of raid_gen(), but the trailing
+ * data blocks filled with zero are not processed, because they don't
+ * contribute to the parity. The other zero blocks are still processed,
+ * because the position of a block selects its coefficients.
+ * If all the data blocks are zero, the parity blocks are just cleared.
+ *
+ * @nd Number of data blocks.
+ * @np Number of parities blocks to compute.
+ * @size Size of the blocks pointed by @v. It must be a multiplier of 64.
+ * @v Vector of pointers to the blocks of data and parity, like in raid_gen().
+ * @zero_map Vector of @nd elements, with 1 for the data blocks filled
+ *   with zero, and 0 for the others.
+ */
+void raid_gen_zero(int nd, int np, size_t size, void **v, const int *zero_map);
+
+/**
+ * Computes a single parity block.
+ *
+ * This function computes only the parity block at the specified level,
+ * obtaining the same result of raid_gen() for such level, but without
+ * reading or writing any other parity block.
+ *
+ * It's useful to add a new parity level to an already existing set of
+ * parities, without the need to recompute all of them.
+ *
+ * @l Level of the parity to compute. 0 for P, 1 for Q, and so on.
+ * @nd Number of data blocks.
+ * @size Size of the blocks pointed by @v. It must be a multiplier of 64.
+ * @v Vector of pointers to the blocks of data and parity.
+ *   It has (@nd + @l + 1) elements. The starting elements are the blocks for
+ *   data, following with the parity blocks.
+ *   Only the parity block at position (@nd + @l) is written, and the other
+ *   parity blocks are not accessed, and they can be 0.
+ *   Each block has @size bytes.
+ */
+void raid_genl(int l, int nd, size_t size, void **v);
+
+/**
+ * Removes the contribution of a single data block from the parity blocks.
+ *
+ * This function updates the parity blocks obtaining the same result of
+ * raid_gen() with the data block at index @di filled with zeros.
+ *
+ * It's useful to remove a data disk from the array, reading only such
+ * disk and the parity, without the need to read all the other data disks.
+ *
+ * Note that in GF(2^8) the addition and the subtraction are the same
+ * operation, and then calling it again adds back the contribution.
+ *
+ * @di Index of the data block in the array. It selects the coefficients to use.
+ * @np Number of parity blocks to update.
+ * @size Size of the blocks pointed by @v. It must be a multiplier of 64.
+ * @v Vector of pointers to the blocks of data and parity.
+ *   It has (1 + @np) elements. The first element is the data block,
+ *   following with the parity blocks.
+ *   The data block is only read and not modified. Parity blocks are
+ *   read and written.
+ *   Each block has @size bytes.
+ */
+void raid_sub(int di, int np, size_t size, void **v);
+
+/**
+ * Verifies the parity blocks.
+ *
+ * This function checks if the parity blocks match the ones computed by
+ * raid_gen() from the data blocks.
+ *
+ * The parity is never stored, but it's computed and compared with the
+ * provided one in a single pass, reducing the memory traffic.
+ *
+ * No data or parity blocks are modified.
+ *
+ * @nd Number of data blocks.
+ * @np Number of parity blocks to verify.
+ * @size Size of the blocks pointed by @v. It must be a multiplier of 64.
+ * @v Vector of pointers to the blocks of data and parity.
+ *   It has (@nd + @np) elements. The starting elements are the blocks for
+ *   data, following with the parity blocks.
+ *   Each block has @size bytes.
+ * @return A bit mask of the not matching parities. Bit 0 for the first
+ *   parity, bit 1 for the second, and so on. 0 if all parities match.
+ */
+int raid_verify(int nd, int np, size_t size, void **v);
+
 /**
  * Recovers failures in data and parity blocks.
  *
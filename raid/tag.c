@@ -22,6 +22,9 @@ static struct raid_func {
 	{ "int8", raid_gen4_int8 },
 	{ "int8", raid_gen5_int8 },
 	{ "int8", raid_gen6_int8 },
+	{ "int8", raid_genl_int8 },
+	{ "int8", raid_sub_int8 },
+	{ "int8", (void (*)(void))raid_verify_int8 },
 	{ "int32", raid_gen1_int32 },
 	{ "int64", raid_gen1_int64 },
 	{ "int32", raid_gen2_int32 },
@@ -43,6 +46,9 @@ static struct raid_func {
 	{ "ssse3", raid_gen4_ssse3 },
 	{ "ssse3", raid_gen5_ssse3 },
 	{ "ssse3", raid_gen6_ssse3 },
+	{ "ssse3", raid_genl_ssse3 },
+	{ "ssse3", raid_sub_ssse3 },
+	{ "ssse3", (void (*)(void))raid_verify_ssse3 },
 	{ "ssse3", raid_rec1_ssse3 },
 	{ "ssse3", raid_rec2_ssse3 },
 	{ "ssse3", raid_recX_ssse3 },
@@ -66,6 +72,7 @@ static struct raid_func {
 	{ "ssse3e", raid_gen4_ssse3ext },
 	{ "ssse3e", raid_gen5_ssse3ext },
 	{ "ssse3e", raid_gen6_ssse3ext },
+	{ "ssse3e", (void (*)(void))raid_verify_ssse3ext },
 #endif
 #ifdef CONFIG_AVX2
 	{ "avx2e", raid_gen3_avx2ext },
@@ -128,6 +135,21 @@ const char *raid_gen6_tag(void)
 	return raid_tag(raid_gen_ptr[5]);
 }
 
+const char *raid_genl_tag(void)
+{
+	return raid_tag(raid_genl_ptr);
+}
+
+const char *raid_sub_tag(void)
+{
+	return raid_tag(raid_sub_ptr);
+}
+
+const char *raid_verify_tag(void)
+{
+	return raid_tag((void (*)(void))raid_verify_ptr);
+}
+
 const char *raid_rec1_tag(void)
 {
 	return raid_tag(raid_rec_ptr[0]);
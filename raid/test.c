@@ -301,6 +301,11 @@ bail:
 int raid_test_par(int mode, int nd, size_t size)
 {
 	void (*f[64])(int nd, size_t size, void **vbuf);
+	void (*g[64])(int l, int nd, size_t size, void **vbuf);
+	void (*h[64])(int di, int np, size_t size, void **vbuf);
+	int (*k[64])(int nd, int np, size_t size, void **vbuf);
+	void *s[1 + RAID_PARITY_MAX];
+	void *w[RAID_DATA_MAX + RAID_PARITY_MAX];
 	void *v_alloc;
 	void **v;
 	int nv;
@@ -438,6 +443,117 @@ int raid_test_par(int mode, int nd, size_t size)
 		}
 	}
 
+	/* load all the available single parity functions */
+	nf = 0;
+
+	g[nf++] = raid_genl_int8;
+
+#ifdef CONFIG_X86
+#ifdef CONFIG_SSSE3
+	if (raid_cpu_has_ssse3())
+		g[nf++] = raid_genl_ssse3;
+#endif
+#endif /* CONFIG_X86 */
+
+	/* check all the functions for each parity level */
+	for (j = 0; j < nf; ++j) {
+		for (i = 0; i < np; ++i) {
+			/* clear and compute only this parity */
+			memset(v[nd + i], 0, size);
+			g[j](i, nd, size, v);
+
+			/* check it */
+			if (memcmp(v[nd + np + i], v[nd + i], size) != 0) {
+				/* LCOV_EXCL_START */
+				goto bail;
+				/* LCOV_EXCL_STOP */
+			}
+		}
+	}
+
+	/* load all the available subtraction functions */
+	nf = 0;
+
+	h[nf++] = raid_sub_int8;
+
+#ifdef CONFIG_X86
+#ifdef CONFIG_SSSE3
+	if (raid_cpu_has_ssse3())
+		h[nf++] = raid_sub_ssse3;
+#endif
+#endif /* CONFIG_X86 */
+
+	/* compute in the back buffers the parity without the last data block */
+	for (i = 0; i < nd - 1; ++i)
+		w[i] = v[i];
+	for (i = 0; i < np; ++i)
+		w[nd - 1 + i] = v[nd + np + i];
+	raid_gen_ref(nd - 1, np, size, w);
+
+	/* check all the functions removing the last data block */
+	for (j = 0; j < nf; ++j) {
+		s[0] = v[nd - 1];
+		for (i = 0; i < np; ++i)
+			s[1 + i] = v[nd + i];
+
+		h[j](nd - 1, np, size, s);
+
+		/* check it */
+		for (i = 0; i < np; ++i) {
+			if (memcmp(v[nd + np + i], v[nd + i], size) != 0) {
+				/* LCOV_EXCL_START */
+				goto bail;
+				/* LCOV_EXCL_STOP */
+			}
+		}
+
+		/* add it back for the next function */
+		h[j](nd - 1, np, size, s);
+	}
+
+	/* load all the available verification functions */
+	nf = 0;
+
+	k[nf++] = raid_verify_int8;
+
+#ifdef CONFIG_X86
+#ifdef CONFIG_SSSE3
+	if (raid_cpu_has_ssse3())
+		k[nf++] = raid_verify_ssse3;
+#endif
+#endif /* CONFIG_X86 */
+
+#ifdef CONFIG_X86_64
+#ifdef CONFIG_SSSE3
+	if (raid_cpu_has_ssse3())
+		k[nf++] = raid_verify_ssse3ext;
+#endif
+#endif
+
+	for (j = 0; j < nf; ++j) {
+		/* check with the correct parity */
+		if (k[j](nd, np, size, v) != 0) {
+			/* LCOV_EXCL_START */
+			goto bail;
+			/* LCOV_EXCL_STOP */
+		}
+
+		/* check with one wrong bit in each parity */
+		for (i = 0; i < np; ++i) {
+			uint8_t *p = v[nd + i];
+
+			p[size - 1] ^= 1;
+
+			if (k[j](nd, np, size, v) != 1 << i) {
+				/* LCOV_EXCL_START */
+				goto bail;
+				/* LCOV_EXCL_STOP */
+			}
+
+			p[size - 1] ^= 1;
+		}
+	}
+
 	free(v_alloc);
 	free(v);
 	return 0;
@@ -1980,6 +1980,329 @@ void raid_gen6_avx2ext(int nd, size_t size, void **vv)
 }
 #endif
 
+#if defined(CONFIG_X86) && defined(CONFIG_SSSE3)
+/*
+ * GENL (single parity at the specified level) SSSE3 implementation
+ *
+ * It uses the generic multiplication tables, and then it works
+ * with any coefficient, and then also in Vandermonde mode.
+ */
+void raid_genl_ssse3(int l, int nd, size_t size, void **vv)
+{
+	uint8_t **v = (uint8_t **)vv;
+	const uint8_t *c;
+	uint8_t *p;
+	int d;
+	size_t i;
+
+	p = v[nd + l];
+	c = gfgen[l];
+
+	raid_sse_begin();
+
+	asm volatile ("movdqa %0,%%xmm7" : : "m" (gfconst16.low4[0]));
+
+	for (i = 0; i < size; i += 16) {
+		/* first disk with all coefficients at 1 */
+		asm volatile ("movdqa %0,%%xmm0" : : "m" (v[0][i]));
+
+		/* other disks */
+		for (d = 1; d < nd; ++d) {
+			asm volatile ("movdqa %0,%%xmm4" : : "m" (v[d][i]));
+
+			asm volatile ("movdqa %xmm4,%xmm5");
+			asm volatile ("psrlw  $4,%xmm5");
+			asm volatile ("pand   %xmm7,%xmm4");
+			asm volatile ("pand   %xmm7,%xmm5");
+
+			asm volatile ("movdqa %0,%%xmm2" : : "m" (gfmulpshufb[c[d]][0][0]));
+			asm volatile ("movdqa %0,%%xmm3" : : "m" (gfmulpshufb[c[d]][1][0]));
+			asm volatile ("pshufb %xmm4,%xmm2");
+			asm volatile ("pshufb %xmm5,%xmm3");
+			asm volatile ("pxor   %xmm2,%xmm0");
+			asm volatile ("pxor   %xmm3,%xmm0");
+		}
+
+		asm volatile ("movntdq %%xmm0,%0" : "=m" (p[i]));
+	}
+
+	raid_sse_end();
+}
+#endif
+
+#if defined(CONFIG_X86) && defined(CONFIG_SSSE3)
+/*
+ * SUB (removal of a data block from the parity) SSSE3 implementation
+ */
+void raid_sub_ssse3(int di, int np, size_t size, void **vv)
+{
+	uint8_t **v = (uint8_t **)vv;
+	uint8_t *d0;
+	uint8_t *p;
+	int l;
+	size_t i;
+
+	d0 = v[0];
+
+	raid_sse_begin();
+
+	asm volatile ("movdqa %0,%%xmm7" : : "m" (gfconst16.low4[0]));
+
+	for (i = 0; i < size; i += 16) {
+		asm volatile ("movdqa %0,%%xmm4" : : "m" (d0[i]));
+
+		asm volatile ("movdqa %xmm4,%xmm5");
+		asm volatile ("psrlw  $4,%xmm5");
+		asm volatile ("pand   %xmm7,%xmm4");
+		asm volatile ("pand   %xmm7,%xmm5");
+
+		for (l = 0; l < np; ++l) {
+			p = v[1 + l];
+
+			asm volatile ("movdqa %0,%%xmm0" : : "m" (p[i]));
+			asm volatile ("movdqa %0,%%xmm2" : : "m" (gfmulpshufb[gfgen[l][di]][0][0]));
+			asm volatile ("movdqa %0,%%xmm3" : : "m" (gfmulpshufb[gfgen[l][di]][1][0]));
+			asm volatile ("pshufb %xmm4,%xmm2");
+			asm volatile ("pshufb %xmm5,%xmm3");
+			asm volatile ("pxor   %xmm2,%xmm0");
+			asm volatile ("pxor   %xmm3,%xmm0");
+			asm volatile ("movntdq %%xmm0,%0" : "=m" (p[i]));
+		}
+	}
+
+	raid_sse_end();
+}
+#endif
+
+#if defined(CONFIG_X86) && defined(CONFIG_SSSE3)
+/*
+ * VERIFY (parity check without storing it) SSSE3 implementation
+ *
+ * The parity is computed in registers and compared with the provided one,
+ * accumulating the differences in a small buffer of syndromes, that at the
+ * end is all zero only if the parity matches.
+ *
+ * The first two parities are computed like in GEN2, the others like in GENL.
+ */
+int raid_verify_ssse3(int nd, int np, size_t size, void **vv)
+{
+	uint8_t **v = (uint8_t **)vv;
+	uint8_t buffer[RAID_PARITY_MAX*16+16];
+	uint8_t *ps = __align_ptr(buffer, 16);
+	uint8_t *p;
+	uint8_t *q;
+	int d, l;
+	int mask;
+	size_t i;
+
+	p = v[nd];
+	q = np >= 2 ? v[nd + 1] : 0;
+
+	raid_sse_begin();
+
+	/* clear the syndromes */
+	asm volatile ("pxor   %xmm0,%xmm0");
+	for (l = 0; l < np; ++l)
+		asm volatile ("movdqa %%xmm0,%0" : "=m" (ps[l * 16]));
+
+	asm volatile ("movdqa %0,%%xmm6" : : "m" (gfconst16.poly[0]));
+	asm volatile ("movdqa %0,%%xmm7" : : "m" (gfconst16.low4[0]));
+
+	for (i = 0; i < size; i += 16) {
+		/* compute the first parity, and the second one only if required */
+		asm volatile ("movdqa %0,%%xmm0" : : "m" (p[i]));
+		if (np == 1) {
+			for (d = 0; d < nd; ++d)
+				asm volatile ("pxor   %0,%%xmm0" : : "m" (v[d][i]));
+		} else {
+			asm volatile ("movdqa %0,%%xmm4" : : "m" (v[nd - 1][i]));
+			asm volatile ("pxor   %xmm4,%xmm0");
+			asm volatile ("movdqa %xmm4,%xmm1");
+			for (d = nd - 2; d >= 0; --d) {
+				asm volatile ("pxor   %xmm4,%xmm4");
+				asm volatile ("pcmpgtb %xmm1,%xmm4");
+				asm volatile ("paddb  %xmm1,%xmm1");
+				asm volatile ("pand   %xmm6,%xmm4");
+				asm volatile ("pxor   %xmm4,%xmm1");
+
+				asm volatile ("movdqa %0,%%xmm4" : : "m" (v[d][i]));
+				asm volatile ("pxor   %xmm4,%xmm0");
+				asm volatile ("pxor   %xmm4,%xmm1");
+			}
+		}
+
+		/* compare them */
+		asm volatile ("por    %0,%%xmm0" : : "m" (ps[0]));
+		asm volatile ("movdqa %%xmm0,%0" : "=m" (ps[0]));
+		if (np >= 2) {
+			asm volatile ("pxor   %0,%%xmm1" : : "m" (q[i]));
+			asm volatile ("por    %0,%%xmm1" : : "m" (ps[16]));
+			asm volatile ("movdqa %%xmm1,%0" : "=m" (ps[16]));
+		}
+
+		/* compute and compare the other parities */
+		for (l = 2; l < np; ++l) {
+			uint8_t *r = v[nd + l];
+
+			asm volatile ("movdqa %0,%%xmm0" : : "m" (r[i]));
+			for (d = 0; d < nd; ++d) {
+				asm volatile ("movdqa %0,%%xmm4" : : "m" (v[d][i]));
+				asm volatile ("movdqa %xmm4,%xmm5");
+				asm volatile ("psrlw  $4,%xmm5");
+				asm volatile ("pand   %xmm7,%xmm4");
+				asm volatile ("pand   %xmm7,%xmm5");
+
+				asm volatile ("movdqa %0,%%xmm2" : : "m" (gfmulpshufb[gfgen[l][d]][0][0]));
+				asm volatile ("movdqa %0,%%xmm3" : : "m" (gfmulpshufb[gfgen[l][d]][1][0]));
+				asm volatile ("pshufb %xmm4,%xmm2");
+				asm volatile ("pshufb %xmm5,%xmm3");
+				asm volatile ("pxor   %xmm2,%xmm0");
+				asm volatile ("pxor   %xmm3,%xmm0");
+			}
+			asm volatile ("por    %0,%%xmm0" : : "m" (ps[l * 16]));
+			asm volatile ("movdqa %%xmm0,%0" : "=m" (ps[l * 16]));
+		}
+	}
+
+	raid_sse_end();
+
+	mask = 0;
+	for (l = 0; l < np; ++l) {
+		for (i = 0; i < 16; ++i) {
+			if (ps[l * 16 + i] != 0) {
+				mask |= 1 << l;
+				break;
+			}
+		}
+	}
+
+	return mask;
+}
+#endif
+
+#if defined(CONFIG_X86_64) && defined(CONFIG_SSSE3)
+/*
+ * VERIFY (parity check without storing it) SSSE3 implementation
+ *
+ * Like raid_verify_ssse3(), but the syndromes are kept in the registers
+ * xmm8-xmm13 for all the run, and tested at the end without storing them.
+ *
+ * Note that it uses 16 registers, meaning that x64 is required.
+ */
+int raid_verify_ssse3ext(int nd, int np, size_t size, void **vv)
+{
+	uint8_t **v = (uint8_t **)vv;
+	uint8_t *p;
+	uint8_t *q;
+	int d, l;
+	int mask;
+	int eq;
+	size_t i;
+
+	p = v[nd];
+	q = np >= 2 ? v[nd + 1] : 0;
+
+	raid_sse_begin();
+
+	/* clear the syndromes */
+	asm volatile ("pxor   %xmm8,%xmm8");
+	asm volatile ("pxor   %xmm9,%xmm9");
+	asm volatile ("pxor   %xmm10,%xmm10");
+	asm volatile ("pxor   %xmm11,%xmm11");
+	asm volatile ("pxor   %xmm12,%xmm12");
+	asm volatile ("pxor   %xmm13,%xmm13");
+
+	asm volatile ("movdqa %0,%%xmm6" : : "m" (gfconst16.poly[0]));
+	asm volatile ("movdqa %0,%%xmm7" : : "m" (gfconst16.low4[0]));
+
+	for (i = 0; i < size; i += 16) {
+		/* compute the first parity, and the second one only if required */
+		asm volatile ("movdqa %0,%%xmm0" : : "m" (p[i]));
+		if (np == 1) {
+			for (d = 0; d < nd; ++d)
+				asm volatile ("pxor   %0,%%xmm0" : : "m" (v[d][i]));
+		} else {
+			asm volatile ("movdqa %0,%%xmm4" : : "m" (v[nd - 1][i]));
+			asm volatile ("pxor   %xmm4,%xmm0");
+			asm volatile ("movdqa %xmm4,%xmm1");
+			for (d = nd - 2; d >= 0; --d) {
+				asm volatile ("pxor   %xmm4,%xmm4");
+				asm volatile ("pcmpgtb %xmm1,%xmm4");
+				asm volatile ("paddb  %xmm1,%xmm1");
+				asm volatile ("pand   %xmm6,%xmm4");
+				asm volatile ("pxor   %xmm4,%xmm1");
+
+				asm volatile ("movdqa %0,%%xmm4" : : "m" (v[d][i]));
+				asm volatile ("pxor   %xmm4,%xmm0");
+				asm volatile ("pxor   %xmm4,%xmm1");
+			}
+		}
+
+		/* compare them */
+		asm volatile ("por    %xmm0,%xmm8");
+		if (np >= 2) {
+			asm volatile ("pxor   %0,%%xmm1" : : "m" (q[i]));
+			asm volatile ("por    %xmm1,%xmm9");
+		}
+
+		/* compute and compare the other parities */
+		for (l = 2; l < np; ++l) {
+			uint8_t *r = v[nd + l];
+
+			asm volatile ("movdqa %0,%%xmm0" : : "m" (r[i]));
+			for (d = 0; d < nd; ++d) {
+				asm volatile ("movdqa %0,%%xmm4" : : "m" (v[d][i]));
+				asm volatile ("movdqa %xmm4,%xmm5");
+				asm volatile ("psrlw  $4,%xmm5");
+				asm volatile ("pand   %xmm7,%xmm4");
+				asm volatile ("pand   %xmm7,%xmm5");
+
+				asm volatile ("movdqa %0,%%xmm2" : : "m" (gfmulpshufb[gfgen[l][d]][0][0]));
+				asm volatile ("movdqa %0,%%xmm3" : : "m" (gfmulpshufb[gfgen[l][d]][1][0]));
+				asm volatile ("pshufb %xmm4,%xmm2");
+				asm volatile ("pshufb %xmm5,%xmm3");
+				asm volatile ("pxor   %xmm2,%xmm0");
+				asm volatile ("pxor   %xmm3,%xmm0");
+			}
+
+			switch (l) {
+			case 2 : asm volatile ("por    %xmm0,%xmm10"); break;
+			case 3 : asm volatile ("por    %xmm0,%xmm11"); break;
+			case 4 : asm volatile ("por    %xmm0,%xmm12"); break;
+			case 5 : asm volatile ("por    %xmm0,%xmm13"); break;
+			}
+		}
+	}
+
+	/* test the syndromes, a zero one has all the compare bits set */
+	asm volatile ("pxor   %xmm0,%xmm0");
+	asm volatile ("pcmpeqb %xmm0,%xmm8");
+	asm volatile ("pcmpeqb %xmm0,%xmm9");
+	asm volatile ("pcmpeqb %xmm0,%xmm10");
+	asm volatile ("pcmpeqb %xmm0,%xmm11");
+	asm volatile ("pcmpeqb %xmm0,%xmm12");
+	asm volatile ("pcmpeqb %xmm0,%xmm13");
+
+	mask = 0;
+	for (l = 0; l < np; ++l) {
+		switch (l) {
+		case 0 : asm volatile ("pmovmskb %%xmm8,%0" : "=r" (eq)); break;
+		case 1 : asm volatile ("pmovmskb %%xmm9,%0" : "=r" (eq)); break;
+		case 2 : asm volatile ("pmovmskb %%xmm10,%0" : "=r" (eq)); break;
+		case 3 : asm volatile ("pmovmskb %%xmm11,%0" : "=r" (eq)); break;
+		case 4 : asm volatile ("pmovmskb %%xmm12,%0" : "=r" (eq)); break;
+		default : asm volatile ("pmovmskb %%xmm13,%0" : "=r" (eq)); break;
+		}
+		if (eq != 0xFFFF)
+			mask |= 1 << l;
+	}
+
+	raid_sse_end();
+
+	return mask;
+}
+#endif
+
 #if defined(CONFIG_X86) && defined(CONFIG_SSSE3)
 /*
  * RAID recovering for one disk SSSE3 implementation
@@ -25,18 +25,25 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-/* redefine the malloc for tommy use */
-#define tommy_malloc malloc_nofail
-#define tommy_calloc calloc_nofail
-#define tommy_free free
+/* redefine the malloc for tommy use, accounting the memory in the TOMMY_TAG subsystem */
+#define tommy_malloc(size) malloc_nofail_sized(size, TOMMY_TAG)
+#define tommy_calloc(count, size) calloc_nofail_sized(count, size, TOMMY_TAG)
+#define tommy_free free_sized
 
 #include "cmdline/portable.h"
 #include "cmdline/support.h" /* for malloc/calloc_nofail() */
 
 #include "tommyhash.c"
+#define TOMMY_TAG MALLOC_MISC
 #include "tommyarray.c"
+#undef TOMMY_TAG
+#define TOMMY_TAG MALLOC_INFO /* used only for the block information array */
 #include "tommyarrayblkof.c"
+#undef TOMMY_TAG
 #include "tommylist.c"
 #include "tommytree.c"
+#define TOMMY_TAG MALLOC_HASH
 #include "tommyhashdyn.c"
+#include "tommyhashlin.c"
+#undef TOMMY_TAG
 